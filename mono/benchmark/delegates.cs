@@ -0,0 +1,48 @@
+using System;
+
+/*
+ * Invocation of closed, open static and multicast delegates.
+ */
+public class Delegates {
+	delegate int IntOp (int a, int b);
+	delegate double DoubleOp (double a, int b);
+
+	int bias = 1;
+
+	int add (int a, int b) {
+		return a + b + bias;
+	}
+
+	static double scale (double a, int b) {
+		return a * b;
+	}
+
+	static int count;
+
+	static int inc (int a, int b) {
+		count ++;
+		return 0;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 10000000;
+		IntOp closed = new IntOp (new Delegates ().add);
+		DoubleOp open = new DoubleOp (scale);
+		IntOp multi = (IntOp)Delegate.Combine (new IntOp (inc), new IntOp (inc));
+		int sum = 0;
+		double dsum = 0;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		for (int i = 0; i < repeat; i++) {
+			sum += closed (i, 1) & 1;
+			dsum += open (1.0, i & 1);
+			multi (i, 0);
+		}
+
+		if (count != repeat * 2 || dsum != repeat / 2)
+			return 1;
+		return sum > 0 ? 0 : 1;
+	}
+}
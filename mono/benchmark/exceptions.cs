@@ -0,0 +1,70 @@
+using System;
+
+/*
+ * Exception throughput, for exceptions caught in the throwing method, in its caller,
+ * and 10 frames up the stack.
+ */
+public class Exceptions {
+	static Exception ex = new ArgumentException ();
+
+	static int same_frame (int i) {
+		try {
+			if (i >= 0)
+				throw ex;
+		} catch (ArgumentException) {
+			return 1;
+		}
+		return 0;
+	}
+
+	static void thrower (int i) {
+		if (i >= 0)
+			throw ex;
+	}
+
+	static int caller_frame (int i) {
+		try {
+			thrower (i);
+		} catch (ArgumentException) {
+			return 1;
+		}
+		return 0;
+	}
+
+	static void deep_thrower (int depth) {
+		if (depth == 0)
+			throw ex;
+		try {
+			deep_thrower (depth - 1);
+		} finally {
+			depth ++;
+		}
+	}
+
+	static int deep (int i) {
+		try {
+			deep_thrower (10);
+		} catch (ArgumentException) {
+			return 1;
+		}
+		return 0;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+		int n = 0;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Console.WriteLine ("Repeat = " + repeat);
+
+		for (int i = 0; i < repeat * 100000; i++) {
+			n += same_frame (i);
+			n += caller_frame (i);
+			n += deep (i);
+		}
+
+		return n == repeat * 300000 ? 0 : 1;
+	}
+}
@@ -0,0 +1,31 @@
+using System;
+
+/*
+ * Allocation rate: lots of small objects which die immediately, so
+ * almost everything is reclaimed by nursery collections.
+ */
+class Node {
+	public Node next;
+	public int value;
+}
+
+class Test {
+
+	public static int Main (string[] args) {
+		int count = args.Length > 0 ? Int32.Parse (args [0]) : 50000000;
+		Node last = null;
+		int sum = 0;
+
+		for (int i = 0; i < count; i++) {
+			Node n = new Node ();
+			n.value = i;
+			if ((i & 0xff) == 0)
+				last = n;
+			sum += n.value;
+		}
+
+		if (last == null)
+			return 1;
+		return 0;
+	}
+}
@@ -0,0 +1,49 @@
+using System;
+using System.Runtime.CompilerServices;
+
+/*
+ * Ephemeron heavy workload: ConditionalWeakTable entries whose values
+ * reference other keys, which requires several ephemeron marking
+ * rounds to reach the fixpoint.
+ */
+class Key {
+	public int id;
+}
+
+class Value {
+	public Key next;
+	public byte[] data;
+}
+
+class Test {
+
+	public static int Main (string[] args) {
+		int count = args.Length > 0 ? Int32.Parse (args [0]) : 20000;
+		int chain = args.Length > 1 ? Int32.Parse (args [1]) : 50;
+		ConditionalWeakTable<Key, Value> table = new ConditionalWeakTable<Key, Value> ();
+		Key root = null;
+
+		for (int i = 0; i < count; i++) {
+			/* Only the first key of the last chain stays alive */
+			Key first = new Key ();
+			Key k = first;
+			for (int j = 0; j < chain; j++) {
+				Value v = new Value ();
+				v.next = new Key ();
+				v.next.id = j;
+				v.data = new byte [32];
+				table.Add (k, v);
+				k = v.next;
+			}
+			root = first;
+		}
+
+		GC.Collect ();
+
+		int length = 0;
+		Value val;
+		for (Key k = root; table.TryGetValue (k, out val); k = val.next)
+			length++;
+		return length == chain ? 0 : 1;
+	}
+}
@@ -0,0 +1,31 @@
+using System;
+
+/*
+ * Finalizer heavy workload: every object has a finalizer, so every
+ * collection has to queue and run them.
+ */
+class Finalizable {
+	public static int finalized;
+	public object payload;
+
+	~Finalizable () {
+		finalized++;
+	}
+}
+
+class Test {
+
+	public static int Main (string[] args) {
+		int count = args.Length > 0 ? Int32.Parse (args [0]) : 5000000;
+
+		for (int i = 0; i < count; i++) {
+			Finalizable f = new Finalizable ();
+			f.payload = new object ();
+		}
+
+		GC.Collect ();
+		GC.WaitForPendingFinalizers ();
+
+		return Finalizable.finalized > 0 ? 0 : 1;
+	}
+}
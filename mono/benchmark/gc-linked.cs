@@ -0,0 +1,54 @@
+using System;
+
+/*
+ * Deep linked structures: long lists and deep trees which stress the
+ * gray stack during major collections.
+ */
+class Node {
+	public Node left, right;
+	public int value;
+}
+
+class Test {
+
+	static Node MakeTree (int depth) {
+		Node n = new Node ();
+		if (depth > 0) {
+			n.left = MakeTree (depth - 1);
+			n.right = MakeTree (depth - 1);
+		}
+		n.value = depth;
+		return n;
+	}
+
+	static int CheckTree (Node n) {
+		if (n.left == null)
+			return 1;
+		return 1 + CheckTree (n.left) + CheckTree (n.right);
+	}
+
+	public static int Main (string[] args) {
+		int iterations = args.Length > 0 ? Int32.Parse (args [0]) : 40;
+		int list_length = 2000000;
+		Node list = null;
+
+		/* A long list which stays alive and is traversed at every major */
+		for (int i = 0; i < list_length; i++) {
+			Node n = new Node ();
+			n.right = list;
+			n.value = i;
+			list = n;
+		}
+
+		for (int i = 0; i < iterations; i++) {
+			Node tree = MakeTree (18);
+			if (CheckTree (tree) != (1 << 19) - 1)
+				return 1;
+		}
+
+		int length = 0;
+		for (Node n = list; n != null; n = n.right)
+			length++;
+		return length == list_length ? 0 : 2;
+	}
+}
@@ -0,0 +1,27 @@
+using System;
+
+/*
+ * Large object churn: buffers above the large object size limit with
+ * a mix of short and long lifetimes, which fragments the LOS.
+ */
+class Test {
+
+	public static int Main (string[] args) {
+		int count = args.Length > 0 ? Int32.Parse (args [0]) : 200000;
+		byte[][] keep = new byte [64][];
+		Random r = new Random (42);
+
+		for (int i = 0; i < count; i++) {
+			byte[] buf = new byte [8192 + r.Next (256 * 1024)];
+			buf [0] = (byte)i;
+			if ((i % 5) == 0)
+				keep [r.Next (keep.Length)] = buf;
+		}
+
+		for (int i = 0; i < keep.Length; i++) {
+			if (keep [i] != null && keep [i].Length < 8192)
+				return 1;
+		}
+		return 0;
+	}
+}
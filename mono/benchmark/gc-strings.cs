@@ -0,0 +1,32 @@
+using System;
+using System.Text;
+
+/*
+ * Allocation rate of strings and rank 2 arrays, which use their own
+ * managed allocators.
+ */
+class Test {
+
+	public static int Main (string[] args) {
+		int count = args.Length > 0 ? Int32.Parse (args [0]) : 10000000;
+		StringBuilder sb = new StringBuilder ();
+		int sum = 0;
+
+		for (int i = 0; i < count; i++) {
+			string s = String.Concat ("a", "b");
+			sum += s.Length;
+
+			sb.Length = 0;
+			sb.Append ('x');
+			sum += sb.ToString ().Length;
+
+			int[,] m = new int [4, 4];
+			m [3, 3] = 1;
+			sum += m [3, 3];
+		}
+
+		if (sum != count * 4)
+			return 1;
+		return 0;
+	}
+}
@@ -0,0 +1,29 @@
+using System;
+
+/*
+ * Survival rate sweep: the first argument is the percentage of the
+ * allocated objects which are kept alive in a ring buffer long enough
+ * to be promoted to the major heap.
+ */
+class Test {
+
+	const int ring_size = 1 << 20;
+
+	public static int Main (string[] args) {
+		int survival = args.Length > 0 ? Int32.Parse (args [0]) : 10;
+		int count = args.Length > 1 ? Int32.Parse (args [1]) : 20000000;
+		object[] ring = new object [ring_size];
+		int ring_pos = 0;
+		int threshold = survival * 100;
+
+		for (int i = 0; i < count; i++) {
+			object[] o = new object [4];
+			if ((i * 7919) % 10000 < threshold) {
+				ring [ring_pos] = o;
+				ring_pos = (ring_pos + 1) & (ring_size - 1);
+			}
+		}
+
+		return 0;
+	}
+}
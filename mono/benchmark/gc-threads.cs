@@ -0,0 +1,37 @@
+using System;
+using System.Threading;
+
+/*
+ * Allocation from many threads at once, which stresses TLAB refills
+ * and stopping the world.
+ */
+class Test {
+
+	static int per_thread;
+
+	static void Allocate () {
+		object[] keep = new object [1024];
+
+		for (int i = 0; i < per_thread; i++) {
+			object[] o = new object [1 + (i & 7)];
+			if ((i & 0x3f) == 0)
+				keep [i & 1023] = o;
+		}
+	}
+
+	public static int Main (string[] args) {
+		int nthreads = args.Length > 0 ? Int32.Parse (args [0]) : 16;
+		int count = args.Length > 1 ? Int32.Parse (args [1]) : 40000000;
+		Thread[] threads = new Thread [nthreads];
+
+		per_thread = count / nthreads;
+		for (int i = 0; i < nthreads; i++) {
+			threads [i] = new Thread (Allocate);
+			threads [i].Start ();
+		}
+		for (int i = 0; i < nthreads; i++)
+			threads [i].Join ();
+
+		return 0;
+	}
+}
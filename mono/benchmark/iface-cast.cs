@@ -0,0 +1,39 @@
+using System;
+using System.Collections.Generic;
+
+/*
+ * Casts to interfaces and to variant generic interfaces, which use a per call
+ * site cache.
+ */
+public class Test : IDisposable {
+
+	public void Dispose () {
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Console.WriteLine ("Repeat = " + repeat);
+
+		object a = new Test ();
+		object s = "abc";
+		object l = new List<string> ();
+
+		for (int i = 0; i < (repeat * 500); i++) {
+			for (int j = 0; j < 100000; j++) {
+				if (!(a is IDisposable))
+					return 1;
+				if (s is IDisposable)
+					return 2;
+				((IDisposable)a).Dispose ();
+				if (!(l is IEnumerable<object>))
+					return 3;
+			}
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,39 @@
+using System;
+
+/*
+ * A method which is called once and then loops for a long time. With --tiered, the
+ * loop starts in tier 0 code, and continues in optimized OSR code.
+ */
+public class Tests {
+
+	struct Point {
+		public int x, y;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+		long sum = 0;
+		double d = 0;
+		Point p = new Point ();
+		string s = "abc";
+
+		if (args.Length >= 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Console.WriteLine ("Repeat = " + repeat);
+
+		for (int i = 0; i < repeat * 200000000; i++) {
+			sum += i & 0xff;
+			p.x += 1;
+			p.y += s.Length;
+			d += 0.5;
+		}
+
+		if (p.x != repeat * 200000000 || p.y != p.x * 3 || d != p.x * 0.5)
+			return 1;
+		if (sum == 0)
+			return 2;
+
+		return 0;
+	}
+}
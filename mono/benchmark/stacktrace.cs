@@ -0,0 +1,40 @@
+using System;
+using System.Diagnostics;
+
+/*
+ * Stack walks, which look up the jit info of every frame. Run with
+ * --stats to see how many lookups are satisfied by the jit info index.
+ */
+public class StackWalk {
+	static int depth (int n) {
+		if (n == 0)
+			return new StackTrace ().FrameCount;
+		return depth (n - 1) + 0;
+	}
+
+	static int throw_catch (int n) {
+		if (n == 0)
+			throw new ArgumentException ();
+		return throw_catch (n - 1) + 1;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Console.WriteLine ("Repeat = " + repeat);
+
+		for (int i = 0; i < repeat * 10000; i++) {
+			if (depth (20) < 20)
+				return 1;
+			try {
+				throw_catch (20);
+				return 2;
+			} catch (ArgumentException) {
+			}
+		}
+		return 0;
+	}
+}
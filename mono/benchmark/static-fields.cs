@@ -1,18 +1,45 @@
 using System;
 
+/* No beforefieldinit, the cctor has to run at the first access */
+class Precise {
+	public static int si;
+
+	static Precise () {
+		si = 0;
+	}
+}
+
+/* Accessed from shared generic code */
+class Holder<T> {
+	public static int si = 0;
+}
+
 public class Tests {
 
 	public static int si = 0;
+
+	static int SharedLoop<T> () {
+		int h = 0;
+
+		for (int j = 0; j < 10000000; j++)
+			h += Holder<T>.si;
+		return h;
+	}
 	
 	public static int Main (string[] args) {
 		int h = 0, repeat = 1;
 
+		if (args.Length >= 1)
+			repeat = Convert.ToInt32 (args [0]);
+
 		Console.WriteLine ("Repeat = " + repeat);
 
 		for (int i = 0; i < (repeat * 50); i++) {
 			for (int j = 0; j < 10000000; j++) {
 				h += si;
+				h += Precise.si;
 			}
+			h += SharedLoop<string> ();
 		}
 
 		if (h != 0)
@@ -21,5 +48,3 @@ public class Tests {
 		return 0;
 	}
 }
-
-
@@ -6,10 +6,17 @@ class T {
 		Console.WriteLine (Environment.TickCount - i);
 	}
 	
+	object f;
+
 	void X () {
 		object [] x = new object [1];
 		object o = new object ();
 		for (int i = 0; i < 10000000; i ++)
 			x [0] = o;
+		/* Field stores use the write barrier emitted by the JIT */
+		for (int i = 0; i < 10000000; i ++) {
+			f = o;
+			f = null;
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+using System;
+
+/*
+ * Loops which can be vectorized with -O=loop,simd.
+ */
+public class Vectorize {
+	static void add (int[] a, int[] b, int[] c) {
+		for (int i = 0; i < c.Length; i++)
+			c [i] = a [i] + b [i];
+	}
+
+	static int sum (int[] a) {
+		int s = 0;
+
+		for (int i = 0; i < a.Length; i++)
+			s += a [i];
+		return s;
+	}
+
+	static void scale (float[] a, float[] b, float f) {
+		for (int i = 0; i < a.Length; i++)
+			b [i] = a [i] * f;
+	}
+
+	static void axpy (double[] x, double[] y, double a) {
+		for (int i = 0; i < y.Length; i++)
+			y [i] = y [i] + x [i] * a;
+	}
+
+	public static int Main (string[] args) {
+		int repeat = 1;
+		int n = 1003;
+		int[] a = new int [n], b = new int [n], c = new int [n];
+		float[] fa = new float [n], fb = new float [n];
+		double[] dx = new double [n], dy = new double [n];
+
+		if (args.Length == 1)
+			repeat = Convert.ToInt32 (args [0]);
+
+		Console.WriteLine ("Repeat = " + repeat);
+
+		for (int i = 0; i < n; i++) {
+			a [i] = i;
+			b [i] = 2 * i;
+			fa [i] = i;
+			dx [i] = i;
+		}
+
+		for (int i = 0; i < repeat * 10000; i++) {
+			add (a, b, c);
+			if (sum (c) != 3 * (n * (n - 1) / 2))
+				return 1;
+			scale (fa, fb, 0.5f);
+			axpy (dx, dy, 1.0);
+		}
+
+		if (fb [n - 1] != (n - 1) * 0.5f || dy [n - 1] != (double)(n - 1) * repeat * 10000)
+			return 2;
+		return 0;
+	}
+}
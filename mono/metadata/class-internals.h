@@ -702,6 +702,10 @@ typedef struct {
 	gulong dynamic_code_alloc_count;
 	gulong dynamic_code_bytes_count;
 	gulong dynamic_code_frees_count;
+	gulong code_arena_count;
+	gulong code_arena_bytes;
+	gulong code_arena_wasted_bytes;
+	gulong code_huge_page_chunks;
 	gulong delegate_creations;
 	gulong imt_tables_size;
 	gulong imt_number_of_tables;
@@ -714,6 +718,8 @@ typedef struct {
 	gulong jit_info_table_insert_count;
 	gulong jit_info_table_remove_count;
 	gulong jit_info_table_lookup_count;
+	gulong jit_info_table_cache_hit_count;
+	gulong jit_info_table_index_hit_count;
 	gulong hazardous_pointer_count;
 	gulong generics_sharable_methods;
 	gulong generics_unsharable_methods;
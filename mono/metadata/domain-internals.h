@@ -54,6 +54,7 @@ typedef struct {
 
 typedef struct _MonoJitInfoTable MonoJitInfoTable;
 typedef struct _MonoJitInfoTableChunk MonoJitInfoTableChunk;
+typedef struct _MonoJitInfoIndex MonoJitInfoIndex;
 
 #define MONO_JIT_INFO_TABLE_CHUNK_SIZE		64
 
@@ -142,6 +143,16 @@ typedef struct
 	MonoTryBlockHoleJitInfo holes [MONO_ZERO_LEN_ARRAY];
 } MonoTryBlockHoleTableJitInfo;
 
+/*
+ * The native offsets of the instructions following the calls from tier 0 code to the
+ * OSR code of its loops, i.e. the return addresses of those calls.
+ */
+typedef struct
+{
+	guint32 num_calls;
+	guint32 offsets [MONO_ZERO_LEN_ARRAY];
+} MonoOsrCallTableJitInfo;
+
 struct _MonoJitInfo {
 	/* NOTE: These first two elements (method and
 	   next_jit_code_hash) must be in the same order and at the
@@ -167,6 +178,7 @@ struct _MonoJitInfo {
 	gboolean    has_try_block_holes:1;
 	gboolean    from_aot:1;
 	gboolean    from_llvm:1;
+	gboolean    has_osr_calls:1;
 
 	/* FIXME: Embed this after the structure later*/
 	gpointer    gc_info; /* Currently only used by SGen */
@@ -174,6 +186,7 @@ struct _MonoJitInfo {
 	MonoJitExceptionInfo clauses [MONO_ZERO_LEN_ARRAY];
 	/* There is an optional MonoGenericJitInfo after the clauses */
 	/* There is an optional MonoTryBlockHoleTableJitInfo after MonoGenericJitInfo clauses*/
+	/* There is an optional MonoOsrCallTableJitInfo after MonoTryBlockHoleTableJitInfo */
 };
 
 #define MONO_SIZEOF_JIT_INFO (offsetof (struct _MonoJitInfo, clauses))
@@ -275,6 +288,8 @@ struct _MonoDomain {
 	MonoJitInfoTable * 
 	  volatile          jit_info_table;
 	GSList		   *jit_info_free_queue;
+	/* Maps code addresses to jit infos, see domain.c */
+	MonoJitInfoIndex   *jit_info_index;
 	/* Used when loading assemblies */
 	gchar **search_path;
 	gchar *private_bin_path;
@@ -412,7 +427,7 @@ void
 mono_jit_info_set_generic_sharing_context (MonoJitInfo *ji, MonoGenericSharingContext *gsctx) MONO_INTERNAL;
 
 MonoJitInfo*
-mono_domain_lookup_shared_generic (MonoDomain *domain, MonoMethod *method) MONO_INTERNAL;
+mono_domain_lookup_shared_generic (MonoDomain *domain, MonoMethod *shared_method) MONO_INTERNAL;
 
 char *
 mono_make_shadow_copy (const char *filename) MONO_INTERNAL;
@@ -453,6 +468,9 @@ mono_domain_set_internal_with_options (MonoDomain *domain, gboolean migrate_exce
 MonoTryBlockHoleTableJitInfo*
 mono_jit_info_get_try_block_hole_table_info (MonoJitInfo *ji) MONO_INTERNAL;
 
+MonoOsrCallTableJitInfo*
+mono_jit_info_get_osr_call_table_info (MonoJitInfo *ji) MONO_INTERNAL;
+
 /* 
  * Installs a new function which is used to return a MonoJitInfo for a method inside
  * an AOT module.
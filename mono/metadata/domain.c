@@ -326,6 +326,184 @@ jit_info_table_chunk_index (MonoJitInfoTableChunk *chunk, MonoThreadHazardPointe
 	return left;
 }
 
+/*
+ * The jit info index is a secondary index of the jit info table, which makes most
+ * lookups constant time. It is a two level table: the code address space is divided
+ * into 1MB regions, and the regions containing code are entered into a small hash
+ * table keyed by region number, using open addressing with linear probing. Each
+ * entry has a leaf array mapping the granules of code in its region to the jit info
+ * covering them. When a granule is shared by several methods, the
+ * last added one is stored, and lookups for the others fall back to searching the table.
+ * The index is modified while holding the domain lock, and read without locks. Entries
+ * are read as hazard pointers, and they are cleared before the jit info is freed.
+ * Leaves are only freed together with the domain.
+ */
+#define JIT_INFO_INDEX_REGION_BITS		20
+#define JIT_INFO_INDEX_GRANULE_BITS		7
+#define JIT_INFO_INDEX_LEAF_SIZE		(1 << (JIT_INFO_INDEX_REGION_BITS - JIT_INFO_INDEX_GRANULE_BITS))
+/*
+ * The number of slots of the region hash table, has to be a power of two. Once all
+ * slots are used, code in other regions is not indexed, and its lookups fall back
+ * to searching the table.
+ */
+#define JIT_INFO_INDEX_NUM_REGIONS		512
+
+typedef struct {
+	MonoJitInfo * volatile data [JIT_INFO_INDEX_LEAF_SIZE];
+} JitInfoIndexLeaf;
+
+struct _MonoJitInfoIndex {
+	/* The region number + 1, or 0 if the entry is free, hashed with linear probing */
+	volatile gsize keys [JIT_INFO_INDEX_NUM_REGIONS];
+	JitInfoIndexLeaf *leaves [JIT_INFO_INDEX_NUM_REGIONS];
+};
+
+/*
+ * Incremented every time a jit info is removed. The per-thread lookup cache is only
+ * valid while this doesn't change.
+ */
+static volatile gint32 jit_info_remove_epoch;
+
+#ifdef HAVE_KW_THREAD
+typedef struct {
+	MonoDomain *domain;
+	MonoJitInfo *ji;
+	gint32 epoch;
+} JitInfoCache;
+
+static __thread JitInfoCache jit_info_cache MONO_TLS_FAST;
+#endif
+
+static JitInfoIndexLeaf*
+jit_info_index_get_leaf (MonoJitInfoIndex *index, gint8 *addr, gboolean create)
+{
+	gsize key = ((gsize)addr >> JIT_INFO_INDEX_REGION_BITS) + 1;
+	int i, pos;
+
+	pos = key & (JIT_INFO_INDEX_NUM_REGIONS - 1);
+	for (i = 0; i < JIT_INFO_INDEX_NUM_REGIONS; ++i) {
+		gsize k = index->keys [pos];
+
+		if (k == key) {
+			mono_memory_read_barrier ();
+			return index->leaves [pos];
+		}
+		if (k == 0) {
+			if (!create)
+				return NULL;
+			/* The leaf has to be visible before the key */
+			index->leaves [pos] = g_new0 (JitInfoIndexLeaf, 1);
+			mono_memory_write_barrier ();
+			index->keys [pos] = key;
+			return index->leaves [pos];
+		}
+		pos = (pos + 1) & (JIT_INFO_INDEX_NUM_REGIONS - 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * jit_info_index_set:
+ *
+ *   Set the index entries covered by the code of JI to VALUE, or if VALUE is NULL, clear
+ * the entries which still point to JI.
+ * LOCKING: domain lock
+ */
+static void
+jit_info_index_set (MonoJitInfoIndex *index, MonoJitInfo *ji, MonoJitInfo *value)
+{
+	gint8 *start = ji->code_start;
+	gint8 *end = start + ji->code_size;
+	gint8 *addr;
+
+	if (!ji->code_size)
+		return;
+
+	addr = (gint8*)((gsize)start & ~(gsize)((1 << JIT_INFO_INDEX_GRANULE_BITS) - 1));
+	while (addr < end) {
+		JitInfoIndexLeaf *leaf = jit_info_index_get_leaf (index, addr, value != NULL);
+		int i = ((gsize)addr >> JIT_INFO_INDEX_GRANULE_BITS) & (JIT_INFO_INDEX_LEAF_SIZE - 1);
+
+		if (!leaf) {
+			/* Skip to the next region */
+			addr = (gint8*)((((gsize)addr >> JIT_INFO_INDEX_REGION_BITS) + 1) << JIT_INFO_INDEX_REGION_BITS);
+			continue;
+		}
+		for (; i < JIT_INFO_INDEX_LEAF_SIZE && addr < end; ++i, addr += 1 << JIT_INFO_INDEX_GRANULE_BITS) {
+			if (value)
+				leaf->data [i] = value;
+			else if (leaf->data [i] == ji)
+				leaf->data [i] = NULL;
+		}
+		if (!value)
+			mono_memory_write_barrier ();
+	}
+}
+
+static void
+jit_info_index_free (MonoJitInfoIndex *index)
+{
+	int i;
+
+	for (i = 0; i < JIT_INFO_INDEX_NUM_REGIONS; ++i)
+		g_free (index->leaves [i]);
+	g_free (index);
+}
+
+/*
+ * jit_info_index_find:
+ *
+ *   Look up ADDR in the per-thread cache and in the index of DOMAIN. Return NULL if it's
+ * not found, in which case the jit info table has to be searched. EPOCH is the value of
+ * jit_info_remove_epoch read before the lookup.
+ */
+static MonoJitInfo*
+jit_info_index_find (MonoDomain *domain, MonoThreadHazardPointers *hp, gint8 *addr, gint32 epoch)
+{
+	JitInfoIndexLeaf *leaf;
+	MonoJitInfo *ji;
+
+#ifdef HAVE_KW_THREAD
+	if (jit_info_cache.domain == domain && jit_info_cache.epoch == epoch) {
+		ji = jit_info_cache.ji;
+		/* Make it hazardous, then check that it wasn't removed in the meantime */
+		mono_hazard_pointer_set (hp, JIT_INFO_HAZARD_INDEX, ji);
+		mono_memory_barrier ();
+		if (jit_info_remove_epoch == epoch && addr >= (gint8*)ji->code_start && addr < (gint8*)ji->code_start + ji->code_size) {
+			mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+			++mono_stats.jit_info_table_cache_hit_count;
+			return ji;
+		}
+		mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+	}
+#endif
+
+	leaf = jit_info_index_get_leaf (domain->jit_info_index, addr, FALSE);
+	if (!leaf)
+		return NULL;
+
+	ji = get_hazardous_pointer ((gpointer volatile*)&leaf->data [((gsize)addr >> JIT_INFO_INDEX_GRANULE_BITS) & (JIT_INFO_INDEX_LEAF_SIZE - 1)], hp, JIT_INFO_HAZARD_INDEX);
+	if (ji && addr >= (gint8*)ji->code_start && addr < (gint8*)ji->code_start + ji->code_size) {
+		mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+		++mono_stats.jit_info_table_index_hit_count;
+		return ji;
+	}
+	mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+
+	return NULL;
+}
+
+static inline void
+jit_info_cache_set (MonoDomain *domain, MonoJitInfo *ji, gint32 epoch)
+{
+#ifdef HAVE_KW_THREAD
+	jit_info_cache.domain = domain;
+	jit_info_cache.ji = ji;
+	jit_info_cache.epoch = epoch;
+#endif
+}
+
 MonoJitInfo*
 mono_jit_info_table_find (MonoDomain *domain, char *addr)
 {
@@ -334,9 +512,20 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 	int chunk_pos, pos;
 	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
 	MonoImage *image;
+	gint32 epoch;
 
 	++mono_stats.jit_info_table_lookup_count;
 
+	/* Removals which happen after this are detected by the cache */
+	epoch = jit_info_remove_epoch;
+	mono_memory_read_barrier ();
+
+	ji = jit_info_index_find (domain, hp, (gint8*)addr, epoch);
+	if (ji) {
+		jit_info_cache_set (domain, ji, epoch);
+		return ji;
+	}
+
 	/* First we have to get the domain's jit_info_table.  This is
 	   complicated by the fact that a writer might substitute a
 	   new table and free the old one.  What the writer guarantees
@@ -373,6 +562,7 @@ mono_jit_info_table_find (MonoDomain *domain, char *addr)
 					&& (gint8*)addr < (gint8*)ji->code_start + ji->code_size) {
 				mono_hazard_pointer_clear (hp, JIT_INFO_TABLE_HAZARD_INDEX);
 				mono_hazard_pointer_clear (hp, JIT_INFO_HAZARD_INDEX);
+				jit_info_cache_set (domain, ji, epoch);
 				return ji;
 			}
 
@@ -723,6 +913,8 @@ mono_jit_info_table_add (MonoDomain *domain, MonoJitInfo *ji)
 	chunk->last_code_end = (gint8*)chunk->data [chunk->num_elements - 1]->code_start
 		+ chunk->data [chunk->num_elements - 1]->code_size;
 
+	jit_info_index_set (domain->jit_info_index, ji, ji);
+
 	/* Debugging code, should be removed. */
 	//jit_info_table_check (table);
 
@@ -797,6 +989,10 @@ mono_jit_info_table_remove (MonoDomain *domain, MonoJitInfo *ji)
 
 	chunk->data [pos] = mono_jit_info_make_tombstone (ji);
 
+	/* Lookups started after this won't find JI, invalidate the ones in the caches */
+	jit_info_index_set (domain->jit_info_index, ji, NULL);
+	InterlockedIncrement (&jit_info_remove_epoch);
+
 	/* Debugging code, should be removed. */
 	//jit_info_table_check (table);
 
@@ -991,6 +1187,23 @@ mono_jit_info_get_try_block_hole_table_info (MonoJitInfo *ji)
 		return NULL;
 	}
 }
+
+MonoOsrCallTableJitInfo*
+mono_jit_info_get_osr_call_table_info (MonoJitInfo *ji)
+{
+	if (ji->has_osr_calls) {
+		char *ptr = (char*)&ji->clauses [ji->num_clauses];
+		if (ji->has_generic_jit_info)
+			ptr += sizeof (MonoGenericJitInfo);
+		if (ji->has_try_block_holes) {
+			MonoTryBlockHoleTableJitInfo *table = (MonoTryBlockHoleTableJitInfo*)ptr;
+			ptr += sizeof (MonoTryBlockHoleTableJitInfo) + table->num_holes * sizeof (MonoTryBlockHoleJitInfo);
+		}
+		return (MonoOsrCallTableJitInfo*)ptr;
+	} else {
+		return NULL;
+	}
+}
 void
 mono_install_create_domain_hook (MonoCreateDomainFunc func)
 {
@@ -1175,6 +1388,7 @@ mono_domain_create (void)
 	domain->num_jit_info_tables = 1;
 	domain->jit_info_table = jit_info_table_new (domain);
 	domain->jit_info_free_queue = NULL;
+	domain->jit_info_index = g_new0 (MonoJitInfoIndex, 1);
 	domain->finalizable_objects_hash = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	domain->track_resurrection_handles_hash = g_hash_table_new (mono_aligned_addr_hash, NULL);
 	domain->ftnptrs_hash = g_hash_table_new (mono_aligned_addr_hash, NULL);
@@ -1999,6 +2213,10 @@ mono_domain_free (MonoDomain *domain, gboolean force)
 	jit_info_table_free (domain->jit_info_table);
 	domain->jit_info_table = NULL;
 	g_assert (!domain->jit_info_free_queue);
+	/* Invalidate the per-thread caches, they might point to jit infos of this domain */
+	InterlockedIncrement (&jit_info_remove_epoch);
+	jit_info_index_free (domain->jit_info_index);
+	domain->jit_info_index = NULL;
 
 	/* collect statistics */
 	code_alloc = mono_code_manager_size (domain->code_mp, &code_size);
@@ -2126,13 +2344,18 @@ mono_domain_alloc0 (MonoDomain *domain, guint size)
 /*
  * mono_domain_code_reserve:
  *
- * LOCKING: Acquires the domain lock.
+ * LOCKING: Acquires the domain lock, unless the memory can be allocated from the
+ * code arena of the current thread.
  */
 void*
 mono_domain_code_reserve (MonoDomain *domain, int size)
 {
 	gpointer res;
 
+	res = mono_code_manager_try_reserve (domain->code_mp, size);
+	if (res)
+		return res;
+
 	mono_domain_lock (domain);
 	res = mono_code_manager_reserve (domain->code_mp, size);
 	mono_domain_unlock (domain);
@@ -2143,13 +2366,18 @@ mono_domain_code_reserve (MonoDomain *domain, int size)
 /*
  * mono_domain_code_reserve_align:
  *
- * LOCKING: Acquires the domain lock.
+ * LOCKING: Acquires the domain lock, unless the memory can be allocated from the
+ * code arena of the current thread.
  */
 void*
 mono_domain_code_reserve_align (MonoDomain *domain, int size, int alignment)
 {
 	gpointer res;
 
+	res = mono_code_manager_try_reserve_align (domain->code_mp, size, alignment);
+	if (res)
+		return res;
+
 	mono_domain_lock (domain);
 	res = mono_code_manager_reserve_align (domain->code_mp, size, alignment);
 	mono_domain_unlock (domain);
@@ -2160,11 +2388,15 @@ mono_domain_code_reserve_align (MonoDomain *domain, int size, int alignment)
 /*
  * mono_domain_code_commit:
  *
- * LOCKING: Acquires the domain lock.
+ * LOCKING: Acquires the domain lock, unless the memory was allocated from the
+ * code arena of the current thread.
  */
 void
 mono_domain_code_commit (MonoDomain *domain, void *data, int size, int newsize)
 {
+	if (mono_code_manager_try_commit (domain->code_mp, data, size, newsize))
+		return;
+
 	mono_domain_lock (domain);
 	mono_code_manager_commit (domain->code_mp, data, size, newsize);
 	mono_domain_unlock (domain);
@@ -48,7 +48,10 @@ typedef enum {
 	MONO_GC_EVENT_PRE_STOP_WORLD,
 	MONO_GC_EVENT_POST_STOP_WORLD,
 	MONO_GC_EVENT_PRE_START_WORLD,
-	MONO_GC_EVENT_POST_START_WORLD
+	MONO_GC_EVENT_POST_START_WORLD,
+	/* the heap walk done when an appdomain is unloaded */
+	MONO_GC_EVENT_CLEAR_DOMAIN_START,
+	MONO_GC_EVENT_CLEAR_DOMAIN_END
 } MonoGCEvent;
 
 /* coverage info */
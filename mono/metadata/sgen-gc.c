@@ -307,9 +307,14 @@ static int stat_wbarrier_generic_store_remset = 0;
 static int stat_wbarrier_set_root = 0;
 static int stat_wbarrier_value_copy = 0;
 static int stat_wbarrier_object_copy = 0;
+static int stat_wbarrier_range_copy_no_nursery_refs = 0;
 #endif
 
 static long long stat_pinned_objects = 0;
+static long long stat_stack_pin_candidates_conservative = 0;
+static long long stat_stack_pin_candidates_precise = 0;
+static long long stat_tlab_refills = 0;
+static long long stat_tlab_waste = 0;
 
 static long long time_minor_pre_collection_fragment_clear = 0;
 static long long time_minor_pinning = 0;
@@ -335,6 +340,9 @@ static long long time_major_los_sweep = 0;
 static long long time_major_sweep = 0;
 static long long time_major_fragment_creation = 0;
 
+static long long time_clear_domain = 0;
+static long long stat_clear_domain_jobs = 0;
+
 #define DEBUG(level,a) do {if (G_UNLIKELY ((level) <= SGEN_MAX_DEBUG_LEVEL && (level) <= gc_debug_level)) a;} while (0)
 
 int gc_debug_level = 0;
@@ -497,6 +505,7 @@ static mword highest_heap_address = 0;
 static LOCK_DECLARE (interruption_mutex);
 static LOCK_DECLARE (global_remset_mutex);
 static LOCK_DECLARE (pin_queue_mutex);
+static LOCK_DECLARE (clear_domain_mutex);
 
 #define LOCK_GLOBAL_REMSET pthread_mutex_lock (&global_remset_mutex)
 #define UNLOCK_GLOBAL_REMSET pthread_mutex_unlock (&global_remset_mutex)
@@ -504,6 +513,9 @@ static LOCK_DECLARE (pin_queue_mutex);
 #define LOCK_PIN_QUEUE pthread_mutex_lock (&pin_queue_mutex)
 #define UNLOCK_PIN_QUEUE pthread_mutex_unlock (&pin_queue_mutex)
 
+#define LOCK_CLEAR_DOMAIN pthread_mutex_lock (&clear_domain_mutex)
+#define UNLOCK_CLEAR_DOMAIN pthread_mutex_unlock (&clear_domain_mutex)
+
 typedef struct _FinalizeReadyEntry FinalizeReadyEntry;
 struct _FinalizeReadyEntry {
 	FinalizeReadyEntry *next;
@@ -524,6 +536,14 @@ typedef struct {
 
 int current_collection_generation = -1;
 
+/*
+ * Set while mono_gc_clear_domain () has the workers walking the major
+ * heap.  That happens outside of collections, so it's the only case in
+ * which collection_is_parallel () can be TRUE with no current
+ * generation.
+ */
+static gboolean domain_clearing_is_parallel = FALSE;
+
 /*
  * The link pointer is hidden by negating each bit.  We use the lowest
  * bit of the link (before negation) to store whether it needs
@@ -614,6 +634,7 @@ static char *nursery_alloc_bound = NULL;
 #define TLAB_NEXT	tlab_next
 #define TLAB_TEMP_END	tlab_temp_end
 #define TLAB_REAL_END	tlab_real_end
+#define TLAB_INFO	thread_info
 #define REMEMBERED_SET	remembered_set
 #define STORE_REMSET_BUFFER	store_remset_buffer
 #define STORE_REMSET_BUFFER_INDEX	store_remset_buffer_index
@@ -625,6 +646,7 @@ static pthread_key_t thread_info_key;
 #define TLAB_NEXT	(__thread_info__->tlab_next)
 #define TLAB_TEMP_END	(__thread_info__->tlab_temp_end)
 #define TLAB_REAL_END	(__thread_info__->tlab_real_end)
+#define TLAB_INFO	__thread_info__
 #define REMEMBERED_SET	(__thread_info__->remset)
 #define STORE_REMSET_BUFFER	(__thread_info__->store_remset_buffer)
 #define STORE_REMSET_BUFFER_INDEX	(__thread_info__->store_remset_buffer_index)
@@ -662,14 +684,24 @@ static __thread char *stack_end;
 static __thread long *store_remset_buffer_index_addr;
 #endif
 
-/* The size of a TLAB */
-/* The bigger the value, the less often we have to go to the slow path to allocate a new 
+/* The initial size of a TLAB */
+/* Objects bigger than this are allocated directly from the nursery.
+ * Each thread starts with a TLAB of this size, which is then adjusted
+ * after every collection by adapt_tlab_size (), depending on how much
+ * the thread allocated since the previous one.  The bigger the TLAB,
+ * the less often we have to go to the slow path to allocate a new
  * one, but the more space is wasted by threads not allocating much memory.
- * FIXME: Tune this.
- * FIXME: Make this self-tuning for each thread.
  */
 static guint32 tlab_size = (1024 * 4);
 
+/* Bounds for the per-thread TLAB sizes */
+#define TLAB_MIN_SIZE	(1024)
+#define TLAB_MAX_SIZE	(256 * 1024)
+/* No TLAB can be bigger than this fraction of the nursery */
+#define TLAB_MAX_NURSERY_FRACTION	32
+/* The number of TLAB refills we aim for between two collections */
+#define TLAB_TARGET_REFILLS	16
+
 #define MAX_SMALL_OBJ_SIZE	SGEN_MAX_SMALL_OBJ_SIZE
 
 /* Functions supplied by the runtime to be called by the GC */
@@ -1426,8 +1458,14 @@ clear_domain_process_object (char *obj, MonoDomain *domain)
 
 	if (remove && ((MonoObject*)obj)->synchronisation) {
 		void **dislink = mono_monitor_get_object_monitor_weak_link ((MonoObject*)obj);
-		if (dislink)
+		if (dislink) {
+			/* The dislink hashes are shared between the workers. */
+			if (domain_clearing_is_parallel)
+				LOCK_CLEAR_DOMAIN;
 			mono_gc_register_disappearing_link (NULL, dislink, FALSE, TRUE);
+			if (domain_clearing_is_parallel)
+				UNLOCK_CLEAR_DOMAIN;
+		}
 	}
 
 	return remove;
@@ -1460,6 +1498,94 @@ clear_domain_free_major_pinned_object_callback (char *obj, size_t size, MonoDoma
 		major_collector.free_pinned_object (obj, size);
 }
 
+/*
+ * Each worker gets this many block ranges, so that the ones that
+ * finish early can pick up the work of the others.
+ */
+#define CLEAR_DOMAIN_RANGES_PER_WORKER	4
+
+typedef struct
+{
+	MonoDomain *domain;
+	int first_block;
+	int last_block;
+} ClearDomainJobData;
+
+static void
+job_clear_domain_process_major_range (WorkerData *worker_data, void *job_data_untyped)
+{
+	ClearDomainJobData *job_data = job_data_untyped;
+
+	major_collector.iterate_objects_range (job_data->first_block, job_data->last_block, TRUE, TRUE,
+			(IterateObjectCallbackFunc)clear_domain_process_major_object_callback, job_data->domain);
+}
+
+static void
+job_clear_domain_free_major_range (WorkerData *worker_data, void *job_data_untyped)
+{
+	ClearDomainJobData *job_data = job_data_untyped;
+
+	major_collector.iterate_objects_range (job_data->first_block, job_data->last_block, TRUE, FALSE,
+			(IterateObjectCallbackFunc)clear_domain_free_major_non_pinned_object_callback, job_data->domain);
+	major_collector.iterate_objects_range (job_data->first_block, job_data->last_block, FALSE, TRUE,
+			(IterateObjectCallbackFunc)clear_domain_free_major_pinned_object_callback, job_data->domain);
+}
+
+static void
+job_clear_domain_process_los (WorkerData *worker_data, void *job_data_untyped)
+{
+	ClearDomainJobData *job_data = job_data_untyped;
+	LOSObject *bigobj;
+
+	for (bigobj = los_object_list; bigobj; bigobj = bigobj->next)
+		clear_domain_process_object (bigobj->data, job_data->domain);
+}
+
+static gboolean
+clear_domain_can_be_parallel (void)
+{
+	return major_collector.is_parallel && major_collector.iterate_objects_range;
+}
+
+/*
+ * Splits the major heap into block ranges and lets the workers run
+ * FUNC on them.  The GC thread helps out with the jobs, too.  If
+ * LOS_FUNC is given, it is run as a job of its own.
+ *
+ * LOCKING: requires that the GC lock is held.
+ */
+static void
+clear_domain_run_jobs (MonoDomain *domain, JobFunc func, JobFunc los_func)
+{
+	int num_blocks = major_collector.begin_iterate_objects_range ();
+	int num_ranges = MAX (1, MIN (num_blocks, workers_num * CLEAR_DOMAIN_RANGES_PER_WORKER));
+	ClearDomainJobData *ranges = alloca (sizeof (ClearDomainJobData) * num_ranges);
+	ClearDomainJobData los_data;
+	int i;
+
+	workers_start_all_workers ();
+
+	if (los_func) {
+		los_data.domain = domain;
+		los_data.first_block = los_data.last_block = 0;
+		workers_enqueue_job (los_func, &los_data);
+	}
+
+	for (i = 0; i < num_ranges; ++i) {
+		ranges [i].domain = domain;
+		ranges [i].first_block = (int)((gint64)num_blocks * i / num_ranges);
+		ranges [i].last_block = (int)((gint64)num_blocks * (i + 1) / num_ranges);
+		workers_enqueue_job (func, &ranges [i]);
+	}
+
+	stat_clear_domain_jobs += num_ranges + (los_func ? 1 : 0);
+
+	while (workers_dequeue_and_do_job (&workers_gc_thread_data))
+		;
+
+	workers_join ();
+}
+
 /*
  * When appdomains are unloaded we can easily remove objects that have finalizers,
  * but all the others could still be present in random places on the heap.
@@ -1473,10 +1599,16 @@ void
 mono_gc_clear_domain (MonoDomain * domain)
 {
 	LOSObject *bigobj, *prev;
+	gboolean parallel;
 	int i;
+	TV_DECLARE (atv);
+	TV_DECLARE (btv);
 
 	LOCK_GC;
 
+	mono_profiler_gc_event (MONO_GC_EVENT_CLEAR_DOMAIN_START, 0);
+	TV_GETTIME (atv);
+
 	process_fin_stage_entries ();
 	process_dislink_stage_entries ();
 
@@ -1504,10 +1636,22 @@ mono_gc_clear_domain (MonoDomain * domain)
 	   (pinned objects with major-copying or pinned and non-pinned
 	   objects with major-mark&sweep), but we might need to
 	   dereference a pointer from an object to another object if
-	   the first object is a proxy. */
-	major_collector.iterate_objects (TRUE, TRUE, (IterateObjectCallbackFunc)clear_domain_process_major_object_callback, domain);
-	for (bigobj = los_object_list; bigobj; bigobj = bigobj->next)
-		clear_domain_process_object (bigobj->data, domain);
+	   the first object is a proxy.
+
+	   With a parallel major collector both passes over the major
+	   heap are split into block ranges which are handed out to
+	   the workers. */
+	parallel = clear_domain_can_be_parallel ();
+	if (parallel) {
+		major_collector.wait_for_sweep_done ();
+		domain_clearing_is_parallel = TRUE;
+		clear_domain_run_jobs (domain, job_clear_domain_process_major_range, job_clear_domain_process_los);
+		domain_clearing_is_parallel = FALSE;
+	} else {
+		major_collector.iterate_objects (TRUE, TRUE, (IterateObjectCallbackFunc)clear_domain_process_major_object_callback, domain);
+		for (bigobj = los_object_list; bigobj; bigobj = bigobj->next)
+			clear_domain_process_object (bigobj->data, domain);
+	}
 
 	prev = NULL;
 	for (bigobj = los_object_list; bigobj;) {
@@ -1526,12 +1670,22 @@ mono_gc_clear_domain (MonoDomain * domain)
 		prev = bigobj;
 		bigobj = bigobj->next;
 	}
-	major_collector.iterate_objects (TRUE, FALSE, (IterateObjectCallbackFunc)clear_domain_free_major_non_pinned_object_callback, domain);
-	major_collector.iterate_objects (FALSE, TRUE, (IterateObjectCallbackFunc)clear_domain_free_major_pinned_object_callback, domain);
+	if (parallel) {
+		domain_clearing_is_parallel = TRUE;
+		clear_domain_run_jobs (domain, job_clear_domain_free_major_range, NULL);
+		domain_clearing_is_parallel = FALSE;
+	} else {
+		major_collector.iterate_objects (TRUE, FALSE, (IterateObjectCallbackFunc)clear_domain_free_major_non_pinned_object_callback, domain);
+		major_collector.iterate_objects (FALSE, TRUE, (IterateObjectCallbackFunc)clear_domain_free_major_pinned_object_callback, domain);
+	}
 
 	if (do_pin_stats && domain == mono_get_root_domain ())
 		mono_sgen_pin_stats_print_class_stats ();
 
+	TV_GETTIME (btv);
+	time_clear_domain += TV_ELAPSED_MS (atv, btv);
+	mono_profiler_gc_event (MONO_GC_EVENT_CLEAR_DOMAIN_END, 0);
+
 	UNLOCK_GC;
 }
 
@@ -1911,6 +2065,16 @@ optimize_pin_queue (int start_slot)
 	
 }
 
+/*
+ * Whether the runtime marks thread stacks using its GC maps, only falling
+ * back to conservative scanning for frames without them.
+ */
+static gboolean
+precise_stack_marking_in_effect (void)
+{
+	return gc_callbacks.thread_mark_func && !conservative_stack_mark;
+}
+
 /* 
  * Scan the memory between start and end and queue values which could be pointers
  * to the area between start_nursery and end_nursery for later consideration.
@@ -1950,6 +2114,13 @@ conservatively_pin_objects_from (void **start, void **end, void *start_nursery,
 		}
 		start++;
 	}
+	if (pin_type == PIN_TYPE_STACK) {
+		/* Lets us compare how much precise stack marking saves us */
+		if (precise_stack_marking_in_effect ())
+			stat_stack_pin_candidates_precise += count;
+		else
+			stat_stack_pin_candidates_conservative += count;
+	}
 	DEBUG (7, if (count) fprintf (gc_debug_file, "found %d potential pinned heap pointers\n", count));
 }
 
@@ -2741,7 +2912,14 @@ init_stats (void)
 	mono_counters_register ("Major sweep", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_major_sweep);
 	mono_counters_register ("Major fragment creation", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_major_fragment_creation);
 
+	mono_counters_register ("Domain clear", MONO_COUNTER_GC | MONO_COUNTER_LONG, &time_clear_domain);
+	mono_counters_register ("# domain clear jobs", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_clear_domain_jobs);
+
 	mono_counters_register ("Number of pinned objects", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_pinned_objects);
+	mono_counters_register ("Stack pin candidates (conservative)", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_stack_pin_candidates_conservative);
+	mono_counters_register ("Stack pin candidates (precise)", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_stack_pin_candidates_precise);
+	mono_counters_register ("# TLAB refills", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_tlab_refills);
+	mono_counters_register ("TLAB waste bytes", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_tlab_waste);
 
 #ifdef HEAVY_STATISTICS
 	mono_counters_register ("WBarrier set field", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_set_field);
@@ -2752,6 +2930,7 @@ init_stats (void)
 	mono_counters_register ("WBarrier set root", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_set_root);
 	mono_counters_register ("WBarrier value copy", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_value_copy);
 	mono_counters_register ("WBarrier object copy", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_object_copy);
+	mono_counters_register ("WBarrier range copy w/o nursery refs", MONO_COUNTER_GC | MONO_COUNTER_INT, &stat_wbarrier_range_copy_no_nursery_refs);
 
 	mono_counters_register ("# objects allocated", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_objects_alloced);
 	mono_counters_register ("bytes allocated", MONO_COUNTER_GC | MONO_COUNTER_LONG, &stat_bytes_alloced);
@@ -2898,6 +3077,8 @@ collection_is_parallel (void)
 		return nursery_collection_is_parallel;
 	case GENERATION_OLD:
 		return major_collector.is_parallel;
+	case -1:
+		return domain_clearing_is_parallel;
 	default:
 		g_assert_not_reached ();
 	}
@@ -3773,20 +3954,22 @@ mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 				}
 			} else {
 				int alloc_size = 0;
+				int desired_size = MAX (TLAB_INFO->tlab_size, size);
 				if (TLAB_START)
 					DEBUG (3, fprintf (gc_debug_file, "Retire TLAB: %p-%p [%ld]\n", TLAB_START, TLAB_REAL_END, (long)(TLAB_REAL_END - TLAB_NEXT - size)));
 				mono_sgen_nursery_retire_region (p, available_in_tlab);
+				TLAB_INFO->tlab_waste += available_in_tlab;
 
 				do {
-					p = mono_sgen_nursery_alloc_range (tlab_size, size, &alloc_size);
+					p = mono_sgen_nursery_alloc_range (desired_size, size, &alloc_size);
 					if (!p) {
-						minor_collect_or_expand_inner (tlab_size);
+						minor_collect_or_expand_inner (desired_size);
 						if (degraded_mode) {
 							p = alloc_degraded (vtable, size, FALSE);
 							binary_protocol_alloc_degraded (p, vtable, size);
 							return p;
 						} else {
-							p = mono_sgen_nursery_alloc_range (tlab_size, size, &alloc_size);
+							p = mono_sgen_nursery_alloc_range (desired_size, size, &alloc_size);
 						}		
 					}
 				} while (!p);
@@ -3801,6 +3984,8 @@ mono_gc_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 				TLAB_NEXT = TLAB_START;
 				TLAB_REAL_END = TLAB_START + alloc_size;
 				TLAB_TEMP_END = TLAB_START + MIN (SCAN_START_SIZE, alloc_size);
+				TLAB_INFO->tlab_refills++;
+				TLAB_INFO->tlab_allocated += alloc_size;
 
 				if (nursery_clear_policy == CLEAR_AT_TLAB_CREATION) {
 					memset (TLAB_START, 0, alloc_size);
@@ -3880,7 +4065,8 @@ mono_gc_try_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 			int alloc_size = 0;
 
 			mono_sgen_nursery_retire_region (p, available_in_tlab);
-			new_next = mono_sgen_nursery_alloc_range (tlab_size, size, &alloc_size);
+			TLAB_INFO->tlab_waste += available_in_tlab;
+			new_next = mono_sgen_nursery_alloc_range (MAX (TLAB_INFO->tlab_size, size), size, &alloc_size);
 			p = (void**)new_next;
 			if (!p)
 				return NULL;
@@ -3889,6 +4075,8 @@ mono_gc_try_alloc_obj_nolock (MonoVTable *vtable, size_t size)
 			TLAB_NEXT = new_next + size;
 			TLAB_REAL_END = new_next + alloc_size;
 			TLAB_TEMP_END = new_next + MIN (SCAN_START_SIZE, alloc_size);
+			TLAB_INFO->tlab_refills++;
+			TLAB_INFO->tlab_allocated += alloc_size;
 
 			if (nursery_clear_policy == CLEAR_AT_TLAB_CREATION)
 				memset (new_next, 0, alloc_size);
@@ -4654,6 +4842,7 @@ restart_world (int generation)
 	usec = TV_ELAPSED (stop_world_time, end_sw);
 	max_pause_usec = MAX (usec, max_pause_usec);
 	DEBUG (2, fprintf (gc_debug_file, "restarted %d thread(s) (pause time: %d usec, max: %d)\n", count, (int)usec, (int)max_pause_usec));
+	DEBUG (1, fprintf (gc_debug_file, "World stopped for %d usecs (generation %d)\n", (int)usec, generation));
 	mono_profiler_gc_event (MONO_GC_EVENT_POST_START_WORLD, generation);
 
 	bridge_process ();
@@ -4721,7 +4910,7 @@ scan_thread_data (void *start_nursery, void *end_nursery, gboolean precise, Gray
 			continue;
 		}
 		DEBUG (3, fprintf (gc_debug_file, "Scanning thread %p, range: %p-%p, size: %td, pinned=%d\n", info, info->stack_start, info->stack_end, (char*)info->stack_end - (char*)info->stack_start, next_pin_slot));
-		if (gc_callbacks.thread_mark_func && !conservative_stack_mark) {
+		if (precise_stack_marking_in_effect ()) {
 			UserCopyOrMarkData data = { NULL, queue };
 			set_user_copy_or_mark_data (&data);
 			gc_callbacks.thread_mark_func (info->runtime_data, info->stack_start, info->stack_end, precise);
@@ -5119,6 +5308,49 @@ clear_remsets (void)
 	}
 }
 
+/*
+ * Pick the TLAB size for the next cycle based on how much INFO
+ * allocated from TLABs since the last collection, so that a thread
+ * allocating at the same rate would refill about TLAB_TARGET_REFILLS
+ * times.  Mostly idle threads end up with small TLABs, which waste
+ * less of the nursery.  We average with the previous size to avoid
+ * oscillating.  Must be called with the world stopped, before the
+ * TLABs are cleared.
+ */
+static void
+adapt_tlab_size (SgenThreadInfo *info)
+{
+	mword allocated = info->tlab_allocated;
+	mword max_size = MIN (TLAB_MAX_SIZE, nursery_size / TLAB_MAX_NURSERY_FRACTION);
+	mword new_size;
+
+	/*
+	 * Threads which didn't get a TLAB since the last collection don't
+	 * hold any nursery space, so we keep their size.
+	 */
+	if (!info->tlab_refills)
+		return;
+
+	/* The unused end of the current TLAB is wasted, too */
+	if (*info->tlab_start_addr) {
+		mword unused = *info->tlab_real_end_addr - *info->tlab_next_addr;
+		info->tlab_waste += unused;
+		allocated -= MIN (unused, allocated);
+	}
+
+	new_size = (info->tlab_size + allocated / TLAB_TARGET_REFILLS) / 2;
+	new_size = MAX (TLAB_MIN_SIZE, MIN (max_size, new_size));
+	info->tlab_size = ALIGN_UP (new_size);
+
+	DEBUG (4, fprintf (gc_debug_file, "Thread %p: %d TLAB refills, %ld bytes wasted, new TLAB size %d\n", info, info->tlab_refills, (long)info->tlab_waste, info->tlab_size));
+
+	stat_tlab_refills += info->tlab_refills;
+	stat_tlab_waste += info->tlab_waste;
+	info->tlab_refills = 0;
+	info->tlab_allocated = 0;
+	info->tlab_waste = 0;
+}
+
 /*
  * Clear the thread local TLAB variables for all threads.
  */
@@ -5128,6 +5360,8 @@ clear_tlabs (void)
 	SgenThreadInfo *info;
 
 	FOREACH_THREAD (info) {
+		adapt_tlab_size (info);
+
 		/* A new TLAB will be allocated when the thread does its first allocation */
 		*info->tlab_start_addr = NULL;
 		*info->tlab_next_addr = NULL;
@@ -5165,6 +5399,10 @@ sgen_thread_register (SgenThreadInfo* info, void *addr)
 	info->tlab_next_addr = &TLAB_NEXT;
 	info->tlab_temp_end_addr = &TLAB_TEMP_END;
 	info->tlab_real_end_addr = &TLAB_REAL_END;
+	info->tlab_size = tlab_size;
+	info->tlab_refills = 0;
+	info->tlab_allocated = 0;
+	info->tlab_waste = 0;
 	info->store_remset_buffer_addr = &STORE_REMSET_BUFFER;
 	info->store_remset_buffer_index_addr = &STORE_REMSET_BUFFER_INDEX;
 	info->stopped_ip = NULL;
@@ -5506,6 +5744,37 @@ mono_gc_wbarrier_set_arrayref (MonoArray *arr, gpointer slot_ptr, MonoObject* va
 	}
 }
 
+/*
+ * Returns whether any of the COUNT words starting at START points into
+ * the nursery.  The inner loop doesn't branch on the individual
+ * words, so it can be vectorized by the compiler - we only check the
+ * result once per chunk.
+ */
+#define NURSERY_REFS_CHUNK_SIZE	32
+
+static gboolean
+range_has_nursery_refs (gpointer *start, int count)
+{
+	gpointer *end = start + count;
+
+	while (end - start >= NURSERY_REFS_CHUNK_SIZE) {
+		gpointer *chunk_end = start + NURSERY_REFS_CHUNK_SIZE;
+		int found = 0;
+		for (; start < chunk_end; start += 4) {
+			found |= ptr_in_nursery (start [0]) | ptr_in_nursery (start [1]) |
+				ptr_in_nursery (start [2]) | ptr_in_nursery (start [3]);
+		}
+		if (found)
+			return TRUE;
+	}
+
+	for (; start < end; ++start) {
+		if (ptr_in_nursery (*start))
+			return TRUE;
+	}
+	return FALSE;
+}
+
 void
 mono_gc_wbarrier_arrayref_copy (gpointer dest_ptr, gpointer src_ptr, int count)
 {
@@ -5529,32 +5798,30 @@ mono_gc_wbarrier_arrayref_copy (gpointer dest_ptr, gpointer src_ptr, int count)
 #endif
 
 	if (use_cardtable) {
-		gpointer *dest = dest_ptr;
-		gpointer *src = src_ptr;
-
-		/*overlapping that required backward copying*/
-		if (src < dest && (src + count) > dest) {
-			gpointer *start = dest;
-			dest += count - 1;
-			src += count - 1;
-
-			for (; dest >= start; --src, --dest) {
-				gpointer value = *src;
-				*dest = value;
-				if (ptr_in_nursery (value))
-					sgen_card_table_mark_address ((mword)dest);
-				dummy_use (value);
-			}
-		} else {
-			gpointer *end = dest + count;
-			for (; dest < end; ++src, ++dest) {
-				gpointer value = *src;
-				*dest = value;
-				if (ptr_in_nursery (value))
-					sgen_card_table_mark_address ((mword)dest);
-				dummy_use (value);
-			}
-		}
+		/*
+		 * We copy the whole range at once and then check
+		 * whether what we stored contains any nursery
+		 * pointers.  If it does, we mark all the cards it
+		 * spans in one go.  The critical region makes sure no
+		 * collection can happen between the copy and the
+		 * marking.
+		 */
+		TLAB_ACCESS_INIT;
+#ifdef DISABLE_CRITICAL_REGION
+		LOCK_GC;
+#else
+		ENTER_CRITICAL_REGION;
+#endif
+		mono_gc_memmove (dest_ptr, src_ptr, count * sizeof (gpointer));
+		if (range_has_nursery_refs (dest_ptr, count))
+			sgen_card_table_mark_range ((mword)dest_ptr, count * sizeof (gpointer));
+		else
+			HEAVY_STAT (++stat_wbarrier_range_copy_no_nursery_refs);
+#ifdef DISABLE_CRITICAL_REGION
+		UNLOCK_GC;
+#else
+		EXIT_CRITICAL_REGION;
+#endif
 	} else {
 		RememberedSet *rs;
 		TLAB_ACCESS_INIT;
@@ -5718,6 +5985,47 @@ void mono_gc_wbarrier_value_copy_bitmap (gpointer _dest, gpointer _src, int size
 	mword *dest = _dest;
 	mword *src = _src;
 
+	if (use_cardtable) {
+		unsigned bits;
+		mword *slot;
+		gboolean need_mark = FALSE;
+		TLAB_ACCESS_INIT;
+
+		if (ptr_in_nursery (dest) || ptr_on_stack (dest)) {
+			mono_gc_memmove (dest, src, size);
+			return;
+		}
+
+#ifdef SGEN_BINARY_PROTOCOL
+		for (bits = bitmap, slot = src; bits; bits >>= 1, ++slot) {
+			if ((bits & 1) && *slot)
+				binary_protocol_wbarrier (dest + (slot - src), (gpointer)*slot, (gpointer)LOAD_VTABLE (*slot));
+		}
+#endif
+
+		/* Same as mono_gc_wbarrier_arrayref_copy (), but we only look at the reference slots. */
+#ifdef DISABLE_CRITICAL_REGION
+		LOCK_GC;
+#else
+		ENTER_CRITICAL_REGION;
+#endif
+		mono_gc_memmove (dest, src, size);
+		for (bits = bitmap, slot = dest; bits; bits >>= 1, ++slot) {
+			if ((bits & 1) && ptr_in_nursery ((gpointer)*slot)) {
+				need_mark = TRUE;
+				break;
+			}
+		}
+		if (need_mark)
+			sgen_card_table_mark_range ((mword)dest, size);
+#ifdef DISABLE_CRITICAL_REGION
+		UNLOCK_GC;
+#else
+		EXIT_CRITICAL_REGION;
+#endif
+		return;
+	}
+
 	while (size) {
 		if (bitmap & 0x1)
 			mono_gc_wbarrier_generic_store (dest, (MonoObject*)*src);
@@ -5774,7 +6082,10 @@ mono_gc_wbarrier_value_copy (gpointer dest, gpointer src, int count, MonoClass *
 		ENTER_CRITICAL_REGION;
 #endif
 		mono_gc_memmove (dest, src, size);
-		sgen_card_table_mark_range ((mword)dest, size);
+		/* Types with references are always pointer aligned. */
+		if (SGEN_CLASS_HAS_REFERENCES (klass) && !ptr_in_nursery (dest) &&
+				range_has_nursery_refs (dest, size / sizeof (gpointer)))
+			sgen_card_table_mark_range ((mword)dest, size);
 #ifdef DISABLE_CRITICAL_REGION
 		UNLOCK_GC;
 #else
@@ -6502,6 +6813,7 @@ mono_gc_base_init (void)
 	LOCK_INIT (interruption_mutex);
 	LOCK_INIT (global_remset_mutex);
 	LOCK_INIT (pin_queue_mutex);
+	LOCK_INIT (clear_domain_mutex);
 
 	init_user_copy_or_mark_key ();
 
@@ -6807,6 +7119,8 @@ enum {
 	ATYPE_NORMAL,
 	ATYPE_VECTOR,
 	ATYPE_SMALL,
+	ATYPE_STRING,
+	ATYPE_MATRIX,
 	ATYPE_NUM
 };
 
@@ -6838,6 +7152,22 @@ enum {
 #endif
 
 #ifdef MANAGED_ALLOCATION
+/*
+ * Slow path of the rank 2 array allocator, the lower bounds are always 0.
+ */
+static MonoArray*
+mono_gc_alloc_matrix (MonoVTable *vtable, guint32 len1, guint32 len2)
+{
+	uintptr_t lengths [2];
+	intptr_t lower_bounds [2];
+
+	lengths [0] = len1;
+	lengths [1] = len2;
+	lower_bounds [0] = lower_bounds [1] = 0;
+
+	return mono_array_new_full (vtable->domain, vtable->klass, lengths, vtable->klass->byval_arg.type == MONO_TYPE_ARRAY ? lower_bounds : NULL);
+}
+
 /* FIXME: Do this in the JIT, where specialized allocation sequences can be created
  * for each class. This is currently not easy to do, as it is hard to generate basic 
  * blocks + branches, but it is easy with the linear IL codebase.
@@ -6849,8 +7179,10 @@ enum {
 static MonoMethod*
 create_allocator (int atype)
 {
-	int p_var, size_var;
+	int p_var, size_var, len_var = 0, bounds_offset_var = 0;
 	guint32 slowpath_branch, max_size_branch;
+	guint32 len_branches [3];
+	int num_len_branches = 0;
 	MonoMethodBuilder *mb;
 	MonoMethod *res;
 	MonoMethodSignature *csig;
@@ -6874,6 +7206,7 @@ create_allocator (int atype)
 	if (!registered) {
 		mono_register_jit_icall (mono_gc_alloc_obj, "mono_gc_alloc_obj", mono_create_icall_signature ("object ptr int"), FALSE);
 		mono_register_jit_icall (mono_gc_alloc_vector, "mono_gc_alloc_vector", mono_create_icall_signature ("object ptr int int"), FALSE);
+		mono_register_jit_icall (mono_gc_alloc_matrix, "mono_gc_alloc_matrix", mono_create_icall_signature ("object ptr int32 int32"), FALSE);
 		registered = TRUE;
 	}
 
@@ -6886,6 +7219,12 @@ create_allocator (int atype)
 	} else if (atype == ATYPE_VECTOR) {
 		num_params = 2;
 		name = "AllocVector";
+	} else if (atype == ATYPE_STRING) {
+		num_params = 2;
+		name = "AllocString";
+	} else if (atype == ATYPE_MATRIX) {
+		num_params = 3;
+		name = "AllocMatrix";
 	} else {
 		g_assert_not_reached ();
 	}
@@ -6965,6 +7304,70 @@ create_allocator (int atype)
 		mono_mb_set_clauses (mb, 1, clause);
 		mono_mb_patch_branch (mb, pos_leave);
 		/* end catch */
+	} else if (atype == ATYPE_STRING) {
+		/*
+		 * if (len > MAX_SMALL_OBJ_SIZE) goto slowpath, this also sends negative
+		 * lengths to the slow path, which throws.
+		 */
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_icon (mb, MAX_SMALL_OBJ_SIZE);
+		len_branches [num_len_branches ++] = mono_mb_emit_branch (mb, CEE_BGT_UN);
+
+		/* size = sizeof (MonoString) + ((len + 1) * 2); */
+		mono_mb_emit_icon (mb, sizeof (MonoString));
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_icon (mb, 1);
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_icon (mb, 2);
+		mono_mb_emit_byte (mb, CEE_MUL);
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_stloc (mb, size_var);
+	} else if (atype == ATYPE_MATRIX) {
+		/*
+		 * Both lengths are checked against MAX_SMALL_OBJ_SIZE before they are
+		 * multiplied, so nothing below can overflow. Everything larger,
+		 * including negative lengths, is handled by the slow path.
+		 */
+		for (i = 1; i <= 2; ++i) {
+			mono_mb_emit_ldarg (mb, i);
+			mono_mb_emit_icon (mb, MAX_SMALL_OBJ_SIZE);
+			len_branches [num_len_branches ++] = mono_mb_emit_branch (mb, CEE_BGT_UN);
+		}
+
+		/* len = len1 * len2; */
+		len_var = mono_mb_add_local (mb, &mono_defaults.int32_class->byval_arg);
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_ldarg (mb, 2);
+		mono_mb_emit_byte (mb, CEE_MUL);
+		mono_mb_emit_stloc (mb, len_var);
+
+		/* if (len > MAX_SMALL_OBJ_SIZE) goto slowpath */
+		mono_mb_emit_ldloc (mb, len_var);
+		mono_mb_emit_icon (mb, MAX_SMALL_OBJ_SIZE);
+		len_branches [num_len_branches ++] = mono_mb_emit_branch (mb, CEE_BGT_UN);
+
+		/* bounds_offset = (vtable->klass->sizes.element_size * len + sizeof (MonoArray) + 3) & ~3; */
+		bounds_offset_var = mono_mb_add_local (mb, &mono_defaults.int32_class->byval_arg);
+		mono_mb_emit_ldarg (mb, 0);
+		mono_mb_emit_icon (mb, G_STRUCT_OFFSET (MonoVTable, klass));
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_byte (mb, CEE_LDIND_I);
+		mono_mb_emit_icon (mb, G_STRUCT_OFFSET (MonoClass, sizes.element_size));
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_byte (mb, CEE_LDIND_U4);
+		mono_mb_emit_ldloc (mb, len_var);
+		mono_mb_emit_byte (mb, CEE_MUL);
+		mono_mb_emit_icon (mb, sizeof (MonoArray) + 3);
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_icon (mb, ~3);
+		mono_mb_emit_byte (mb, CEE_AND);
+		mono_mb_emit_stloc (mb, bounds_offset_var);
+
+		/* size = bounds_offset + 2 * sizeof (MonoArrayBounds); */
+		mono_mb_emit_ldloc (mb, bounds_offset_var);
+		mono_mb_emit_icon (mb, 2 * sizeof (MonoArrayBounds));
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_stloc (mb, size_var);
 	} else {
 		g_assert_not_reached ();
 	}
@@ -7017,18 +7420,31 @@ create_allocator (int atype)
 	/* Slowpath */
 	if (atype != ATYPE_SMALL)
 		mono_mb_patch_short_branch (mb, max_size_branch);
+	for (i = 0; i < num_len_branches; ++i)
+		mono_mb_patch_branch (mb, len_branches [i]);
 
 	mono_mb_emit_byte (mb, MONO_CUSTOM_PREFIX);
 	mono_mb_emit_byte (mb, CEE_MONO_NOT_TAKEN);
 
 	/* FIXME: mono_gc_alloc_obj takes a 'size_t' as an argument, not an int32 */
-	mono_mb_emit_ldarg (mb, 0);
-	mono_mb_emit_ldloc (mb, size_var);
 	if (atype == ATYPE_NORMAL || atype == ATYPE_SMALL) {
+		mono_mb_emit_ldarg (mb, 0);
+		mono_mb_emit_ldloc (mb, size_var);
 		mono_mb_emit_icall (mb, mono_gc_alloc_obj);
 	} else if (atype == ATYPE_VECTOR) {
+		mono_mb_emit_ldarg (mb, 0);
+		mono_mb_emit_ldloc (mb, size_var);
 		mono_mb_emit_ldarg (mb, 1);
 		mono_mb_emit_icall (mb, mono_gc_alloc_vector);
+	} else if (atype == ATYPE_STRING) {
+		/* This also handles the overflow checks and the allocation profiler */
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_icall (mb, mono_string_alloc);
+	} else if (atype == ATYPE_MATRIX) {
+		mono_mb_emit_ldarg (mb, 0);
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_ldarg (mb, 2);
+		mono_mb_emit_icall (mb, mono_gc_alloc_matrix);
 	} else {
 		g_assert_not_reached ();
 	}
@@ -7059,6 +7475,44 @@ create_allocator (int atype)
 		mono_mb_emit_ldflda (mb, G_STRUCT_OFFSET (MonoArray, max_length));
 		mono_mb_emit_ldarg (mb, 1);
 		mono_mb_emit_byte (mb, CEE_STIND_I);
+	} else if (atype == ATYPE_STRING) {
+		/*
+		 * str->length = len;
+		 * The terminating 0 char doesn't need to be stored since TLABs are cleared.
+		 */
+		mono_mb_emit_ldloc (mb, p_var);
+		mono_mb_emit_ldflda (mb, G_STRUCT_OFFSET (MonoString, length));
+		mono_mb_emit_ldarg (mb, 1);
+		mono_mb_emit_byte (mb, CEE_STIND_I4);
+	} else if (atype == ATYPE_MATRIX) {
+		int bounds_var = mono_mb_add_local (mb, &mono_defaults.int_class->byval_arg);
+
+		/* arr->max_length = len; */
+		mono_mb_emit_ldloc (mb, p_var);
+		mono_mb_emit_ldflda (mb, G_STRUCT_OFFSET (MonoArray, max_length));
+		mono_mb_emit_ldloc (mb, len_var);
+		mono_mb_emit_byte (mb, CEE_CONV_I);
+		mono_mb_emit_byte (mb, CEE_STIND_I);
+
+		/* bounds = (char*)p + bounds_offset; arr->bounds = bounds; */
+		mono_mb_emit_ldloc (mb, p_var);
+		mono_mb_emit_ldloc (mb, bounds_offset_var);
+		mono_mb_emit_byte (mb, CEE_CONV_I);
+		mono_mb_emit_byte (mb, CEE_ADD);
+		mono_mb_emit_stloc (mb, bounds_var);
+		mono_mb_emit_ldloc (mb, p_var);
+		mono_mb_emit_ldflda (mb, G_STRUCT_OFFSET (MonoArray, bounds));
+		mono_mb_emit_ldloc (mb, bounds_var);
+		mono_mb_emit_byte (mb, CEE_STIND_I);
+
+		/* bounds [i].length = len<i>, the lower bounds are left at 0 */
+		for (i = 0; i < 2; ++i) {
+			mono_mb_emit_ldloc (mb, bounds_var);
+			mono_mb_emit_icon (mb, i * sizeof (MonoArrayBounds) + G_STRUCT_OFFSET (MonoArrayBounds, length));
+			mono_mb_emit_byte (mb, CEE_ADD);
+			mono_mb_emit_ldarg (mb, i + 1);
+			mono_mb_emit_byte (mb, CEE_STIND_I);
+		}
 	}
 
 	/*
@@ -7154,11 +7608,11 @@ mono_gc_get_managed_allocator (MonoVTable *vtable, gboolean for_box)
 		return NULL;
 	if (klass->rank)
 		return NULL;
-	if (klass->byval_arg.type == MONO_TYPE_STRING)
-		return NULL;
 	if (collect_before_allocs)
 		return NULL;
 
+	if (klass->byval_arg.type == MONO_TYPE_STRING)
+		return mono_gc_get_managed_allocator_by_type (ATYPE_STRING);
 	if (ALIGN_TO (klass->instance_size, ALLOC_ALIGN) < MAX_SMALL_OBJ_SIZE)
 		return mono_gc_get_managed_allocator_by_type (ATYPE_SMALL);
 	else
@@ -7184,7 +7638,7 @@ mono_gc_get_managed_array_allocator (MonoVTable *vtable, int rank)
 		return NULL;
 #endif
 
-	if (rank != 1)
+	if (rank != 1 && rank != 2)
 		return NULL;
 	if (!mono_runtime_has_tls_get ())
 		return NULL;
@@ -7194,6 +7648,13 @@ mono_gc_get_managed_array_allocator (MonoVTable *vtable, int rank)
 		return NULL;
 	g_assert (!mono_class_has_finalizer (klass) && !klass->marshalbyref);
 
+	if (rank == 2) {
+		/* The rank 2 allocator relies on this to avoid overflow checks */
+		if (klass->sizes.element_size > MAX_SMALL_OBJ_SIZE)
+			return NULL;
+		return mono_gc_get_managed_allocator_by_type (ATYPE_MATRIX);
+	}
+
 	return mono_gc_get_managed_allocator_by_type (ATYPE_VECTOR);
 #else
 	return NULL;
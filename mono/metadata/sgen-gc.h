@@ -117,6 +117,11 @@ struct _SgenThreadInfo {
 	char **tlab_start_addr;
 	char **tlab_temp_end_addr;
 	char **tlab_real_end_addr;
+	/* Adaptive TLAB sizing: the current size and the counters since the last collection */
+	int tlab_size;
+	int tlab_refills;
+	mword tlab_allocated;
+	mword tlab_waste;
 	gpointer **store_remset_buffer_addr;
 	long *store_remset_buffer_index_addr;
 	RememberedSet *remset;
@@ -741,6 +746,19 @@ struct _SgenMajorCollector {
 	void* (*alloc_object) (int size, gboolean has_references);
 	void (*free_pinned_object) (char *obj, size_t size);
 	void (*iterate_objects) (gboolean non_pinned, gboolean pinned, IterateObjectCallbackFunc callback, void *data);
+	/*
+	 * Optional, together with iterate_objects_range ().  Called by
+	 * the GC thread after wait_for_sweep_done () to snapshot the
+	 * blocks, returns their number.
+	 */
+	int (*begin_iterate_objects_range) (void);
+	/*
+	 * Iterates the objects in the blocks with indexes [first_block,
+	 * last_block) of the last begin_iterate_objects_range ()
+	 * snapshot.  Different ranges can be iterated concurrently.
+	 */
+	void (*iterate_objects_range) (int first_block, int last_block, gboolean non_pinned, gboolean pinned, IterateObjectCallbackFunc callback, void *data);
+	void (*wait_for_sweep_done) (void);
 	void (*free_non_pinned_object) (char *obj, size_t size);
 	void (*find_pin_queue_start_ends) (SgenGrayQueue *queue);
 	void (*pin_objects) (SgenGrayQueue *queue);
@@ -766,8 +766,10 @@ major_alloc_object (int size, gboolean has_references)
  * We're not freeing the block if it's empty.  We leave that work for
  * the next major collection.
  *
- * This is just called from the domain clearing code, which runs in a
- * single thread and has the GC lock, so we don't need an extra lock.
+ * This is just called from the domain clearing code, which has the GC
+ * lock.  With the parallel collector the workers free objects
+ * concurrently, but each block is only ever handled by one of them, so
+ * we only need to lock when putting the block on the free list.
  */
 static void
 free_object (char *obj, size_t size, gboolean pinned)
@@ -782,8 +784,14 @@ free_object (char *obj, size_t size, gboolean pinned)
 		MSBlockInfo **free_blocks = FREE_BLOCKS (pinned, block->has_references);
 		int size_index = MS_BLOCK_OBJ_SIZE_INDEX (size);
 		DEBUG (9, g_assert (!block->next_free));
+#ifdef SGEN_PARALLEL_MARK
+		LOCK_MS_BLOCK_LIST;
+#endif
 		block->next_free = free_blocks [size_index];
 		free_blocks [size_index] = block;
+#ifdef SGEN_PARALLEL_MARK
+		UNLOCK_MS_BLOCK_LIST;
+#endif
 	}
 	memset (obj, 0, size);
 	*(void**)obj = block->free_list;
@@ -895,6 +903,24 @@ major_ptr_is_in_non_pinned_space (char *ptr)
 	return FALSE;
 }
 
+static void
+iterate_block_objects (MSBlockInfo *block, gboolean non_pinned, gboolean pinned, IterateObjectCallbackFunc callback, void *data)
+{
+	int count = MS_BLOCK_FREE / block->obj_size;
+	int i;
+
+	if (block->pinned && !pinned)
+		return;
+	if (!block->pinned && !non_pinned)
+		return;
+
+	for (i = 0; i < count; ++i) {
+		void **obj = (void**) MS_BLOCK_OBJ (block, i);
+		if (MS_OBJ_ALLOCED (obj, block))
+			callback ((char*)obj, block->obj_size, data);
+	}
+}
+
 static void
 major_iterate_objects (gboolean non_pinned, gboolean pinned, IterateObjectCallbackFunc callback, void *data)
 {
@@ -903,20 +929,64 @@ major_iterate_objects (gboolean non_pinned, gboolean pinned, IterateObjectCallba
 	ms_wait_for_sweep_done ();
 
 	FOREACH_BLOCK (block) {
-		int count = MS_BLOCK_FREE / block->obj_size;
-		int i;
+		iterate_block_objects (block, non_pinned, pinned, callback, data);
+	} END_FOREACH_BLOCK;
+}
 
-		if (block->pinned && !pinned)
-			continue;
-		if (!block->pinned && !non_pinned)
-			continue;
+/*
+ * The blocks at the time of the last major_begin_iterate_objects_range (),
+ * so each range can find its first block in constant time.
+ */
+static MSBlockInfo **range_blocks;
+static int range_blocks_size;
+static int num_range_blocks;
 
-		for (i = 0; i < count; ++i) {
-			void **obj = (void**) MS_BLOCK_OBJ (block, i);
-			if (MS_OBJ_ALLOCED (obj, block))
-				callback ((char*)obj, block->obj_size, data);
-		}
+/*
+ * Called by the GC thread after it waited for the sweep, before handing
+ * out the ranges.
+ */
+static int
+major_begin_iterate_objects_range (void)
+{
+	MSBlockInfo *block;
+	int count = 0;
+
+	g_assert (!ms_sweep_in_progress);
+
+	FOREACH_BLOCK (block) {
+		++count;
 	} END_FOREACH_BLOCK;
+
+	if (count > range_blocks_size) {
+		if (range_blocks)
+			mono_sgen_free_internal_dynamic (range_blocks, sizeof (MSBlockInfo*) * range_blocks_size, INTERNAL_MEM_MS_TABLES);
+		range_blocks_size = count * 2;
+		range_blocks = mono_sgen_alloc_internal_dynamic (sizeof (MSBlockInfo*) * range_blocks_size, INTERNAL_MEM_MS_TABLES);
+	}
+
+	num_range_blocks = 0;
+	FOREACH_BLOCK (block) {
+		range_blocks [num_range_blocks++] = block;
+	} END_FOREACH_BLOCK;
+
+	return num_range_blocks;
+}
+
+/*
+ * This is called concurrently from the workers, so it must not wait
+ * for the sweep - the GC thread does that before handing out the
+ * ranges.
+ */
+static void
+major_iterate_objects_range (int first_block, int last_block, gboolean non_pinned, gboolean pinned, IterateObjectCallbackFunc callback, void *data)
+{
+	int i;
+
+	g_assert (!ms_sweep_in_progress);
+	g_assert (last_block <= num_range_blocks);
+
+	for (i = first_block; i < last_block; ++i)
+		iterate_block_objects (range_blocks [i], non_pinned, pinned, callback, data);
 }
 
 static void
@@ -2062,6 +2132,9 @@ mono_sgen_marksweep_init
 	collector->alloc_object = major_alloc_object;
 	collector->free_pinned_object = free_pinned_object;
 	collector->iterate_objects = major_iterate_objects;
+	collector->begin_iterate_objects_range = major_begin_iterate_objects_range;
+	collector->iterate_objects_range = major_iterate_objects_range;
+	collector->wait_for_sweep_done = ms_wait_for_sweep_done;
 	collector->free_non_pinned_object = major_free_non_pinned_object;
 	collector->find_pin_queue_start_ends = major_find_pin_queue_start_ends;
 	collector->pin_objects = major_pin_objects;
@@ -65,6 +65,12 @@ static int verbose_level;
 #define MONO_NEGATED_RELATION(r) ((~(r))&MONO_ANY_RELATION)
 #define MONO_SYMMETRIC_RELATION(r) (((r)&MONO_EQ_RELATION)|(((r)&MONO_LT_RELATION)<<1)|((r&MONO_GT_RELATION)>>1))
 
+/* Whenever the relations of VAR hold everywhere it is used */
+#define IS_SSA_VARIABLE(area,var) ((area)->def_counts [(var)] <= 1)
+
+/* Deltas are ints, and applying them to ranges must not overflow */
+#define MONO_ABC_SAFE_DELTA(d) ((d) > -0x40000000 && (d) < 0x40000000)
+
 
 
 static void
@@ -271,6 +277,12 @@ get_relation_from_ins (MonoVariableRelationsEvaluationArea *area, MonoInst *ins,
 		value->value.constant.value = ins->inst_c0;
 		break;
 	case OP_MOVE:
+	case OP_ICONV_TO_I4:
+	case OP_SEXT_I4:
+		/*
+		 * 64 bit targets sign extend array indexes before the bounds check, this
+		 * doesn't change their value.
+		 */
 		value->type = MONO_VARIABLE_SUMMARIZED_VALUE;
 		value->value.variable.variable = ins->sreg1;
 		value->value.variable.delta = 0;
@@ -281,6 +293,8 @@ get_relation_from_ins (MonoVariableRelationsEvaluationArea *area, MonoInst *ins,
 		value->value.phi.phi_alternatives = ins->inst_phi_args + 1;
 		break;
 	case OP_IADD_IMM:
+		if (!MONO_ABC_SAFE_DELTA (ins->inst_imm))
+			break;
 		value->type = MONO_VARIABLE_SUMMARIZED_VALUE;
 		value->value.variable.variable = ins->sreg1;
 		value->value.variable.delta = ins->inst_imm;
@@ -288,9 +302,11 @@ get_relation_from_ins (MonoVariableRelationsEvaluationArea *area, MonoInst *ins,
 		//check_delta_safety (area, result);
 		break;
 	case OP_ISUB_IMM:
+		if (!MONO_ABC_SAFE_DELTA (ins->inst_imm))
+			break;
 		value->type = MONO_VARIABLE_SUMMARIZED_VALUE;
 		value->value.variable.variable = ins->sreg1;
-		value->value.variable.delta = ins->inst_imm;
+		value->value.variable.delta = - ins->inst_imm;
 		/* FIXME: */
 		//check_delta_safety (area, result);
 		break;
@@ -302,10 +318,20 @@ get_relation_from_ins (MonoVariableRelationsEvaluationArea *area, MonoInst *ins,
 		value->value.variable.delta = 0;
 		value_kind = MONO_UNSIGNED_INTEGER_VALUE_SIZE_4;
 		break;
+	case OP_IAND_IMM:
+		/* Masking with a positive constant gives 0 <= x <= the constant */
+		if (ins->inst_imm >= 0 && ins->inst_imm <= G_MAXINT32) {
+			result->relation = MONO_LE_RELATION;
+			value->type = MONO_CONSTANT_SUMMARIZED_VALUE;
+			value->value.constant.value = ins->inst_imm;
+			value_kind = MONO_UNSIGNED_INTEGER_VALUE_SIZE_4;
+		}
+		break;
 	case OP_LDLEN:
+	case OP_STRLEN:
 		/*
 		 * We represent arrays by their length, so r1<-ldlen r2 is stored
-		 * as r1 == r2 in the evaluation graph.
+		 * as r1 == r2 in the evaluation graph. Strings are handled the same way.
 		 */
 		value->type = MONO_VARIABLE_SUMMARIZED_VALUE;
 		value->value.variable.variable = ins->sreg1;
@@ -383,11 +409,14 @@ get_relation_from_ins (MonoVariableRelationsEvaluationArea *area, MonoInst *ins,
 }
 
 static MonoValueRelation
-get_relation_from_branch_instruction (MonoInst *ins)
+get_relation_from_branch_instruction (MonoInst *ins, gboolean *is_unsigned)
 {
+	*is_unsigned = FALSE;
 	if (MONO_IS_COND_BRANCH_OP (ins)) {
 		CompRelation rel = mono_opcode_to_cond (ins->opcode);
 
+		*is_unsigned = rel == CMP_LE_UN || rel == CMP_GE_UN || rel == CMP_LT_UN || rel == CMP_GT_UN;
+
 		switch (rel) {
 		case CMP_EQ:
 			return MONO_EQ_RELATION;
@@ -427,7 +456,7 @@ get_relations_from_previous_bb (MonoVariableRelationsEvaluationArea *area, MonoB
 	MonoInst *ins, *compare, *branch;
 	MonoValueRelation branch_relation;
 	MonoValueRelation symmetric_relation;
-	gboolean code_path;
+	gboolean code_path, is_unsigned;
 	
 	INITIALIZE_VALUE_RELATION (&(relations->relation1.relation));
 	relations->relation1.relation.relation_is_static_definition = FALSE;
@@ -451,7 +480,7 @@ get_relations_from_previous_bb (MonoVariableRelationsEvaluationArea *area, MonoB
 
 		compare = ins;
 		branch = ins->next;
-		branch_relation = get_relation_from_branch_instruction (branch);
+		branch_relation = get_relation_from_branch_instruction (branch, &is_unsigned);
 
 		if (branch_relation != MONO_ANY_RELATION) {
 			if (branch->inst_true_bb == bb) {
@@ -467,7 +496,24 @@ get_relations_from_previous_bb (MonoVariableRelationsEvaluationArea *area, MonoB
 			symmetric_relation = MONO_SYMMETRIC_RELATION (branch_relation);
 
 			/* FIXME: Other compare opcodes */
-			if (compare->opcode == OP_ICOMPARE) {
+			if (is_unsigned) {
+				/*
+				 * An unsigned x < c or x <= c, with c >= 0, means 0 <= x < c or x <= c. Other
+				 * unsigned relations say nothing about the signed values.
+				 */
+				if (compare->opcode == OP_ICOMPARE_IMM && compare->inst_imm >= 0 && compare->inst_imm <= G_MAXINT32 && IS_SSA_VARIABLE (area, compare->sreg1) &&
+					(branch_relation == MONO_LT_RELATION || branch_relation == MONO_LE_RELATION || branch_relation == MONO_EQ_RELATION)) {
+					relations->relation1.variable = compare->sreg1;
+					relations->relation1.relation.relation = branch_relation;
+					relations->relation1.relation.related_value.type = MONO_CONSTANT_SUMMARIZED_VALUE;
+					relations->relation1.relation.related_value.value.constant.value = compare->inst_imm;
+
+					relations->relation2.variable = compare->sreg1;
+					relations->relation2.relation.relation = MONO_GE_RELATION;
+					relations->relation2.relation.related_value.type = MONO_CONSTANT_SUMMARIZED_VALUE;
+					relations->relation2.relation.related_value.value.constant.value = 0;
+				}
+			} else if (compare->opcode == OP_ICOMPARE && IS_SSA_VARIABLE (area, compare->sreg1) && IS_SSA_VARIABLE (area, compare->sreg2)) {
 				relations->relation1.variable = compare->sreg1;
 				relations->relation1.relation.relation = branch_relation;
 				relations->relation1.relation.related_value.type = MONO_VARIABLE_SUMMARIZED_VALUE;
@@ -479,7 +525,7 @@ get_relations_from_previous_bb (MonoVariableRelationsEvaluationArea *area, MonoB
 				relations->relation2.relation.related_value.type = MONO_VARIABLE_SUMMARIZED_VALUE;
 				relations->relation2.relation.related_value.value.variable.variable = compare->sreg1;
 				relations->relation2.relation.related_value.value.variable.delta = 0;
-			} else if (compare->opcode == OP_ICOMPARE_IMM) {
+			} else if (compare->opcode == OP_ICOMPARE_IMM && IS_SSA_VARIABLE (area, compare->sreg1)) {
 				relations->relation1.variable = compare->sreg1;
 				relations->relation1.relation.relation = branch_relation;
 				relations->relation1.relation.related_value.type = MONO_CONSTANT_SUMMARIZED_VALUE;
@@ -973,7 +1019,11 @@ remove_abc_from_inst (MonoInst *ins, MonoVariableRelationsEvaluationArea *area)
 	int index_variable = ins->sreg2;
 	MonoRelationsEvaluationContext *array_context = &(area->contexts [array_variable]);
 	MonoRelationsEvaluationContext *index_context = &(area->contexts [index_variable]);
-				
+
+	area->bounds_checks ++;
+	if (!IS_SSA_VARIABLE (area, array_variable) || !IS_SSA_VARIABLE (area, index_variable))
+		return;
+
 	clean_contexts (area->contexts, area->cfg->next_vreg);
 				
 	evaluate_relation_with_target_variable (area, index_variable, array_variable, NULL);
@@ -983,8 +1033,13 @@ remove_abc_from_inst (MonoInst *ins, MonoVariableRelationsEvaluationArea *area)
 		if (REPORT_ABC_REMOVAL) {
 			printf ("ARRAY-ACCESS: removed bounds check on array %d with index %d\n",
 					array_variable, index_variable);
-			NULLIFY_INS (ins);
 		}
+		/*
+		 * The array can't be null, since its length is known to be greater than the
+		 * index, so the null check done by the bounds check is not needed either.
+		 */
+		NULLIFY_INS (ins);
+		area->removed_bounds_checks ++;
 	} else {
 		if (TRACE_ABC_REMOVAL) {
 			if (index_context->ranges.zero.lower >= 0) {
@@ -1093,7 +1148,7 @@ process_block (MonoCompile *cfg, MonoBasicBlock *bb, MonoVariableRelationsEvalua
 			remove_abc_from_inst (ins, area);
 
 			/* We can derive additional relations from the bounds check */
-			if (ins->opcode != OP_NOP) {
+			if (ins->opcode != OP_NOP && IS_SSA_VARIABLE (area, array_var) && IS_SSA_VARIABLE (area, index_var)) {
 				rel = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoAdditionalVariableRelation));
 				rel->variable = index_var;
 				rel->relation.relation = MONO_LT_RELATION;
@@ -1117,7 +1172,7 @@ process_block (MonoCompile *cfg, MonoBasicBlock *bb, MonoVariableRelationsEvalua
 			}
 		}
 
-		if (ins->opcode == OP_CHECK_THIS) {
+		if (ins->opcode == OP_CHECK_THIS && IS_SSA_VARIABLE (area, ins->sreg1)) {
 			if (eval_non_null (area, ins->sreg1)) {
 				if (REPORT_ABC_REMOVAL)
 					printf ("ARRAY-ACCESS: removed check_this instruction.\n");
@@ -1125,7 +1180,7 @@ process_block (MonoCompile *cfg, MonoBasicBlock *bb, MonoVariableRelationsEvalua
 			}
 		}
 
-		if (ins->opcode == OP_NOT_NULL)
+		if (ins->opcode == OP_NOT_NULL && IS_SSA_VARIABLE (area, ins->sreg1))
 			add_non_null (area, cfg, ins->sreg1, &check_relations);
 
 		/* 
@@ -1264,6 +1319,9 @@ mono_perform_abc_removal (MonoCompile *cfg)
 	area.variable_value_kind = (MonoIntegerValueKind *)
 		mono_mempool_alloc (cfg->mempool, sizeof (MonoIntegerValueKind) * (cfg->next_vreg));
 	area.defs = mono_mempool_alloc (cfg->mempool, sizeof (MonoInst*) * cfg->next_vreg);
+	area.def_counts = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * cfg->next_vreg);
+	area.bounds_checks = 0;
+	area.removed_bounds_checks = 0;
 	for (i = 0; i < cfg->next_vreg; i++) {
 		area.variable_value_kind [i] = MONO_UNKNOWN_INTEGER_VALUE;
 		area.relations [i].relation = MONO_EQ_RELATION;
@@ -1273,6 +1331,21 @@ mono_perform_abc_removal (MonoCompile *cfg)
 		area.defs [i] = NULL;
 	}
 
+	/*
+	 * Variables which are not in SSA form, like volatile ones, can have more than one
+	 * definition, so the relations found at one of them don't hold everywhere.
+	 */
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		MonoInst *ins;
+
+		for (ins = bb->code; ins; ins = ins->next) {
+			const char *spec = INS_INFO (ins->opcode);
+
+			if (spec [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg != -1)
+				area.def_counts [ins->dreg] ++;
+		}
+	}
+
 	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
 		MonoInst *ins;
 
@@ -1285,7 +1358,8 @@ mono_perform_abc_removal (MonoCompile *cfg)
 			if (spec [MONO_INST_DEST] == ' ' || MONO_IS_STORE_MEMBASE (ins))
 				continue;
 
-			if (spec [MONO_INST_DEST] == 'i') {
+			/* Sign extended indexes are 'l' on 64 bit targets */
+			if ((spec [MONO_INST_DEST] == 'i' || (SIZEOF_REGISTER == 8 && ins->opcode == OP_SEXT_I4)) && IS_SSA_VARIABLE (&area, ins->dreg)) {
 				MonoIntegerValueKind effective_value_kind;
 				MonoRelationsEvaluationRange range;
 				MonoSummarizedValueRelation *type_relation;
@@ -1299,6 +1373,9 @@ mono_perform_abc_removal (MonoCompile *cfg)
 					area.variable_value_kind [ins->dreg] = type_to_value_kind (var->inst_vtype);
 
 				effective_value_kind = get_relation_from_ins (&area, ins, &area.relations [ins->dreg], area.variable_value_kind [ins->dreg]);
+				if (area.relations [ins->dreg].related_value.type == MONO_VARIABLE_SUMMARIZED_VALUE &&
+					!IS_SSA_VARIABLE (&area, area.relations [ins->dreg].related_value.value.variable.variable))
+					MAKE_VALUE_RELATION_ANY (&area.relations [ins->dreg]);
 
 				MONO_MAKE_RELATIONS_EVALUATION_RANGE_WEAK (range);
 				apply_value_kind_to_range (&range, area.variable_value_kind [ins->dreg]);
@@ -1361,6 +1438,13 @@ mono_perform_abc_removal (MonoCompile *cfg)
 	}
 
 	process_block (cfg, cfg->bblocks [0], &area);
+
+	cfg->stat_bounds_checks_removed += area.removed_bounds_checks;
+	if (area.removed_bounds_checks && cfg->verbose_level > 0) {
+		char *name = mono_method_full_name (cfg->method, TRUE);
+		printf ("ABCREM: removed %d of %d bounds checks in %s\n", area.removed_bounds_checks, area.bounds_checks, name);
+		g_free (name);
+	}
 }
 
 #endif /* DISABLE_JIT */
@@ -304,6 +304,11 @@ typedef struct MonoRelationsEvaluationContext {
  * variable_value_kind: an array of MonoIntegerValueKind, one for each local
  *                      variable (or argument)
  * defs: maps vregs to the instruction which defines it.
+ * def_counts: the number of definitions of each vreg. Only vregs which are
+ *             defined at most once have meaningful relations, the others are
+ *             variables which are not in SSA form (like volatile ones).
+ * bounds_checks: the number of bounds checks seen.
+ * removed_bounds_checks: the number of bounds checks removed.
  */
 typedef struct MonoVariableRelationsEvaluationArea {
 	MonoCompile *cfg;
@@ -311,6 +316,9 @@ typedef struct MonoVariableRelationsEvaluationArea {
 	MonoRelationsEvaluationContext *contexts;
 	MonoIntegerValueKind *variable_value_kind;
 	MonoInst **defs;
+	int *def_counts;
+	int bounds_checks;
+	int removed_bounds_checks;
 } MonoVariableRelationsEvaluationArea;
 
 /**
@@ -739,6 +739,149 @@ class Tests {
 			return 2;
 		return 0;
 	}
+
+	static int loop_invariant_sum (int[] arr, int n, int k) {
+		int sum = 0;
+
+		for (int i = 0; i < n; ++i)
+			sum += arr [i] * (k + 3) + arr.Length;
+		return sum;
+	}
+
+	public static int test_0_loop_invariants () {
+		int[] arr = new int [] { 1, 2, 3, 4 };
+
+		if (loop_invariant_sum (arr, 4, 2) != 66)
+			return 1;
+		/* The loads from ARR must not be executed when the loop body isn't */
+		if (loop_invariant_sum (null, 0, 2) != 0)
+			return 2;
+		try {
+			loop_invariant_sum (null, 1, 2);
+			return 3;
+		} catch (NullReferenceException) {
+		}
+		return 0;
+	}
+
+	static int length_loop_sum (int[] arr, string s) {
+		int sum = 0;
+
+		for (int i = 0; i < arr.Length; ++i)
+			sum += arr [i];
+		for (int i = 0; i < s.Length; ++i)
+			sum += s [i];
+		return sum;
+	}
+
+	/* The hoisted Length loads need to be lowered in the loop preheader */
+	public static int test_0_loop_invariant_length () {
+		if (length_loop_sum (new int [] { 1, 2, 3 }, "AB") != 6 + 65 + 66)
+			return 1;
+		if (length_loop_sum (new int [0], "") != 0)
+			return 2;
+		return 0;
+	}
+
+	static int shifted_sum (int[] arr, int start) {
+		int sum = 0;
+
+		for (int i = start; i < arr.Length - 1; i++)
+			sum += arr [i + 1];
+		return sum;
+	}
+
+	public static int test_0_abcrem_loops () {
+		int[] arr = new int [] { 1, 2, 3, 4 };
+		string s = "abcd";
+		int sum = 0;
+
+		if (shifted_sum (arr, 0) != 9 || shifted_sum (arr, 2) != 4)
+			return 1;
+		try {
+			shifted_sum (arr, -2);
+			return 2;
+		} catch (IndexOutOfRangeException) {
+		}
+
+		for (int i = 0; i < s.Length; ++i)
+			sum += s [i];
+		if (sum != 394)
+			return 3;
+
+		sum = 0;
+		for (int i = 0; i < 100; ++i)
+			sum += arr [i & 3];
+		if (sum != 250)
+			return 4;
+		return 0;
+	}
+
+	static void vector_muladd (int[] a, int[] b, int[] c, int k) {
+		for (int i = 0; i < c.Length; ++i)
+			c [i] = a [i] * b [i] + k;
+	}
+
+	static int vector_sum (int[] a, int start, int end) {
+		int sum = 0;
+
+		for (int i = start; i < end; ++i)
+			sum += a [i] ^ 1;
+		return sum;
+	}
+
+	static void vector_scale (double[] a, double[] b, double f) {
+		for (int i = 0; i < a.Length; ++i)
+			b [i] = a [i] * f;
+	}
+
+	public static int test_0_vectorized_loops () {
+		int[] a = new int [11], b = new int [11], c = new int [11];
+		double[] d = new double [5], e = new double [5];
+
+		for (int i = 0; i < a.Length; ++i) {
+			a [i] = i;
+			b [i] = i + 1;
+		}
+		vector_muladd (a, b, c, 3);
+		for (int i = 0; i < c.Length; ++i)
+			if (c [i] != i * (i + 1) + 3)
+				return 1;
+
+		/* The remaining iterations run the original loop */
+		if (vector_sum (a, 0, 11) != 56 || vector_sum (a, 3, 10) != 41 || vector_sum (a, 5, 2) != 0)
+			return 2;
+		/* limit - i overflows, the loop doesn't run */
+		if (vector_sum (new int [5], 20, int.MinValue + 10) != 0)
+			return 8;
+
+		/* The original loop throws the exceptions */
+		try {
+			vector_sum (a, 8, 13);
+			return 3;
+		} catch (IndexOutOfRangeException) {
+		}
+		try {
+			vector_muladd (a, new int [3], c, 3);
+			return 4;
+		} catch (IndexOutOfRangeException) {
+		}
+		if (c [0] != 3 || c [2] != 3)
+			return 5;
+		try {
+			vector_muladd (a, null, c, 3);
+			return 6;
+		} catch (NullReferenceException) {
+		}
+
+		for (int i = 0; i < d.Length; ++i)
+			d [i] = i + 0.5;
+		vector_scale (d, e, 2.0);
+		for (int i = 0; i < e.Length; ++i)
+			if (e [i] != 2 * i + 1)
+				return 7;
+		return 0;
+	}
 }
 
 
@@ -1456,4 +1456,142 @@ mono_optimize_branches (MonoCompile *cfg)
 	} while (changed && (niterations > 0));
 }
 
+static void
+pin_bblock_at_offset (MonoCompile *cfg, guint8 *pinned, int max_num, guint32 offset)
+{
+	MonoBasicBlock *bb;
+
+	if (offset >= cfg->cil_offset_to_bb_len)
+		return;
+	bb = cfg->cil_offset_to_bb [offset];
+	if (bb && bb->block_num <= max_num)
+		pinned [bb->block_num] = TRUE;
+}
+
+/*
+ * mono_layout_cold_bblocks:
+ *
+ *   Move the bblocks which are unlikely to be executed after the method epilog, so
+ * the hot code of the method is contiguous. A bblock is cold if it is marked as
+ * out_of_line (it throws or it is marked as not taken), or if all its successors or
+ * all its predecessors are cold. Only bblocks outside of exception clauses are moved,
+ * since the clause ranges in the MonoJitInfo are computed from the native offsets of
+ * the bblocks at the clause boundaries.
+ */
+void
+mono_layout_cold_bblocks (MonoCompile *cfg)
+{
+	MonoMethodHeader *header = cfg->header;
+	MonoBasicBlock *bb, *next, *prev, *cold_first, *cold_last, *target;
+	MonoBasicBlock **old_next;
+	guint8 *cold, *pinned;
+	gboolean changed, all_cold;
+	int i, max_num, ncold;
+
+	max_num = 0;
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb)
+		max_num = MAX (max_num, bb->block_num);
+
+	cold = mono_mempool_alloc0 (cfg->mempool, max_num + 1);
+	pinned = mono_mempool_alloc0 (cfg->mempool, max_num + 1);
+	old_next = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoBasicBlock*) * (max_num + 1));
+
+#define IS_COLD(b) ((b)->block_num <= max_num && cold [(b)->block_num])
+
+	pinned [cfg->bb_entry->block_num] = TRUE;
+	pinned [cfg->bb_exit->block_num] = TRUE;
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		old_next [bb->block_num] = bb->next_bb;
+		/* The extended try range covers the end of the previous bblock */
+		if (bb->region != -1 || (bb->next_bb && bb->next_bb->extend_try_block))
+			pinned [bb->block_num] = TRUE;
+	}
+	for (i = 0; i < header->num_clauses; ++i) {
+		MonoExceptionClause *clause = &header->clauses [i];
+
+		pin_bblock_at_offset (cfg, pinned, max_num, clause->try_offset + clause->try_len);
+		pin_bblock_at_offset (cfg, pinned, max_num, clause->handler_offset + clause->handler_len);
+	}
+
+	/* Propagate coldness until a fixed point is reached */
+	ncold = 0;
+	do {
+		changed = FALSE;
+		for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+			if (cold [bb->block_num] || pinned [bb->block_num])
+				continue;
+
+			all_cold = bb->out_of_line;
+			if (!all_cold && bb->out_count > 0) {
+				all_cold = TRUE;
+				for (i = 0; i < bb->out_count; ++i)
+					if (!IS_COLD (bb->out_bb [i]))
+						all_cold = FALSE;
+			}
+			if (!all_cold && bb->in_count > 0) {
+				all_cold = TRUE;
+				for (i = 0; i < bb->in_count; ++i)
+					if (!IS_COLD (bb->in_bb [i]))
+						all_cold = FALSE;
+			}
+			if (all_cold) {
+				cold [bb->block_num] = TRUE;
+				ncold ++;
+				changed = TRUE;
+			}
+		}
+	} while (changed);
+
+	if (!ncold)
+		return;
+
+	/* Move the cold bblocks to the end, keeping their relative order */
+	prev = NULL;
+	cold_first = cold_last = NULL;
+	for (bb = cfg->bb_entry; bb; bb = next) {
+		next = bb->next_bb;
+		if (cold [bb->block_num]) {
+			/* The entry bblock is pinned, so prev is set */
+			prev->next_bb = next;
+			bb->next_bb = NULL;
+			if (cold_last)
+				cold_last->next_bb = bb;
+			else
+				cold_first = bb;
+			cold_last = bb;
+			if (cfg->verbose_level > 2)
+				g_print ("cold bblock BB%d moved to the end of the method.\n", bb->block_num);
+		} else {
+			prev = bb;
+		}
+	}
+	prev->next_bb = cold_first;
+
+	/*
+	 * Add branches to the bblocks which used to be reached by falling through.
+	 * Conditional branches with a false target are handled before codegen.
+	 */
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		MonoInst *ins;
+
+		target = old_next [bb->block_num];
+		if (!target || bb->next_bb == target || !mono_bblocks_linked (bb, target))
+			continue;
+		if (bb->last_ins) {
+			if (bb->last_ins->opcode == OP_NOT_REACHED)
+				continue;
+			if (MONO_IS_COND_BRANCH_OP (bb->last_ins) ? bb->last_ins->inst_false_bb != NULL : MONO_IS_BRANCH_OP (bb->last_ins))
+				continue;
+		}
+
+		MONO_INST_NEW (cfg, ins, OP_BR);
+		ins->inst_target_bb = target;
+		MONO_ADD_INS (bb, ins);
+	}
+
+#undef IS_COLD
+
+	cfg->stat_cold_bblocks += ncold;
+}
+
 #endif /* DISABLE_JIT */
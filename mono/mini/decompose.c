@@ -1377,6 +1377,10 @@ mono_decompose_array_access_opts (MonoCompile *cfg)
 						dest->dreg = ins->dreg;
 					}
 					break;
+				case OP_NEWOBJ:
+					dest = mini_emit_alloc_obj (cfg, ins->inst_newobj_vtable, ins->inst_newobj_for_box);
+					dest->dreg = ins->dreg;
+					break;
 				case OP_STRLEN:
 					MONO_EMIT_NEW_LOAD_MEMBASE_OP_FLAGS (cfg, OP_LOADI4_MEMBASE, ins->dreg,
 														 ins->sreg1, G_STRUCT_OFFSET (MonoString, length), ins->flags | MONO_INST_CONSTANT_LOAD);
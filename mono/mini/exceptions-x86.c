@@ -781,10 +781,16 @@ mono_arch_find_jit_info (MonoDomain *domain, MonoJitTlsData *jit_tls,
 		regs [X86_EDI] = new_ctx->edi;
 		regs [X86_NREG] = new_ctx->eip;
 
-		mono_unwind_frame (unwind_info, unwind_info_len, ji->code_start, 
-						   (guint8*)ji->code_start + ji->code_size,
-						   ip, regs, MONO_MAX_IREGS + 1,
-						   save_locations, MONO_MAX_IREGS, &cfa);
+		if (ji->from_aot)
+			mono_unwind_frame (unwind_info, unwind_info_len, ji->code_start, 
+							   (guint8*)ji->code_start + ji->code_size,
+							   ip, regs, MONO_MAX_IREGS + 1,
+							   save_locations, MONO_MAX_IREGS, &cfa);
+		else
+			mono_unwind_frame_cached (ji->used_regs, ji->code_start,
+									  (guint8*)ji->code_start + ji->code_size,
+									  ip, regs, MONO_MAX_IREGS + 1,
+									  save_locations, MONO_MAX_IREGS, &cfa);
 
 		new_ctx->eax = regs [X86_EAX];
 		new_ctx->ebx = regs [X86_EBX];
@@ -882,7 +882,7 @@ static int ccount = 0;
 			ins->inst_imm = G_STRUCT_OFFSET (array_type, array_length_field); \
 			ins->flags |= MONO_INST_FAULT; \
 			MONO_ADD_INS ((cfg)->cbb, ins);								\
-			(cfg)->flags |= MONO_CFG_HAS_ARRAY_ACCESS;					\
+			(cfg)->flags |= MONO_CFG_HAS_ARRAY_ACCESS | MONO_CFG_HAS_LDELEMA; \
 			(cfg)->cbb->has_array_access = TRUE;						\
 		}																\
 		}																\
@@ -17,6 +17,7 @@
 #endif
 
 #include "jit-icalls.h"
+#include <mono/utils/mono-memory-model.h>
 
 void*
 mono_ldftn (MonoMethod *method)
@@ -1047,6 +1048,18 @@ mono_object_castclass (MonoObject *obj, MonoClass *klass)
 	return NULL;
 }
 
+/*
+ * The result of casting a transparent proxy or a COM object depends on the object,
+ * not only on its vtable, so it can't be cached.
+ */
+static inline gboolean
+cast_result_is_cacheable (MonoObject *obj)
+{
+	MonoClass *klass = obj->vtable->klass;
+
+	return klass != mono_defaults.transparent_proxy_class && !klass->is_com_object;
+}
+
 MonoObject*
 mono_object_castclass_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cache)
 {
@@ -1068,7 +1081,8 @@ mono_object_castclass_with_cache (MonoObject *obj, MonoClass *klass, gpointer *c
 		return obj;
 
 	if (mono_object_isinst (obj, klass)) {
-		*cache = obj_vtable;
+		if (cast_result_is_cacheable (obj))
+			*cache = obj_vtable;
 		return obj;
 	}
 
@@ -1099,11 +1113,13 @@ mono_object_isinst_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cach
 	}
 
 	if (mono_object_isinst (obj, klass)) {
-		*cache = (gpointer)obj_vtable;
+		if (cast_result_is_cacheable (obj))
+			*cache = (gpointer)obj_vtable;
 		return obj;
 	} else {
 		/*negative cache*/
-		*cache = (gpointer)(obj_vtable | 0x1);
+		if (cast_result_is_cacheable (obj))
+			*cache = (gpointer)(obj_vtable | 0x1);
 		return NULL;
 	}
 }
@@ -1122,3 +1138,57 @@ mono_get_native_calli_wrapper (MonoImage *image, MonoMethodSignature *sig, gpoin
 
 	return mono_compile_method (m);
 }
+
+/* The number of misses of a full MonoPicCache after which it is marked megamorphic */
+#define MONO_PIC_MEGAMORPHIC_MISSES 16
+
+/*
+ * mono_pic_miss:
+ *
+ *   Called by call sites using CACHE when the vtable of the receiver OBJ is not in the
+ * cache, before making the normal interface call. Add the vtable to the cache if its
+ * implementation of the method has been compiled already, otherwise the normal call
+ * compiles it, and a later miss adds it. Mark the cache megamorphic if it stays full.
+ */
+void
+mono_pic_miss (MonoObject *obj, MonoPicCache *cache)
+{
+	MonoDomain *domain = mono_domain_get ();
+	MonoVTable *vtable = obj->vtable;
+	MonoMethod *method;
+	gpointer code;
+	int i;
+
+	if (mono_jit_stats.enabled)
+		InterlockedIncrement (&mono_jit_stats.pic_misses);
+
+	/* The code called through the vtables of these classes is not the method itself */
+	if (vtable->klass == mono_defaults.transparent_proxy_class || vtable->klass->valuetype || vtable->klass->is_com_object)
+		return;
+
+	method = mono_object_get_virtual_method (obj, cache->method);
+	if (mono_method_signature (method)->generic_param_count || (method->iflags & METHOD_IMPL_ATTRIBUTE_SYNCHRONIZED))
+		return;
+
+	code = mono_jit_find_compiled_method (domain, method);
+	if (!code)
+		return;
+
+	mono_domain_lock (domain);
+	for (i = 0; i < MONO_PIC_SIZE; ++i) {
+		if (cache->vtables [i] == vtable)
+			break;
+		if (!cache->vtables [i]) {
+			cache->targets [i] = code;
+			/* Call sites check the vtable first */
+			mono_memory_barrier ();
+			cache->vtables [i] = vtable;
+			break;
+		}
+	}
+	if (i == MONO_PIC_SIZE && ++cache->misses_when_full == MONO_PIC_MEGAMORPHIC_MISSES) {
+		cache->megamorphic = TRUE;
+		mono_jit_stats.pic_megamorphic_sites++;
+	}
+	mono_domain_unlock (domain);
+}
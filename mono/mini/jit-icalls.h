@@ -173,5 +173,8 @@ mono_object_isinst_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cach
 MonoObject*
 mono_object_castclass_with_cache (MonoObject *obj, MonoClass *klass, gpointer *cache);
 
+void
+mono_pic_miss (MonoObject *obj, MonoPicCache *cache) MONO_INTERNAL;
+
 #endif /* __MONO_JIT_ICALLS_H__ */
 
@@ -0,0 +1,387 @@
+/*
+ * licm.c: Loop invariant code motion
+ *
+ *   Instructions inside a loop whose operands are not modified by the loop are moved
+ * to the preheader of the loop, i.e. the only block outside the loop branching to
+ * its header. Instructions which can throw or read memory are only moved when the
+ * moved code behaves the same way:
+ * - instructions which can throw are moved only from the start of the loop header,
+ *   so they are executed first when entering the loop both before and after the move.
+ * - loads are moved only if the loop doesn't modify memory, or they read constant
+ *   memory, like array lengths.
+ *
+ * Copyright 2011 Xamarin, Inc (http://www.xamarin.com)
+ */
+
+#include "mini.h"
+
+#ifndef DISABLE_JIT
+
+/*
+ * is_pure_op:
+ *
+ *   Return whenever OPCODE computes its result from its sregs only, without
+ * throwing or accessing memory.
+ */
+static gboolean
+is_pure_op (int opcode)
+{
+	switch (opcode) {
+	case OP_MOVE:
+	case OP_ICONST:
+	case OP_I8CONST:
+	case OP_IADD:
+	case OP_ISUB:
+	case OP_IMUL:
+	case OP_IAND:
+	case OP_IOR:
+	case OP_IXOR:
+	case OP_ISHL:
+	case OP_ISHR:
+	case OP_ISHR_UN:
+	case OP_INEG:
+	case OP_INOT:
+	case OP_IADD_IMM:
+	case OP_ISUB_IMM:
+	case OP_IMUL_IMM:
+	case OP_IAND_IMM:
+	case OP_IOR_IMM:
+	case OP_IXOR_IMM:
+	case OP_ISHL_IMM:
+	case OP_ISHR_IMM:
+	case OP_ISHR_UN_IMM:
+	case OP_ICONV_TO_I1:
+	case OP_ICONV_TO_U1:
+	case OP_ICONV_TO_I2:
+	case OP_ICONV_TO_U2:
+#if SIZEOF_REGISTER == 8
+	case OP_LADD:
+	case OP_LSUB:
+	case OP_LMUL:
+	case OP_LAND:
+	case OP_LOR:
+	case OP_LXOR:
+	case OP_LSHL:
+	case OP_LSHR:
+	case OP_LSHR_UN:
+	case OP_LNEG:
+	case OP_LNOT:
+	case OP_LADD_IMM:
+	case OP_LSUB_IMM:
+	case OP_LMUL_IMM:
+	case OP_LAND_IMM:
+	case OP_LOR_IMM:
+	case OP_LXOR_IMM:
+	case OP_LSHL_IMM:
+	case OP_LSHR_IMM:
+	case OP_LSHR_UN_IMM:
+	case OP_SEXT_I4:
+	case OP_ZEXT_I4:
+	case OP_LCONV_TO_I4:
+#endif
+		return TRUE;
+	case OP_FMOVE:
+	case OP_R8CONST:
+	case OP_FADD:
+	case OP_FSUB:
+	case OP_FMUL:
+	case OP_FDIV:
+	case OP_FNEG:
+	case OP_ICONV_TO_R8:
+		/* Moving fp values between bblocks is costly with an fp stack */
+		return !MONO_ARCH_USE_FPSTACK;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * is_load_op:
+ *
+ *   Return whenever INS reads memory without writing it. Set *CONSTANT if the
+ * memory read doesn't change.
+ */
+static gboolean
+is_load_op (MonoInst *ins, gboolean *constant)
+{
+	*constant = FALSE;
+	switch (ins->opcode) {
+	case OP_LDLEN:
+	case OP_STRLEN:
+		*constant = TRUE;
+		return TRUE;
+	case OP_LOADV_MEMBASE:
+	case OP_LOADX_MEMBASE:
+		return FALSE;
+	default:
+		if (!MONO_IS_LOAD_MEMBASE (ins) || (ins->flags & MONO_INST_VOLATILE))
+			return FALSE;
+		*constant = (ins->flags & MONO_INST_CONSTANT_LOAD) ? TRUE : FALSE;
+		return TRUE;
+	}
+}
+
+/*
+ * writes_memory:
+ *
+ *   Return whenever INS might modify memory read by the loads of a loop.
+ */
+static gboolean
+writes_memory (MonoInst *ins)
+{
+	gboolean constant;
+
+	if (is_pure_op (ins->opcode) || is_load_op (ins, &constant) || MONO_IS_BRANCH_OP (ins) || MONO_IS_COND_EXC (ins))
+		return FALSE;
+
+	switch (ins->opcode) {
+	case OP_NOP:
+	case OP_COMPARE:
+	case OP_COMPARE_IMM:
+	case OP_ICOMPARE:
+	case OP_ICOMPARE_IMM:
+	case OP_LCOMPARE:
+	case OP_LCOMPARE_IMM:
+	case OP_FCOMPARE:
+	case OP_CHECK_THIS:
+	case OP_NOT_NULL:
+	case OP_BOUNDS_CHECK:
+	case OP_DUMMY_USE:
+	case OP_DUMMY_STORE:
+	/* These only write the newly allocated memory */
+	case OP_NEWARR:
+	case OP_NEWOBJ:
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
+/*
+ * find_preheader:
+ *
+ *   Return the only predecessor of the loop header H outside the loop, if it
+ * doesn't branch anywhere else.
+ */
+static MonoBasicBlock*
+find_preheader (MonoBasicBlock *h, gboolean *in_loop)
+{
+	MonoBasicBlock *preheader = NULL;
+	int i;
+
+	for (i = 0; i < h->in_count; ++i) {
+		MonoBasicBlock *pred = h->in_bb [i];
+
+		if (in_loop [pred->block_num])
+			continue;
+		if (preheader)
+			return NULL;
+		preheader = pred;
+	}
+
+	if (!preheader || preheader->out_count != 1 || preheader->region != h->region)
+		return NULL;
+	if (preheader->last_ins && MONO_IS_BRANCH_OP (preheader->last_ins) && preheader->last_ins->opcode != OP_BR)
+		return NULL;
+	return preheader;
+}
+
+/*
+ * hoist_loop_invariants:
+ *
+ *   Move the invariant instructions of the loop with header H to its preheader.
+ * DEF_COUNT holds the number of definitions of each vreg in the method, LOOP_DEFS
+ * is a scratch array of the same size set to zero, INVARIANT a scratch array set to
+ * FALSE. Return the number of moved instructions.
+ */
+static int
+hoist_loop_invariants (MonoCompile *cfg, MonoBasicBlock *h, int *def_count, int *loop_defs, gboolean *invariant, gboolean *in_loop, int this_reg)
+{
+	MonoBasicBlock *preheader, *bb;
+	MonoInst *ins, *next;
+	GList *l;
+	GSList *hoisted = NULL, *sl;
+	gboolean read_only = TRUE, changed;
+	int i, j, nhoisted = 0;
+
+	for (l = h->loop_blocks; l; l = l->next)
+		in_loop [((MonoBasicBlock*)l->data)->block_num] = TRUE;
+
+	preheader = find_preheader (h, in_loop);
+	if (!preheader)
+		goto done;
+
+	for (l = h->loop_blocks; l; l = l->next) {
+		bb = l->data;
+		for (ins = bb->code; ins; ins = ins->next) {
+			if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg >= 0)
+				loop_defs [ins->dreg] ++;
+			if (writes_memory (ins))
+				read_only = FALSE;
+		}
+	}
+
+	/*
+	 * Process the blocks in depth first order, which visits the definitions of the
+	 * operands before their uses, so the operands are hoisted first.
+	 */
+	do {
+		changed = FALSE;
+		for (i = 0; i < cfg->num_bblocks; ++i) {
+			/* Whenever an instruction which can throw or has side effects was seen in the header */
+			gboolean side_effects = FALSE;
+
+			bb = cfg->bblocks [i];
+			if (!in_loop [bb->block_num])
+				continue;
+
+			for (ins = bb->code; ins; ins = next) {
+				MonoInst *var;
+				gboolean is_pure, is_load, constant, can_throw, operands_invariant = TRUE;
+				int num_sregs, sregs [MONO_MAX_SRC_REGS];
+
+				next = ins->next;
+
+				is_pure = is_pure_op (ins->opcode);
+				is_load = !is_pure && is_load_op (ins, &constant);
+				if (!is_pure && !is_load) {
+					if (ins->opcode != OP_NOP && ins->opcode != OP_NOT_NULL && ins->opcode != OP_DUMMY_USE && ins->opcode != OP_DUMMY_STORE)
+						side_effects = TRUE;
+					continue;
+				}
+
+				num_sregs = mono_inst_get_src_registers (ins, sregs);
+				for (j = 0; j < num_sregs; ++j) {
+					int sreg = sregs [j];
+
+					var = get_vreg_to_inst (cfg, sreg);
+					if (sreg < MONO_MAX_IREGS || (loop_defs [sreg] && !invariant [sreg]) ||
+						(var && (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT))))
+						operands_invariant = FALSE;
+				}
+
+				var = get_vreg_to_inst (cfg, ins->dreg);
+				if (!operands_invariant || ins->dreg < MONO_MAX_IREGS || def_count [ins->dreg] != 1 ||
+					(cfg->ret && ins->dreg == cfg->ret->dreg) || (var && (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))) {
+					if (!is_pure)
+						side_effects = TRUE;
+					continue;
+				}
+
+				if (is_load) {
+					/* Loads from this can't fault, since this can't be null */
+					can_throw = ins->opcode == OP_LDLEN || ins->opcode == OP_STRLEN || ins->sreg1 != this_reg;
+					if ((!read_only && !constant) || (can_throw && (bb != h || side_effects))) {
+						side_effects = TRUE;
+						continue;
+					}
+				}
+
+				MONO_REMOVE_INS (bb, ins);
+				ins->prev = ins->next = NULL;
+				hoisted = g_slist_prepend_mempool (cfg->mempool, hoisted, ins);
+				invariant [ins->dreg] = TRUE;
+				changed = TRUE;
+				nhoisted ++;
+			}
+		}
+	} while (changed);
+
+	hoisted = g_slist_reverse (hoisted);
+	for (sl = hoisted; sl; sl = sl->next) {
+		ins = sl->data;
+		if (cfg->verbose_level > 2) {
+			printf ("LICM: moving from loop BB%d to BB%d: ", h->block_num, preheader->block_num);
+			mono_print_ins (ins);
+		}
+		mono_add_ins_to_end (preheader, ins);
+		/* These are only lowered in blocks marked as having array accesses */
+		if (ins->opcode == OP_LDLEN || ins->opcode == OP_STRLEN)
+			preheader->has_array_access = TRUE;
+	}
+
+ done:
+	for (l = h->loop_blocks; l; l = l->next) {
+		bb = l->data;
+		in_loop [bb->block_num] = FALSE;
+		for (ins = bb->code; ins; ins = ins->next) {
+			if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && ins->dreg >= 0)
+				loop_defs [ins->dreg] = 0;
+		}
+	}
+	for (sl = hoisted; sl; sl = sl->next) {
+		ins = sl->data;
+		invariant [ins->dreg] = FALSE;
+		loop_defs [ins->dreg] = 0;
+	}
+
+	return nhoisted;
+}
+
+/*
+ * mono_loop_invariant_code_motion:
+ *
+ *   Move the invariant instructions out of the loops of the method. Needs the
+ * loop information computed by mono_compute_natural_loops ().
+ */
+void
+mono_loop_invariant_code_motion (MonoCompile *cfg)
+{
+	MonoBasicBlock *bb;
+	MonoInst *ins;
+	int *def_count, *loop_defs;
+	gboolean *invariant, *in_loop;
+	int i, nesting, max_nesting = 0, nhoisted = 0, this_reg = -1;
+
+	g_assert (cfg->comp_done & MONO_COMP_LOOPS);
+
+	/* The debugger can change the value of variables at sequence points */
+	if (cfg->gen_seq_points)
+		return;
+
+	for (i = 0; i < cfg->num_bblocks; ++i) {
+		bb = cfg->bblocks [i];
+		if (bb->loop_blocks)
+			max_nesting = MAX (max_nesting, bb->nesting);
+	}
+	if (!max_nesting)
+		return;
+
+	def_count = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * cfg->next_vreg);
+	loop_defs = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * cfg->next_vreg);
+	invariant = mono_mempool_alloc0 (cfg->mempool, sizeof (gboolean) * cfg->next_vreg);
+	in_loop = mono_mempool_alloc0 (cfg->mempool, sizeof (gboolean) * cfg->max_block_num);
+
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		for (ins = bb->code; ins; ins = ins->next) {
+			if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg >= 0)
+				def_count [ins->dreg] ++;
+		}
+	}
+
+	if (mono_method_signature (cfg->method)->hasthis && !cfg->method->klass->valuetype && !cfg->generic_sharing_context) {
+		MonoInst *this_var = cfg->args [0];
+
+		if (!def_count [this_var->dreg] && !(this_var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+			this_reg = this_var->dreg;
+	}
+
+	/* Process inner loops first, so their invariants can be moved out of the outer loops too */
+	for (nesting = max_nesting; nesting > 0; --nesting) {
+		for (i = 0; i < cfg->num_bblocks; ++i) {
+			bb = cfg->bblocks [i];
+			if (bb->loop_blocks && bb->nesting == nesting)
+				nhoisted += hoist_loop_invariants (cfg, bb, def_count, loop_defs, invariant, in_loop, this_reg);
+		}
+	}
+
+	if (nhoisted) {
+		/* Hoisted local vregs are now used in more than one bblock */
+		mono_handle_global_vregs (cfg);
+
+		if (cfg->verbose_level > 1)
+			printf ("LICM: moved %d instructions out of loops\n", nhoisted);
+	}
+}
+
+#endif /* DISABLE_JIT */
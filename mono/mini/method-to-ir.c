@@ -64,6 +64,7 @@
 #include "jit-icalls.h"
 #include "jit.h"
 #include "debugger-agent.h"
+#include "mini-tiered.h"
 
 #define BRANCH_COST 10
 #define INLINE_LENGTH_LIMIT 20
@@ -2517,6 +2518,223 @@ mono_emit_method_call (MonoCompile *cfg, MonoMethod *method, MonoInst **args, Mo
 	return mono_emit_method_call_full (cfg, method, mono_method_signature (method), args, this, NULL, NULL);
 }
 
+/*
+ * emit_stat_increment:
+ *
+ *   Emit a non-atomic increment of the statistics counter COUNTER.
+ */
+static void
+emit_stat_increment (MonoCompile *cfg, gint32 *counter)
+{
+	int addr_reg = alloc_preg (cfg);
+	int val_reg = alloc_ireg (cfg);
+
+	MONO_EMIT_NEW_PCONST (cfg, addr_reg, counter);
+	MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, val_reg, addr_reg, 0);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_IADD_IMM, val_reg, val_reg, 1);
+	MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STOREI4_MEMBASE_REG, addr_reg, 0, val_reg);
+}
+
+#ifdef MONO_ARCH_HAVE_CREATE_DELEGATE_TRAMPOLINE
+/*
+ * emit_delegate_invoke:
+ *
+ *   Emit a call to the Invoke method CMETHOD of a delegate. If the delegate uses one
+ * of the invoke impls returned by mono_arch_get_delegate_invoke_impl (), the call is
+ * made directly to delegate->method_ptr, with the target as the this argument for
+ * closed delegates, instead of going through the impl. Otherwise, i.e. before the
+ * delegate trampoline has run, and for multicast and open instance delegates, the
+ * call goes through delegate->invoke_impl.
+ * Return NULL if the call can't be done this way.
+ */
+static MonoInst*
+emit_delegate_invoke (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig, MonoInst **sp)
+{
+	MonoBasicBlock *open_bb = NULL, *slow_bb, *end_bb;
+	MonoMethodSignature *open_sig;
+	MonoInst *call, *addr, *target, *dummy_use, *res = NULL, **closed_args;
+	gpointer impl_this, impl_nothis;
+	int i, del_reg, impl_reg, tmp_reg, res_reg = -1;
+
+	if (!(cfg->opt & MONO_OPT_DELEGATE) || cfg->compile_aot || COMPILE_LLVM (cfg) || cfg->generic_sharing_context || (cfg->opt & MONO_OPT_SHARED))
+		return NULL;
+	if (cmethod->klass->parent != mono_defaults.multicastdelegate_class || strcmp (cmethod->name, "Invoke"))
+		return NULL;
+	if (fsig->generic_param_count || fsig->pinvoke || fsig->call_convention == MONO_CALL_VARARG)
+		return NULL;
+	/* The arguments and the result are used by more than one call */
+	if (!MONO_TYPE_IS_VOID (fsig->ret) && MONO_TYPE_ISSTRUCT (fsig->ret))
+		return NULL;
+	for (i = 0; i < fsig->param_count; ++i) {
+		if (MONO_TYPE_ISSTRUCT (fsig->params [i]))
+			return NULL;
+	}
+
+	impl_this = mono_arch_get_delegate_invoke_impl (fsig, TRUE);
+	if (!impl_this)
+		return NULL;
+	impl_nothis = mono_arch_get_delegate_invoke_impl (fsig, FALSE);
+
+	NEW_BBLOCK (cfg, slow_bb);
+	NEW_BBLOCK (cfg, end_bb);
+	if (impl_nothis)
+		NEW_BBLOCK (cfg, open_bb);
+
+	del_reg = sp [0]->dreg;
+
+	/* This also serves as the null check */
+	impl_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE_FAULT (cfg, impl_reg, del_reg, G_STRUCT_OFFSET (MonoDelegate, invoke_impl));
+	tmp_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, tmp_reg, impl_this);
+	MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, impl_reg, tmp_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, impl_nothis ? open_bb : slow_bb);
+
+	/* Closed delegates, including static methods with a bound first argument */
+	closed_args = mono_mempool_alloc (cfg->mempool, sizeof (MonoInst*) * (fsig->param_count + 1));
+	memcpy (closed_args, sp, sizeof (MonoInst*) * (fsig->param_count + 1));
+	EMIT_NEW_LOAD_MEMBASE (cfg, target, OP_LOAD_MEMBASE, alloc_preg (cfg), del_reg, G_STRUCT_OFFSET (MonoDelegate, target));
+	target->type = STACK_OBJ;
+	closed_args [0] = target;
+	EMIT_NEW_LOAD_MEMBASE (cfg, addr, OP_LOAD_MEMBASE, alloc_preg (cfg), del_reg, G_STRUCT_OFFSET (MonoDelegate, method_ptr));
+	call = mono_emit_calli (cfg, fsig, closed_args, addr, NULL);
+	if (!MONO_TYPE_IS_VOID (fsig->ret)) {
+		res_reg = alloc_dreg (cfg, call->type);
+		EMIT_NEW_UNALU (cfg, res, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+		res->type = call->type;
+		res->klass = call->klass;
+	}
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+	/* Open static delegates */
+	if (impl_nothis) {
+		MONO_START_BB (cfg, open_bb);
+		tmp_reg = alloc_preg (cfg);
+		MONO_EMIT_NEW_PCONST (cfg, tmp_reg, impl_nothis);
+		MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, impl_reg, tmp_reg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, slow_bb);
+
+		open_sig = mono_metadata_signature_dup_mempool (cfg->mempool, fsig);
+		open_sig->hasthis = FALSE;
+		EMIT_NEW_LOAD_MEMBASE (cfg, addr, OP_LOAD_MEMBASE, alloc_preg (cfg), del_reg, G_STRUCT_OFFSET (MonoDelegate, method_ptr));
+		call = mono_emit_calli (cfg, open_sig, sp + 1, addr, NULL);
+		if (res)
+			MONO_EMIT_NEW_UNALU (cfg, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+	}
+
+	MONO_START_BB (cfg, slow_bb);
+	call = mono_emit_method_call_full (cfg, cmethod, fsig, sp, sp [0], NULL, NULL);
+	if (res)
+		MONO_EMIT_NEW_UNALU (cfg, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+
+	MONO_START_BB (cfg, end_bb);
+
+	/*
+	 * The direct calls don't pass the delegate, so keep it alive, see the comment in
+	 * mono_emit_method_call_full ().
+	 */
+	EMIT_NEW_DUMMY_USE (cfg, dummy_use, sp [0]);
+
+	InterlockedIncrement (&mono_jit_stats.direct_delegate_invoke_sites);
+
+	return res ? res : call;
+}
+#endif
+
+#ifdef MONO_ARCH_HAVE_INLINE_CACHES
+
+/*
+ * emit_pic_call:
+ *
+ *   Emit a call to the interface method CMETHOD through a MonoPicCache. The vtable of
+ * the receiver is compared with the vtables in the cache, and on a hit, the cached
+ * code is called directly. Otherwise mono_pic_miss () is called to fill the cache,
+ * unless it is megamorphic, and the normal IMT call is made.
+ * Return NULL if the call can't use a cache.
+ */
+static MonoInst*
+emit_pic_call (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig, MonoInst **sp)
+{
+	MonoPicCache *cache;
+	MonoBasicBlock *hit_bbs [MONO_PIC_SIZE], *slow_bb, *end_bb;
+	MonoInst *call, *addr, *args [2], *res = NULL;
+	int i, vtable_reg, cache_reg, tmp_reg, res_reg = -1;
+
+	if (!(cfg->opt & MONO_OPT_PIC) || cfg->compile_aot || COMPILE_LLVM (cfg) || cfg->generic_sharing_context || (cfg->opt & MONO_OPT_SHARED))
+		return NULL;
+	if (!(cmethod->klass->flags & TYPE_ATTRIBUTE_INTERFACE) || !(cmethod->flags & METHOD_ATTRIBUTE_VIRTUAL))
+		return NULL;
+	if (fsig->generic_param_count || fsig->pinvoke || fsig->call_convention == MONO_CALL_VARARG)
+		return NULL;
+	/* The arguments and the result are used by more than one call */
+	if (!MONO_TYPE_IS_VOID (fsig->ret) && MONO_TYPE_ISSTRUCT (fsig->ret))
+		return NULL;
+	for (i = 0; i < fsig->param_count; ++i) {
+		if (MONO_TYPE_ISSTRUCT (fsig->params [i]))
+			return NULL;
+	}
+
+	cache = mono_domain_alloc0 (cfg->domain, sizeof (MonoPicCache));
+	cache->method = cmethod;
+	InterlockedIncrement (&mono_jit_stats.pic_call_sites);
+
+	/* This also serves as the null check */
+	vtable_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE_FAULT (cfg, vtable_reg, sp [0]->dreg, G_STRUCT_OFFSET (MonoObject, vtable));
+	cache_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, cache_reg, cache);
+
+	for (i = 0; i < MONO_PIC_SIZE; ++i) {
+		NEW_BBLOCK (cfg, hit_bbs [i]);
+		tmp_reg = alloc_preg (cfg);
+		MONO_EMIT_NEW_LOAD_MEMBASE (cfg, tmp_reg, cache_reg, G_STRUCT_OFFSET (MonoPicCache, vtables) + (i * sizeof (gpointer)));
+		MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, tmp_reg, vtable_reg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, hit_bbs [i]);
+	}
+	NEW_BBLOCK (cfg, slow_bb);
+	NEW_BBLOCK (cfg, end_bb);
+
+	/* Miss */
+	tmp_reg = alloc_ireg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, tmp_reg, cache_reg, G_STRUCT_OFFSET (MonoPicCache, megamorphic));
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, tmp_reg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBNE_UN, slow_bb);
+	args [0] = sp [0];
+	EMIT_NEW_PCONST (cfg, args [1], cache);
+	mono_emit_jit_icall (cfg, mono_pic_miss, args);
+
+	/* Misses and megamorphic call sites */
+	MONO_START_BB (cfg, slow_bb);
+	if (mono_jit_stats.enabled)
+		emit_stat_increment (cfg, &mono_jit_stats.pic_slow_calls);
+	call = mono_emit_method_call_full (cfg, cmethod, fsig, sp, sp [0], NULL, NULL);
+	if (!MONO_TYPE_IS_VOID (fsig->ret)) {
+		res_reg = alloc_dreg (cfg, call->type);
+		EMIT_NEW_UNALU (cfg, res, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+		res->type = call->type;
+		res->klass = call->klass;
+	}
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+	for (i = 0; i < MONO_PIC_SIZE; ++i) {
+		MONO_START_BB (cfg, hit_bbs [i]);
+		if (mono_jit_stats.enabled)
+			emit_stat_increment (cfg, &mono_jit_stats.pic_hits);
+		EMIT_NEW_LOAD_MEMBASE (cfg, addr, OP_LOAD_MEMBASE, alloc_preg (cfg), cache_reg, G_STRUCT_OFFSET (MonoPicCache, targets) + (i * sizeof (gpointer)));
+		call = mono_emit_calli (cfg, fsig, sp, addr, NULL);
+		if (res)
+			MONO_EMIT_NEW_UNALU (cfg, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+	}
+
+	MONO_START_BB (cfg, end_bb);
+
+	return res ? res : call;
+}
+
+#endif
+
 MonoInst*
 mono_emit_native_call (MonoCompile *cfg, gconstpointer func, MonoMethodSignature *sig,
 					   MonoInst **args)
@@ -2649,7 +2867,7 @@ emit_write_barrier (MonoCompile *cfg, MonoInst *ptr, MonoInst *value, int value_
 {
 	int card_table_shift_bits;
 	gpointer card_table_mask;
-	guint8 *card_table;
+	guint8 *card_table, *nursery_start;
 	MonoInst *dummy_use;
 	int nursery_shift_bits;
 	size_t nursery_size;
@@ -2660,7 +2878,20 @@ emit_write_barrier (MonoCompile *cfg, MonoInst *ptr, MonoInst *value, int value_
 
 	card_table = mono_gc_get_card_table (&card_table_shift_bits, &card_table_mask);
 
-	mono_gc_get_nursery (&nursery_shift_bits, &nursery_size);
+	nursery_start = mono_gc_get_nursery (&nursery_shift_bits, &nursery_size);
+
+	/*
+	 * Storing null or an object outside the nursery, like an interned string embedded
+	 * into the code, doesn't need a barrier. Objects never move into the nursery.
+	 */
+	if (value && value->opcode == OP_PCONST) {
+		guint8 *obj = value->inst_p0;
+
+		if (!obj || (!cfg->compile_aot && nursery_start && (obj < nursery_start || obj >= nursery_start + nursery_size))) {
+			cfg->stat_wbarriers_removed ++;
+			return;
+		}
+	}
 
 #ifdef MONO_ARCH_HAVE_CARD_TABLE_WBARRIER
 	has_card_table_wb = TRUE;
@@ -2669,12 +2900,22 @@ emit_write_barrier (MonoCompile *cfg, MonoInst *ptr, MonoInst *value, int value_
 	if (has_card_table_wb && !cfg->compile_aot && card_table && nursery_shift_bits > 0) {
 		MonoInst *wbarrier;
 
+#ifdef MONO_ARCH_HAVE_CARD_TABLE_WBARRIER_BASE
+		MonoInst *card_base;
+
+		/* Passed in a register so it can be hoisted out of loops */
+		EMIT_NEW_PCONST (cfg, card_base, card_table);
+#endif
+
 		MONO_INST_NEW (cfg, wbarrier, OP_CARD_TABLE_WBARRIER);
 		wbarrier->sreg1 = ptr->dreg;
 		if (value)
 			wbarrier->sreg2 = value->dreg;
 		else
 			wbarrier->sreg2 = value_reg;
+#ifdef MONO_ARCH_HAVE_CARD_TABLE_WBARRIER_BASE
+		wbarrier->sreg3 = card_base->dreg;
+#endif
 		MONO_ADD_INS (cfg->cbb, wbarrier);
 	} else if (card_table) {
 		int offset_reg = alloc_preg (cfg);
@@ -3025,12 +3266,18 @@ emit_get_rgctx_field (MonoCompile *cfg, int context_used,
 
 /*
  * On return the caller must check @klass for load errors.
+ * If @check_initialized is TRUE, vtable->initialized is checked inline, so once the
+ * cctor has run, the init is only a load and a branch instead of a call to the
+ * trampoline. This starts new bblocks.
  */
 static void
-emit_generic_class_init (MonoCompile *cfg, MonoClass *klass)
+emit_generic_class_init (MonoCompile *cfg, MonoClass *klass, gboolean check_initialized)
 {
+	static int byte_offset = -1;
+	static guint8 bitmask;
 	MonoInst *vtable_arg;
 	MonoCallInst *call;
+	MonoBasicBlock *end_bb = NULL;
 	int context_used = 0;
 
 	if (cfg->generic_sharing_context)
@@ -3047,6 +3294,19 @@ emit_generic_class_init (MonoCompile *cfg, MonoClass *klass)
 		EMIT_NEW_VTABLECONST (cfg, vtable_arg, vtable);
 	}
 
+	if (check_initialized && !COMPILE_LLVM (cfg)) {
+		int initialized_reg = alloc_ireg (cfg);
+
+		if (byte_offset < 0)
+			mono_marshal_find_bitfield_offset (MonoVTable, initialized, &byte_offset, &bitmask);
+
+		NEW_BBLOCK (cfg, end_bb);
+		MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADU1_MEMBASE, initialized_reg, vtable_arg->dreg, byte_offset);
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_IAND_IMM, initialized_reg, initialized_reg, bitmask);
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, initialized_reg, 0);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBNE_UN, end_bb);
+	}
+
 	if (COMPILE_LLVM (cfg))
 		call = (MonoCallInst*)mono_emit_abs_call (cfg, MONO_PATCH_INFO_GENERIC_CLASS_INIT, NULL, helper_sig_generic_class_init_trampoline_llvm, &vtable_arg);
 	else
@@ -3057,6 +3317,9 @@ emit_generic_class_init (MonoCompile *cfg, MonoClass *klass)
 #else
 	NOT_IMPLEMENTED;
 #endif
+
+	if (end_bb)
+		MONO_START_BB (cfg, end_bb);
 }
 
 static void
@@ -3277,8 +3540,6 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 		return mono_emit_jit_icall (cfg, mono_helper_newobj_mscorlib, iargs);
 	} else {
 		MonoVTable *vtable = mono_class_vtable (cfg->domain, klass);
-		MonoMethod *managed_alloc = NULL;
-		gboolean pass_lw;
 
 		if (!vtable) {
 			mono_cfg_set_exception (cfg, MONO_EXCEPTION_TYPE_LOAD);
@@ -3286,24 +3547,60 @@ handle_alloc (MonoCompile *cfg, MonoClass *klass, gboolean for_box, int context_
 			return NULL;
 		}
 
+		if ((cfg->opt & MONO_OPT_ESCAPE) && !cfg->compile_aot && !COMPILE_LLVM (cfg) &&
+			!klass->has_finalize && !klass->marshalbyref && !klass->contextbound && !klass->rank && klass != mono_defaults.string_class) {
+			MonoInst *ins;
+
+			/* Decompose later, so mono_ssa_escape_analysis () can remove the allocation */
+			MONO_INST_NEW (cfg, ins, OP_NEWOBJ);
+			ins->dreg = alloc_ireg_ref (cfg);
+			ins->inst_newobj_vtable = vtable;
+			ins->inst_newobj_for_box = for_box;
+			ins->type = STACK_OBJ;
+			ins->klass = klass;
+			MONO_ADD_INS (cfg->cbb, ins);
+			cfg->flags |= MONO_CFG_HAS_ARRAY_ACCESS;
+			cfg->cbb->has_array_access = TRUE;
+			return ins;
+		}
+
+		return mini_emit_alloc_obj (cfg, vtable, for_box);
+	}
+
+	return mono_emit_jit_icall (cfg, alloc_ftn, iargs);
+}
+
+/*
+ * mini_emit_alloc_obj:
+ *
+ *   Emit a call to allocate an object of the class of VTABLE, using the managed
+ * allocator if possible.
+ */
+MonoInst*
+mini_emit_alloc_obj (MonoCompile *cfg, MonoVTable *vtable, gboolean for_box)
+{
+	MonoInst *iargs [2];
+	MonoMethod *managed_alloc = NULL;
+	void *alloc_ftn;
+	gboolean pass_lw;
+
 #ifndef MONO_CROSS_COMPILE
-		managed_alloc = mono_gc_get_managed_allocator (vtable, for_box);
+	managed_alloc = mono_gc_get_managed_allocator (vtable, for_box);
 #endif
 
-		if (managed_alloc) {
-			EMIT_NEW_VTABLECONST (cfg, iargs [0], vtable);
-			return mono_emit_method_call (cfg, managed_alloc, iargs, NULL);
-		}
-		alloc_ftn = mono_class_get_allocation_ftn (vtable, for_box, &pass_lw);
-		if (pass_lw) {
-			guint32 lw = vtable->klass->instance_size;
-			lw = ((lw + (sizeof (gpointer) - 1)) & ~(sizeof (gpointer) - 1)) / sizeof (gpointer);
-			EMIT_NEW_ICONST (cfg, iargs [0], lw);
-			EMIT_NEW_VTABLECONST (cfg, iargs [1], vtable);
-		}
-		else {
-			EMIT_NEW_VTABLECONST (cfg, iargs [0], vtable);
-		}
+	if (managed_alloc) {
+		EMIT_NEW_VTABLECONST (cfg, iargs [0], vtable);
+		return mono_emit_method_call (cfg, managed_alloc, iargs, NULL);
+	}
+	alloc_ftn = mono_class_get_allocation_ftn (vtable, for_box, &pass_lw);
+	if (pass_lw) {
+		guint32 lw = vtable->klass->instance_size;
+		lw = ((lw + (sizeof (gpointer) - 1)) & ~(sizeof (gpointer) - 1)) / sizeof (gpointer);
+		EMIT_NEW_ICONST (cfg, iargs [0], lw);
+		EMIT_NEW_VTABLECONST (cfg, iargs [1], vtable);
+	}
+	else {
+		EMIT_NEW_VTABLECONST (cfg, iargs [0], vtable);
 	}
 
 	return mono_emit_jit_icall (cfg, alloc_ftn, iargs);
@@ -3371,6 +3668,107 @@ mini_class_has_reference_variant_generic_argument (MonoCompile *cfg, MonoClass *
 	return FALSE;
 }
 
+/*
+ * emit_cast_with_cache:
+ *
+ *   Emit an isinst (if IS_ISINST is TRUE) or a castclass of SRC to KLASS which checks a
+ * per call site cache holding the vtable of the last object cast, with its low bit set
+ * if the object wasn't an instance of KLASS. On a miss, the interface bitmap of the vtable
+ * is checked inline for non variant interfaces, and a match is stored into the cache.
+ * Otherwise, mono_object_isinst_with_cache () or mono_object_castclass_with_cache () does
+ * the cast and updates the cache, since they can deal with variance, proxies and COM
+ * objects.
+ */
+static MonoInst*
+emit_cast_with_cache (MonoCompile *cfg, MonoClass *klass, MonoInst *src, gboolean is_isinst)
+{
+	MonoBasicBlock *hit_bb, *miss_bb, *end_bb;
+	MonoInst *ins, *call, *args [3];
+	gpointer *cache;
+	int obj_reg = src->dreg;
+	int res_reg = alloc_ireg_ref (cfg);
+	int vtable_reg, cache_reg, cached_reg, neg_reg;
+
+	cache = mono_domain_alloc0 (cfg->domain, sizeof (gpointer));
+	InterlockedIncrement (&mono_jit_stats.cast_cache_sites);
+
+	NEW_BBLOCK (cfg, hit_bb);
+	NEW_BBLOCK (cfg, miss_bb);
+	NEW_BBLOCK (cfg, end_bb);
+
+	/* Do the assignment at the beginning, so the other assignments can be if converted */
+	EMIT_NEW_UNALU (cfg, ins, OP_MOVE, res_reg, obj_reg);
+	ins->type = STACK_OBJ;
+	ins->klass = klass;
+
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, obj_reg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, end_bb);
+
+	vtable_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE (cfg, vtable_reg, obj_reg, G_STRUCT_OFFSET (MonoObject, vtable));
+	cache_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, cache_reg, cache);
+	cached_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE (cfg, cached_reg, cache_reg, 0);
+	MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, cached_reg, vtable_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, hit_bb);
+
+	if (is_isinst) {
+		/* Negative hit, vtables are aligned so this sets the low bit */
+		neg_reg = alloc_preg (cfg);
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_PADD_IMM, neg_reg, vtable_reg, 1);
+		MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, cached_reg, neg_reg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, miss_bb);
+		if (mono_jit_stats.enabled)
+			emit_stat_increment (cfg, &mono_jit_stats.cast_cache_hits);
+		MONO_EMIT_NEW_PCONST (cfg, res_reg, 0);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+	}
+
+	MONO_START_BB (cfg, miss_bb);
+	if (mono_jit_stats.enabled)
+		emit_stat_increment (cfg, &mono_jit_stats.cast_cache_misses);
+	if ((klass->flags & TYPE_ATTRIBUTE_INTERFACE) && !mini_class_has_reference_variant_generic_argument (cfg, klass, 0)) {
+		MonoBasicBlock *is_bb, *slow_bb;
+
+		NEW_BBLOCK (cfg, is_bb);
+		NEW_BBLOCK (cfg, slow_bb);
+
+		mini_emit_iface_cast (cfg, vtable_reg, klass, slow_bb, is_bb);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, slow_bb);
+
+		MONO_START_BB (cfg, is_bb);
+		MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STORE_MEMBASE_REG, cache_reg, 0, vtable_reg);
+		MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+		MONO_START_BB (cfg, slow_bb);
+	}
+	args [0] = src;
+	EMIT_NEW_CLASSCONST (cfg, args [1], klass);
+	EMIT_NEW_PCONST (cfg, args [2], cache);
+	if (is_isinst)
+		call = mono_emit_jit_icall (cfg, mono_object_isinst_with_cache, args);
+	else
+		call = mono_emit_jit_icall (cfg, mono_object_castclass_with_cache, args);
+	MONO_EMIT_NEW_UNALU (cfg, OP_MOVE, res_reg, call->dreg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+	MONO_START_BB (cfg, hit_bb);
+	if (mono_jit_stats.enabled)
+		emit_stat_increment (cfg, &mono_jit_stats.cast_cache_hits);
+
+	MONO_START_BB (cfg, end_bb);
+
+	return ins;
+}
+
+/*
+ * Whether the isinst/castclass of an object to KLASS at a call site can use
+ * emit_cast_with_cache (). Casts to interfaces and to generic classes with variant
+ * arguments are slow without it.
+ */
+#define use_cast_cache(cfg,klass,context_used) (!(context_used) && !(cfg)->compile_aot && ((((klass)->flags & TYPE_ATTRIBUTE_INTERFACE) && !(klass)->marshalbyref) || mini_class_has_reference_variant_generic_argument ((cfg), (klass), (context_used))))
+
 // FIXME: This doesn't work yet (class libs tests fail?)
 #define is_complex_isinst(klass) (TRUE || (klass->flags & TYPE_ATTRIBUTE_INTERFACE) || klass->rank || mono_class_is_nullable (klass) || klass->marshalbyref || (klass->flags & TYPE_ATTRIBUTE_SEALED) || klass->byval_arg.type == MONO_TYPE_VAR || klass->byval_arg.type == MONO_TYPE_MVAR)
 
@@ -4037,7 +4435,8 @@ mini_field_access_needs_cctor_run (MonoCompile *cfg, MonoMethod *method, MonoVTa
 		return FALSE;
 
 	if (vtable->klass->flags & TYPE_ATTRIBUTE_BEFORE_FIELD_INIT)
-		return FALSE;
+		/* Run at compile time, unless that has to be left to the generated code */
+		return cfg->defer_cctors && mono_class_needs_cctor_run (vtable->klass, method);
 
 	if (!mono_class_needs_cctor_run (vtable->klass, method))
 		return FALSE;
@@ -4418,6 +4817,71 @@ mini_emit_inst_for_method (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSign
 			
 			return ins;
 		}
+
+		/*
+		 * Inline version of Copy (Array, int, Array, int, int) for reference
+		 * szarrays of the same type. The arguments are checked inline and the
+		 * elements are copied with a single call to the bulk write barrier.
+		 * Everything else, including all the cases which throw, goes through
+		 * the managed method.
+		 */
+		if (strcmp (cmethod->name, "Copy") == 0 && fsig->param_count == 5 &&
+			fsig->params [1]->type == MONO_TYPE_I4 && args [2]->klass &&
+			args [2]->klass->rank == 1 && args [2]->klass->byval_arg.type == MONO_TYPE_SZARRAY &&
+			MONO_TYPE_IS_REFERENCE (&args [2]->klass->element_class->byval_arg)) {
+			MonoBasicBlock *slow_bb, *end_bb;
+			MonoInst *iargs [3];
+			int src_vtable_reg = alloc_preg (cfg);
+			int dest_vtable_reg = alloc_preg (cfg);
+			int limit_reg = alloc_ireg (cfg);
+			int src_len_reg = alloc_ireg (cfg);
+			int dest_len_reg = alloc_ireg (cfg);
+
+			NEW_BBLOCK (cfg, slow_bb);
+			NEW_BBLOCK (cfg, end_bb);
+
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, args [0]->dreg, 0);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, slow_bb);
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, args [2]->dreg, 0);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, slow_bb);
+
+			/* Identical vtables imply that no element needs a type check */
+			MONO_EMIT_NEW_LOAD_MEMBASE (cfg, src_vtable_reg, args [0]->dreg, G_STRUCT_OFFSET (MonoObject, vtable));
+			MONO_EMIT_NEW_LOAD_MEMBASE (cfg, dest_vtable_reg, args [2]->dreg, G_STRUCT_OFFSET (MonoObject, vtable));
+			MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, src_vtable_reg, dest_vtable_reg);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, slow_bb);
+
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, args [1]->dreg, 0);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBLT, slow_bb);
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, args [3]->dreg, 0);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBLT, slow_bb);
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, args [4]->dreg, 0);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBLT, slow_bb);
+
+			/* index > max_length - length can't overflow since both are positive */
+			MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, src_len_reg, args [0]->dreg, G_STRUCT_OFFSET (MonoArray, max_length));
+			MONO_EMIT_NEW_BIALU (cfg, OP_ISUB, limit_reg, src_len_reg, args [4]->dreg);
+			MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, args [1]->dreg, limit_reg);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBGT, slow_bb);
+			limit_reg = alloc_ireg (cfg);
+			MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, dest_len_reg, args [2]->dreg, G_STRUCT_OFFSET (MonoArray, max_length));
+			MONO_EMIT_NEW_BIALU (cfg, OP_ISUB, limit_reg, dest_len_reg, args [4]->dreg);
+			MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, args [3]->dreg, limit_reg);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBGT, slow_bb);
+
+			iargs [0] = mini_emit_ldelema_1_ins (cfg, args [2]->klass, args [2], args [3], FALSE);
+			iargs [1] = mini_emit_ldelema_1_ins (cfg, args [2]->klass, args [0], args [1], FALSE);
+			iargs [2] = args [4];
+			mono_emit_jit_icall (cfg, mono_gc_wbarrier_arrayref_copy, iargs);
+			MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+			MONO_START_BB (cfg, slow_bb);
+			ins = mono_emit_method_call (cfg, cmethod, args, NULL);
+
+			MONO_START_BB (cfg, end_bb);
+
+			return ins;
+		}
 #endif
 
  		if (cmethod->name [0] != 'g')
@@ -5698,6 +6162,318 @@ create_magic_tls_access (MonoCompile *cfg, MonoClassField *tls_field, MonoInst *
 	return addr;
 }
 
+/*
+ * emit_tier_up_check:
+ *
+ *   Emit code to decrement the call counter of tier 0 code, and to request the
+ * recompilation of the method when it reaches zero. The code is placed between
+ * INIT_BB and the first basic block of the IL code.
+ */
+static void
+emit_tier_up_check (MonoCompile *cfg, MonoBasicBlock *init_bb)
+{
+	MonoBasicBlock *first_bb, *count_bb, *tier_up_bb;
+	MonoInst *args [1];
+	int addr_reg, count_reg, new_count_reg;
+
+	first_bb = init_bb->next_bb;
+	g_assert (init_bb->out_count == 1 && init_bb->out_bb [0] == first_bb);
+
+	NEW_BBLOCK (cfg, count_bb);
+	NEW_BBLOCK (cfg, tier_up_bb);
+
+	mono_unlink_bblock (cfg, init_bb, first_bb);
+	init_bb->next_bb = count_bb;
+	link_bblock (cfg, init_bb, count_bb);
+
+	cfg->cbb = count_bb;
+	addr_reg = alloc_preg (cfg);
+	count_reg = alloc_ireg (cfg);
+	new_count_reg = alloc_ireg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, addr_reg, &cfg->tier_info->call_count);
+	MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, count_reg, addr_reg, 0);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ISUB_IMM, new_count_reg, count_reg, 1);
+	MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STOREI4_MEMBASE_REG, addr_reg, 0, new_count_reg);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, new_count_reg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBNE_UN, first_bb);
+
+	MONO_START_BB (cfg, tier_up_bb);
+	EMIT_NEW_PCONST (cfg, args [0], cfg->tier_info);
+	mono_emit_jit_icall (cfg, mono_tier_up_request, args);
+	cfg->cbb->next_bb = first_bb;
+	link_bblock (cfg, cfg->cbb, first_bb);
+
+	count_bb->real_offset = tier_up_bb->real_offset = init_bb->real_offset;
+}
+
+/*
+ * get_osr_locals_layout:
+ *
+ *   Return the offsets of the IL locals of the method in the per thread OSR buffer,
+ * the same for the tier 0 code and the OSR code. Set SIZE to the size of the buffer.
+ */
+static int*
+get_osr_locals_layout (MonoCompile *cfg, int *size)
+{
+	MonoMethodHeader *header = cfg->header;
+	int *offsets;
+	int i, offset = 0;
+
+	offsets = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * (header->num_locals + 1));
+	for (i = 0; i < header->num_locals; ++i) {
+		int align;
+		int lsize = mono_type_size (header->locals [i], &align);
+
+		offset = (offset + align - 1) & ~(align - 1);
+		offsets [i] = offset;
+		offset += lsize;
+	}
+
+	*size = offset;
+	return offsets;
+}
+
+/*
+ * emit_osr_check:
+ *
+ *   Emit code at the start of the loop header of SITE in tier 0 code to count the
+ * iterations of the loop. When the count reaches zero and the OSR code of the loop
+ * is ready, the locals are copied to the per thread OSR buffer, and the OSR code is
+ * called with the current arguments, its result becoming the result of the method.
+ * The IL stack has to be empty.
+ */
+static void
+emit_osr_check (MonoCompile *cfg, MonoOsrSite *site)
+{
+	MonoMethodHeader *header = cfg->header;
+	MonoMethodSignature *sig = mono_method_signature (cfg->method);
+	MonoBasicBlock *loop_bb;
+	MonoInst *args [1], **call_args, *code, *buf, *call, *ins, *store;
+	int *offsets;
+	int i, size, addr_reg, count_reg, new_count_reg;
+
+	NEW_BBLOCK (cfg, loop_bb);
+
+	addr_reg = alloc_preg (cfg);
+	count_reg = alloc_ireg (cfg);
+	new_count_reg = alloc_ireg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, addr_reg, &site->count);
+	MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, count_reg, addr_reg, 0);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ISUB_IMM, new_count_reg, count_reg, 1);
+	MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STOREI4_MEMBASE_REG, addr_reg, 0, new_count_reg);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, new_count_reg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_IBGT, loop_bb);
+
+	EMIT_NEW_PCONST (cfg, args [0], site);
+	code = mono_emit_jit_icall (cfg, mono_tier_osr_request, args);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, code->dreg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, loop_bb);
+
+	offsets = get_osr_locals_layout (cfg, &size);
+	EMIT_NEW_ICONST (cfg, args [0], size);
+	buf = mono_emit_jit_icall (cfg, mono_tier_osr_locals, args);
+	for (i = 0; i < header->num_locals; ++i) {
+		EMIT_NEW_LOCLOAD (cfg, ins, i);
+		EMIT_NEW_STORE_MEMBASE_TYPE (cfg, store, header->locals [i], buf->dreg, offsets [i], ins->dreg);
+	}
+
+	call_args = mono_mempool_alloc (cfg->mempool, sizeof (MonoInst*) * (sig->hasthis + sig->param_count + 1));
+	for (i = 0; i < sig->hasthis + sig->param_count; ++i)
+		EMIT_NEW_ARGLOAD (cfg, call_args [i], i);
+	call = mono_emit_calli (cfg, sig, call_args, code, NULL);
+	/* Stack walks skip the tier 0 frame while it waits for this call to return */
+	cfg->osr_calls = g_slist_prepend_mempool (cfg->mempool, cfg->osr_calls, call);
+	if (!MONO_TYPE_IS_VOID (sig->ret))
+		mono_arch_emit_setret (cfg, cfg->method, call);
+
+	MONO_INST_NEW (cfg, ins, OP_BR);
+	ins->inst_target_bb = cfg->bb_exit;
+	MONO_ADD_INS (cfg->cbb, ins);
+	link_bblock (cfg, cfg->cbb, cfg->bb_exit);
+
+	MONO_START_BB (cfg, loop_bb);
+}
+
+/*
+ * emit_osr_entry:
+ *
+ *   Make the OSR code being compiled continue after INIT_BB at the loop header of
+ * CFG->osr_site, with the locals loaded from the per thread OSR buffer filled by the
+ * tier 0 code. The code before the loop becomes unreachable.
+ */
+static void
+emit_osr_entry (MonoCompile *cfg, MonoBasicBlock *init_bb)
+{
+	MonoMethodHeader *header = cfg->header;
+	MonoBasicBlock *first_bb, *loop_bb;
+	MonoInst *args [1], *buf, *ins, *store;
+	int *offsets;
+	int i, size;
+
+	loop_bb = cfg->cil_offset_to_bb [cfg->osr_site->il_offset];
+	if (!loop_bb || loop_bb->in_scount) {
+		/* The tier 0 code doesn't emit OSR checks with a non empty IL stack */
+		cfg->exception_type = MONO_EXCEPTION_INVALID_PROGRAM;
+		cfg->exception_message = g_strdup ("OSR entry point with a non empty IL stack");
+		return;
+	}
+
+	first_bb = init_bb->next_bb;
+	g_assert (init_bb->out_count == 1 && init_bb->out_bb [0] == first_bb);
+	mono_unlink_bblock (cfg, init_bb, first_bb);
+
+	cfg->cbb = init_bb;
+	offsets = get_osr_locals_layout (cfg, &size);
+	EMIT_NEW_ICONST (cfg, args [0], 0);
+	buf = mono_emit_jit_icall (cfg, mono_tier_osr_locals, args);
+	for (i = 0; i < header->num_locals; ++i) {
+		EMIT_NEW_LOAD_MEMBASE_TYPE (cfg, ins, header->locals [i], buf->dreg, offsets [i]);
+		EMIT_NEW_LOCSTORE (cfg, store, i, ins);
+	}
+
+	MONO_INST_NEW (cfg, ins, OP_BR);
+	ins->inst_target_bb = loop_bb;
+	MONO_ADD_INS (cfg->cbb, ins);
+	link_bblock (cfg, cfg->cbb, loop_bb);
+}
+
+/*
+ * emit_receiver_profiling:
+ *
+ *   Emit code to record the vtable of THIS_INS, the receiver of the virtual call at IP
+ * in tier 0 code, in the MonoReceiverProfile of the call site.
+ */
+static void
+emit_receiver_profiling (MonoCompile *cfg, MonoInst *this_ins, guchar *ip)
+{
+	MonoReceiverProfile *prof;
+	MonoBasicBlock *poly_bb, *end_bb;
+	int vtable_reg, prof_reg, seen_reg;
+
+	prof = mini_tiered_get_receiver_profile (cfg->tier_info, ip - cfg->cil_start);
+
+	NEW_BBLOCK (cfg, poly_bb);
+	NEW_BBLOCK (cfg, end_bb);
+
+	vtable_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE_FAULT (cfg, vtable_reg, this_ins->dreg, G_STRUCT_OFFSET (MonoObject, vtable));
+	prof_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, prof_reg, prof);
+	seen_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE (cfg, seen_reg, prof_reg, G_STRUCT_OFFSET (MonoReceiverProfile, vtable));
+	MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, seen_reg, vtable_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBEQ, end_bb);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, seen_reg, 0);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, poly_bb);
+
+	/* First receiver */
+	MONO_EMIT_NEW_STORE_MEMBASE (cfg, OP_STORE_MEMBASE_REG, prof_reg, G_STRUCT_OFFSET (MonoReceiverProfile, vtable), vtable_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+	MONO_START_BB (cfg, poly_bb);
+	MONO_EMIT_NEW_STORE_MEMBASE_IMM (cfg, OP_STOREI4_MEMBASE_IMM, prof_reg, G_STRUCT_OFFSET (MonoReceiverProfile, polymorphic), 1);
+
+	MONO_START_BB (cfg, end_bb);
+}
+
+/*
+ * emit_guarded_devirt_call:
+ *
+ *   Emit the virtual call to CMETHOD at IP as a check that the receiver is an instance
+ * of the class seen by the tier 0 code of the method at this call site, followed by
+ * the implementation of CMETHOD in that class, inlined if possible, with the virtual
+ * call as the fallback. Return NULL if the receivers seen by the call site were not
+ * all of the same class.
+ */
+static MonoInst*
+emit_guarded_devirt_call (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig, MonoInst **sp,
+						  guchar *ip, GList *dont_inline, int *inline_costs)
+{
+	MonoVTable *vtable;
+	MonoClass *klass;
+	MonoMethod *impl;
+	MonoBasicBlock *slow_bb, *end_bb;
+	MonoInst *call, *res = NULL, **fast_args;
+	int i, slot, costs = 0, vtable_reg, expected_reg, res_reg = -1;
+
+	if (!(cfg->opt & MONO_OPT_INLINE) || cfg->compile_aot || cfg->generic_sharing_context || (cfg->opt & MONO_OPT_SHARED))
+		return NULL;
+	if (fsig->generic_param_count || fsig->pinvoke || fsig->call_convention == MONO_CALL_VARARG)
+		return NULL;
+	/* The arguments and the result are used by more than one call */
+	if (!MONO_TYPE_IS_VOID (fsig->ret) && MONO_TYPE_ISSTRUCT (fsig->ret))
+		return NULL;
+	for (i = 0; i < fsig->param_count; ++i) {
+		if (MONO_TYPE_ISSTRUCT (fsig->params [i]))
+			return NULL;
+	}
+
+	vtable = mini_tiered_get_monomorphic_receiver (cfg->method, cfg->domain, ip - cfg->cil_start);
+	if (!vtable)
+		return NULL;
+	klass = vtable->klass;
+	if (klass->valuetype || klass->marshalbyref || klass->is_com_object || klass == mono_defaults.transparent_proxy_class)
+		return NULL;
+
+	slot = mono_method_get_vtable_slot (cmethod);
+	if (slot == -1)
+		return NULL;
+	if (cmethod->klass->flags & TYPE_ATTRIBUTE_INTERFACE) {
+		int offset = mono_class_interface_offset (klass, cmethod->klass);
+
+		if (offset == -1)
+			return NULL;
+		slot += offset;
+	}
+	impl = klass->vtable [slot];
+	if (!impl || (impl->flags & (METHOD_ATTRIBUTE_ABSTRACT | METHOD_ATTRIBUTE_PINVOKE_IMPL)) ||
+		(impl->iflags & (METHOD_IMPL_ATTRIBUTE_SYNCHRONIZED | METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL | METHOD_IMPL_ATTRIBUTE_RUNTIME)) ||
+		mono_method_signature (impl)->generic_param_count)
+		return NULL;
+
+	NEW_BBLOCK (cfg, slow_bb);
+	NEW_BBLOCK (cfg, end_bb);
+
+	/* This also serves as the null check */
+	vtable_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_LOAD_MEMBASE_FAULT (cfg, vtable_reg, sp [0]->dreg, G_STRUCT_OFFSET (MonoObject, vtable));
+	expected_reg = alloc_preg (cfg);
+	MONO_EMIT_NEW_PCONST (cfg, expected_reg, vtable);
+	MONO_EMIT_NEW_BIALU (cfg, OP_COMPARE, -1, vtable_reg, expected_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_PBNE_UN, slow_bb);
+
+	/* inline_method () replaces the arguments with the result */
+	fast_args = mono_mempool_alloc (cfg->mempool, sizeof (MonoInst*) * (fsig->param_count + 1));
+	memcpy (fast_args, sp, sizeof (MonoInst*) * (fsig->param_count + 1));
+	if (mono_method_check_inlining (cfg, impl) && !g_list_find (dont_inline, impl))
+		costs = inline_method (cfg, impl, mono_method_signature (impl), fast_args, ip, cfg->real_offset, dont_inline, FALSE);
+	if (costs) {
+		*inline_costs += costs;
+		call = fast_args [0];
+		InterlockedIncrement (&mono_jit_stats.guarded_inlined_call_sites);
+	} else {
+		call = mono_emit_method_call_full (cfg, impl, mono_method_signature (impl), sp, NULL, NULL, NULL);
+	}
+	if (!MONO_TYPE_IS_VOID (fsig->ret)) {
+		res_reg = alloc_dreg (cfg, call->type);
+		EMIT_NEW_UNALU (cfg, res, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+		res->type = call->type;
+		res->klass = call->klass;
+	}
+	MONO_EMIT_NEW_BRANCH_BLOCK (cfg, OP_BR, end_bb);
+
+	MONO_START_BB (cfg, slow_bb);
+	call = mono_emit_method_call_full (cfg, cmethod, fsig, sp, sp [0], NULL, NULL);
+	if (res)
+		MONO_EMIT_NEW_UNALU (cfg, mono_type_to_regmove (cfg, fsig->ret), res_reg, call->dreg);
+
+	MONO_START_BB (cfg, end_bb);
+
+	InterlockedIncrement (&mono_jit_stats.guarded_devirt_call_sites);
+
+	return res ? res : call;
+}
+
 /*
  * mono_method_to_ir:
  *
@@ -5732,7 +6508,10 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 	MonoBoolean security, pinvoke;
 	MonoSecurityManager* secman = NULL;
 	MonoDeclSecurityActions actions;
+	/* The vtables (klasses in shared code) initialized in the current IL bblock */
 	GSList *class_inits = NULL;
+	/* The classes whose initialization is done in the init bblock */
+	GSList *hoisted_class_inits = NULL;
 	gboolean dont_verify, dont_verify_stloc, readonly = FALSE;
 	int context_used;
 	gboolean init_locals, seq_points, skip_dead_blocks;
@@ -6029,7 +6808,7 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 		}
 	}
 	
-	if ((init_locals || (cfg->method == method && (cfg->opt & MONO_OPT_SHARED))) || cfg->compile_aot || security || pinvoke) {
+	if ((init_locals || (cfg->method == method && ((cfg->opt & MONO_OPT_SHARED) || cfg->tier_info || cfg->osr_site || cfg->generic_sharing_context))) || cfg->compile_aot || security || pinvoke) {
 		/* we use a separate basic block for the initialization code */
 		NEW_BBLOCK (cfg, init_localsbb);
 		cfg->bb_init = init_localsbb;
@@ -6209,6 +6988,15 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 			}
 		}
 
+		if (cfg->tier_info && cfg->tier_info->osr_sites && cfg->method == method && ip == bblock->cil_code && sp == stack_start && !cfg->gen_seq_points && !COMPILE_SOFT_FLOAT (cfg)) {
+			MonoOsrSite *site = mini_tiered_get_osr_site (cfg->tier_info, ip - header->code);
+
+			if (site) {
+				emit_osr_check (cfg, site);
+				bblock = cfg->cbb;
+			}
+		}
+
 		if (skip_dead_blocks) {
 			int ip_offset = ip - header->code;
 
@@ -6800,8 +7588,14 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 			 * might not get called after the call was patched.
 			 */
 			if (cfg->generic_sharing_context && cmethod && cmethod->klass != method->klass && cmethod->klass->generic_class && mono_method_is_generic_sharable_impl (cmethod, TRUE) && mono_class_needs_cctor_run (cmethod->klass, method)) {
-				emit_generic_class_init (cfg, cmethod->klass);
-				CHECK_TYPELOAD (cmethod->klass);
+				if (g_slist_find (class_inits, cmethod->klass)) {
+					InterlockedIncrement (&mono_jit_stats.class_inits_removed);
+				} else {
+					emit_generic_class_init (cfg, cmethod->klass, TRUE);
+					CHECK_TYPELOAD (cmethod->klass);
+					bblock = cfg->cbb;
+					class_inits = g_slist_prepend (class_inits, cmethod->klass);
+				}
 			}
 
 			if (cmethod && ((cmethod->flags & METHOD_ATTRIBUTE_STATIC) || cmethod->klass->valuetype) &&
@@ -7262,8 +8056,27 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 
 			/* Common call */
 			INLINE_FAILURE;
-			ins = mono_emit_method_call_full (cfg, cmethod, fsig, sp, virtual ? sp [0] : NULL,
-											  imt_arg, vtable_arg);
+			ins = NULL;
+			if (virtual && !imt_arg && !vtable_arg && method == cfg->method &&
+				(cmethod->flags & METHOD_ATTRIBUTE_VIRTUAL) && !MONO_METHOD_IS_FINAL (cmethod)) {
+				/* Tier 0 code profiles the receivers for the guarded calls of the tier 1 code */
+				if (cfg->tier_info)
+					emit_receiver_profiling (cfg, sp [0], ip);
+				else
+					ins = emit_guarded_devirt_call (cfg, cmethod, fsig, sp, ip, dont_inline, &inline_costs);
+			}
+#ifdef MONO_ARCH_HAVE_CREATE_DELEGATE_TRAMPOLINE
+			if (!ins && virtual && !imt_arg && !vtable_arg)
+				ins = emit_delegate_invoke (cfg, cmethod, fsig, sp);
+#endif
+#ifdef MONO_ARCH_HAVE_INLINE_CACHES
+			if (!ins && virtual && !imt_arg && !vtable_arg)
+				ins = emit_pic_call (cfg, cmethod, fsig, sp);
+#endif
+			if (!ins)
+				ins = mono_emit_method_call_full (cfg, cmethod, fsig, sp, virtual ? sp [0] : NULL,
+												  imt_arg, vtable_arg);
+			bblock = cfg->cbb;
 
 			if (!MONO_TYPE_IS_VOID (fsig->ret))
 				*sp++ = mono_emit_widen_call_res (cfg, ins, fsig);
@@ -8045,8 +8858,14 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
  			}
 
 			if (cfg->generic_sharing_context && cmethod && cmethod->klass != method->klass && cmethod->klass->generic_class && mono_method_is_generic_sharable_impl (cmethod, TRUE) && mono_class_needs_cctor_run (cmethod->klass, method)) {
-				emit_generic_class_init (cfg, cmethod->klass);
-				CHECK_TYPELOAD (cmethod->klass);
+				if (g_slist_find (class_inits, cmethod->klass)) {
+					InterlockedIncrement (&mono_jit_stats.class_inits_removed);
+				} else {
+					emit_generic_class_init (cfg, cmethod->klass, TRUE);
+					CHECK_TYPELOAD (cmethod->klass);
+					bblock = cfg->cbb;
+					class_inits = g_slist_prepend (class_inits, cmethod->klass);
+				}
 			}
 
 			if (cmethod->klass->valuetype && mono_class_generic_sharing_enabled (cmethod->klass) &&
@@ -8125,20 +8944,37 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 			iargs [0] = NULL;
 
 			if (mini_class_is_system_array (cmethod->klass)) {
+				MonoMethod *managed_alloc = NULL;
+				MonoVTable *array_vtable = NULL;
+
 				g_assert (!vtable_arg);
 
-				*sp = emit_get_rgctx_method (cfg, context_used,
-											 cmethod, MONO_RGCTX_INFO_METHOD);
+				/* Rank 2 arrays with 0 lower bounds have a managed allocator */
+				if (cmethod->klass->rank == 2 && fsig->param_count == 2 && !context_used && !(cfg->opt & MONO_OPT_SHARED)) {
+					array_vtable = mono_class_vtable (cfg->domain, cmethod->klass);
+#ifndef MONO_CROSS_COMPILE
+					if (array_vtable)
+						managed_alloc = mono_gc_get_managed_array_allocator (array_vtable, 2);
+#endif
+				}
 
-				/* Avoid varargs in the common case */
-				if (fsig->param_count == 1)
-					alloc = mono_emit_jit_icall (cfg, mono_array_new_1, sp);
-				else if (fsig->param_count == 2)
-					alloc = mono_emit_jit_icall (cfg, mono_array_new_2, sp);
-				else if (fsig->param_count == 3)
-					alloc = mono_emit_jit_icall (cfg, mono_array_new_3, sp);
-				else
-					alloc = handle_array_new (cfg, fsig->param_count, sp, ip);
+				if (managed_alloc) {
+					EMIT_NEW_VTABLECONST (cfg, *sp, array_vtable);
+					alloc = mono_emit_method_call (cfg, managed_alloc, sp, NULL);
+				} else {
+					*sp = emit_get_rgctx_method (cfg, context_used,
+												 cmethod, MONO_RGCTX_INFO_METHOD);
+
+					/* Avoid varargs in the common case */
+					if (fsig->param_count == 1)
+						alloc = mono_emit_jit_icall (cfg, mono_array_new_1, sp);
+					else if (fsig->param_count == 2)
+						alloc = mono_emit_jit_icall (cfg, mono_array_new_2, sp);
+					else if (fsig->param_count == 3)
+						alloc = mono_emit_jit_icall (cfg, mono_array_new_3, sp);
+					else
+						alloc = handle_array_new (cfg, fsig->param_count, sp, ip);
+				}
 			} else if (cmethod->string_ctor) {
 				g_assert (!context_used);
 				g_assert (!vtable_arg);
@@ -8260,7 +9096,13 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 			if (cfg->generic_sharing_context)
 				context_used = mono_class_check_context_used (klass);
 
-			if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
+			if (use_cast_cache (cfg, klass, context_used)) {
+				ins = emit_cast_with_cache (cfg, klass, *sp, FALSE);
+				bblock = cfg->cbb;
+				*sp ++ = ins;
+				ip += 5;
+				inline_costs += 2;
+			} else if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
 				MonoMethod *mono_castclass = mono_marshal_get_castclass_with_cache ();
 				MonoInst *args [3];
 
@@ -8322,7 +9164,13 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 			if (cfg->generic_sharing_context)
 				context_used = mono_class_check_context_used (klass);
 
-			if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
+			if (use_cast_cache (cfg, klass, context_used)) {
+				ins = emit_cast_with_cache (cfg, klass, *sp, TRUE);
+				bblock = cfg->cbb;
+				*sp ++ = ins;
+				ip += 5;
+				inline_costs += 2;
+			} else if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
 				MonoMethod *mono_isinst = mono_marshal_get_isinst_with_cache ();
 				MonoInst *args [3];
 
@@ -8386,7 +9234,13 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 
 			if (generic_class_is_reference_type (cfg, klass)) {
 				/* CASTCLASS FIXME kill this huge slice of duplicated code*/
-				if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
+				if (use_cast_cache (cfg, klass, context_used)) {
+					ins = emit_cast_with_cache (cfg, klass, *sp, FALSE);
+					bblock = cfg->cbb;
+					*sp ++ = ins;
+					ip += 5;
+					inline_costs += 2;
+				} else if (!context_used && mini_class_has_reference_variant_generic_argument (cfg, klass, context_used)) {
 					MonoMethod *mono_castclass = mono_marshal_get_castclass_with_cache ();
 					MonoInst *args [3];
 
@@ -8887,8 +9741,31 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 					depth, field->offset);
 				*/
 
-				if (mono_class_needs_cctor_run (klass, method))
-					emit_generic_class_init (cfg, klass);
+				if (mono_class_needs_cctor_run (klass, method)) {
+					if ((klass->flags & TYPE_ATTRIBUTE_BEFORE_FIELD_INIT) && cfg->method == method && cfg->bb_init) {
+						/*
+						 * The cctor of a beforefieldinit class can run at any time before
+						 * the first access to a static field, so do the init once in the
+						 * init bblock, instead of at every access, possibly inside loops.
+						 */
+						if (g_slist_find (hoisted_class_inits, klass)) {
+							InterlockedIncrement (&mono_jit_stats.class_inits_removed);
+						} else {
+							MonoBasicBlock *cbb = cfg->cbb;
+
+							cfg->cbb = cfg->bb_init;
+							emit_generic_class_init (cfg, klass, FALSE);
+							cfg->cbb = cbb;
+							hoisted_class_inits = g_slist_prepend (hoisted_class_inits, klass);
+						}
+					} else if (g_slist_find (class_inits, klass)) {
+						InterlockedIncrement (&mono_jit_stats.class_inits_removed);
+					} else {
+						emit_generic_class_init (cfg, klass, TRUE);
+						bblock = cfg->cbb;
+						class_inits = g_slist_prepend (class_inits, klass);
+					}
+				}
 
 				/*
 				 * The pointer we're computing here is
@@ -8924,7 +9801,7 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 							class_inits = g_slist_prepend (class_inits, vtable);
 						}
 					} else {
-						if (cfg->run_cctors) {
+						if (cfg->run_cctors && !cfg->defer_cctors) {
 							MonoException *ex;
 							/* This makes so that inline cannot trigger */
 							/* .cctors: too many apps depend on them */
@@ -10611,6 +11488,14 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 		MONO_ADD_INS (cfg->bb_exit, ins);
 	}
 
+	if (cfg->method == method && cfg->osr_site) {
+		emit_osr_entry (cfg, init_localsbb);
+		CHECK_CFG_EXCEPTION;
+	}
+
+	if (cfg->method == method && cfg->tier_info)
+		emit_tier_up_check (cfg, init_localsbb);
+
 	cfg->ip = NULL;
 
 	if (cfg->method == method) {
@@ -10625,6 +11510,7 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 	}
 
 	g_slist_free (class_inits);
+	g_slist_free (hoisted_class_inits);
 	dont_inline = g_list_remove (dont_inline, method);
 
 	if (inline_costs < 0) {
@@ -10664,6 +11550,7 @@ mono_method_to_ir (MonoCompile *cfg, MonoMethod *method, MonoBasicBlock *start_b
 
  cleanup:
 	g_slist_free (class_inits);
+	g_slist_free (hoisted_class_inits);
 	mono_basic_block_free (original_bb);
 	dont_inline = g_list_remove (dont_inline, method);
 	cfg->headers_to_free = g_slist_prepend_mempool (cfg->mempool, cfg->headers_to_free, header);
@@ -5707,6 +5707,7 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 		case OP_CARD_TABLE_WBARRIER: {
 			int ptr = ins->sreg1;
 			int value = ins->sreg2;
+			int card_base = ins->sreg3;
 			guchar *br;
 			int nursery_shift, card_table_shift;
 			gpointer card_table_mask;
@@ -5726,7 +5727,9 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			 * We need one register we can clobber, we choose EDX and make sreg1
 			 * fixed EAX to work around limitations in the local register allocator.
 			 * sreg2 might get allocated to EDX, but that is not a problem since
-			 * we use it before clobbering EDX.
+			 * we use it before clobbering EDX. sreg3 holds the address of the card
+			 * table, if it was allocated to EDX, the address is loaded from memory
+			 * instead.
 			 */
 			g_assert (ins->sreg1 == AMD64_RAX);
 
@@ -5739,8 +5742,7 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			 *   jne done
 			 *   edx = ptr
 			 *   edx >>= card_table_shift
-			 *   edx += cardtable
-			 *   [edx] = 1
+			 *   [edx + cardtable] = 1
 			 * done:
 			 */
 
@@ -5766,10 +5768,14 @@ mono_arch_output_basic_block (MonoCompile *cfg, MonoBasicBlock *bb)
 			if (card_table_mask)
 				amd64_alu_reg_imm (code, X86_AND, AMD64_RDX, (guint32)(guint64)card_table_mask);
 
-			mono_add_patch_info (cfg, code - cfg->native_code, MONO_PATCH_INFO_GC_CARD_TABLE_ADDR, card_table);
-			amd64_alu_reg_membase (code, X86_ADD, AMD64_RDX, AMD64_RIP, 0);
+			if (card_base != -1 && card_base != AMD64_RDX) {
+				amd64_mov_memindex_imm (code, card_base, 0, AMD64_RDX, 0, 1, 1);
+			} else {
+				mono_add_patch_info (cfg, code - cfg->native_code, MONO_PATCH_INFO_GC_CARD_TABLE_ADDR, card_table);
+				amd64_alu_reg_membase (code, X86_ADD, AMD64_RDX, AMD64_RIP, 0);
 
-			amd64_mov_membase_imm (code, AMD64_RDX, 0, 1, 1);
+				amd64_mov_membase_imm (code, AMD64_RDX, 0, 1, 1);
+			}
 			x86_patch (br, code);
 			break;
 		}
@@ -6599,6 +6605,21 @@ mono_arch_emit_prolog (MonoCompile *cfg)
 	async_exc_point (code);
 	mini_gc_set_slot_type_from_cfa (cfg, -cfa_offset, SLOT_NOREF);
 
+#ifdef MONO_ARCH_HAVE_TIERED_COMPILATION
+	if (cfg->tier_info) {
+		/*
+		 * An 8 byte nop which is replaced by a jump to the tier 1 code, see
+		 * mono_arch_patch_tier0_entry ().
+		 */
+		g_assert (code == cfg->native_code);
+		*(code ++) = 0x0f;
+		*(code ++) = 0x1f;
+		*(code ++) = 0x84;
+		memset (code, 0, 5);
+		code += 5;
+	}
+#endif
+
 	if (!cfg->arch.omit_fp) {
 		amd64_push_reg (code, AMD64_RBP);
 		cfa_offset += 8;
@@ -7294,6 +7315,8 @@ mono_arch_emit_exceptions (MonoCompile *cfg)
 		if (patch_info->type == MONO_PATCH_INFO_GC_CARD_TABLE_ADDR)
 			code_size += 8 + 7; /*sizeof (void*) + alignment */
 	}
+	if (cfg->tier_info)
+		code_size += AMD64_TIER0_STUB_SIZE;
 
 #ifdef __native_client_codegen__
 	/* Give us extra room on Native Client.  This could be   */
@@ -7485,6 +7508,15 @@ mono_arch_emit_exceptions (MonoCompile *cfg)
 		g_assert (code < cfg->native_code + cfg->code_size);
 	}
 
+#ifdef MONO_ARCH_HAVE_TIERED_COMPILATION
+	if (cfg->tier_info) {
+		/* The stub used to jump to the tier 1 code, it has to come last */
+		amd64_jump_membase (code, AMD64_RIP, 0);
+		*(gpointer*)code = NULL;
+		code += sizeof (gpointer);
+	}
+#endif
+
 	cfg->code_len = code - cfg->native_code;
 
 	g_assert (cfg->code_len < cfg->code_size);
@@ -7969,27 +8001,42 @@ mono_arch_get_delegate_invoke_impl (MonoMethodSignature *sig, gboolean has_targe
 		cached = start;
 	} else {
 		static guint8* cache [MAX_ARCH_DELEGATE_PARAMS + 1] = {NULL};
-		for (i = 0; i < sig->param_count; ++i)
-			if (!mono_is_regsize_var (sig->params [i]))
+		int nint = 0, nfp = 0;
+
+		/*
+		 * The stub only shifts the integer arguments. On linux, fp arguments are
+		 * passed in their own registers, so they don't need to be moved, and the
+		 * stubs are shared by all signatures with the same number of integer
+		 * arguments.
+		 */
+		for (i = 0; i < sig->param_count; ++i) {
+			if (mono_is_regsize_var (sig->params [i]))
+				nint ++;
+#ifndef HOST_WIN32
+			else if (sig->params [i]->type == MONO_TYPE_R4 || sig->params [i]->type == MONO_TYPE_R8)
+				nfp ++;
+#endif
+			else
 				return NULL;
-		if (sig->param_count > 4)
+		}
+		if (nint > 4 || nfp > FLOAT_PARAM_REGS)
 			return NULL;
 
-		code = cache [sig->param_count];
+		code = cache [nint];
 		if (code)
 			return code;
 
 		if (mono_aot_only) {
-			char *name = g_strdup_printf ("delegate_invoke_impl_target_%d", sig->param_count);
+			char *name = g_strdup_printf ("delegate_invoke_impl_target_%d", nint);
 			start = mono_aot_get_trampoline (name);
 			g_free (name);
 		} else {
-			start = get_delegate_invoke_impl (FALSE, sig->param_count, NULL);
+			start = get_delegate_invoke_impl (FALSE, nint, NULL);
 		}
 
 		mono_memory_barrier ();
 
-		cache [sig->param_count] = start;
+		cache [nint] = start;
 	}
 
 	return start;
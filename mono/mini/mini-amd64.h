@@ -383,9 +383,18 @@ typedef struct MonoCompileArch {
 #define MONO_ARCH_THIS_AS_FIRST_ARG 1
 #define MONO_ARCH_HAVE_HANDLER_BLOCK_GUARD 1
 #define MONO_ARCH_HAVE_CARD_TABLE_WBARRIER 1
+#define MONO_ARCH_HAVE_CARD_TABLE_WBARRIER_BASE 1
 #define MONO_ARCH_HAVE_SETUP_RESUME_FROM_SIGNAL_HANDLER_CTX 1
 #define MONO_ARCH_GC_MAPS_SUPPORTED 1
 #define MONO_ARCH_HAVE_CONTEXT_SET_INT_REG 1
+#define MONO_ARCH_HAVE_INLINE_CACHES 1
+
+#if defined(__default_codegen__)
+#define MONO_ARCH_HAVE_TIERED_COMPILATION 1
+#endif
+
+/* The size of the stub at the end of tier 0 code, see mono_arch_patch_tier0_entry () */
+#define AMD64_TIER0_STUB_SIZE 14
 
 gboolean
 mono_amd64_tail_call_supported (MonoMethodSignature *caller_sig, MonoMethodSignature *callee_sig) MONO_INTERNAL;
@@ -555,6 +555,32 @@ ves_icall_System_Exception_get_trace (MonoException *ex)
 	return res;
 }
 
+/*
+ * is_osr_caller_frame:
+ *
+ *   Return whenever the frame of JI at IP is tier 0 code waiting for the OSR code of one
+ * of its loops to return. The OSR code continues the execution of the method, so stack
+ * traces show only its frame.
+ */
+static gboolean
+is_osr_caller_frame (MonoJitInfo *ji, gpointer ip)
+{
+	MonoOsrCallTableJitInfo *table;
+	guint32 offset;
+	int i;
+
+	if (!ji || !ji->has_osr_calls)
+		return FALSE;
+
+	table = mono_jit_info_get_osr_call_table_info (ji);
+	offset = (guint8*)ip - (guint8*)ji->code_start;
+	for (i = 0; i < table->num_calls; ++i) {
+		if (table->offsets [i] == offset)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 MonoArray *
 ves_icall_get_trace (MonoException *exc, gint32 skip, MonoBoolean need_file_info)
 {
@@ -773,7 +799,7 @@ mono_walk_stack_full (MonoJitStackWalk func, MonoContext *start_ctx, MonoDomain
 		if (get_reg_locations)
 			frame.reg_locations = reg_locations;
 
-		if (func (&frame, &ctx, user_data))
+		if (!is_osr_caller_frame (frame.ji, MONO_CONTEXT_GET_IP (&ctx)) && func (&frame, &ctx, user_data))
 			return;
 
 		if (get_reg_locations) {
@@ -825,6 +851,9 @@ ves_icall_get_frame_info (gint32 skip, MonoBoolean need_file_info,
 		ji = frame.ji;
 		*native_offset = frame.native_offset;
 
+		if (is_osr_caller_frame (ji, MONO_CONTEXT_GET_IP (&ctx)))
+			continue;
+
 		/* skip all wrappers ??*/
 		if (ji->method->wrapper_type == MONO_WRAPPER_RUNTIME_INVOKE ||
 		    ji->method->wrapper_type == MONO_WRAPPER_XDOMAIN_INVOKE ||
@@ -1182,15 +1211,32 @@ wrap_non_exception_throws (MonoMethod *m)
 	g_list_free (trace_ips);	\
 	trace_ips = NULL;	\
 } while (0)
+/*
+ * The first few frames unwound by the first pass of exception handling. Most
+ * exceptions are caught in the throwing method or in its caller, so the second
+ * pass can reuse these instead of unwinding the same frames again.
+ */
+#define EH_CACHED_FRAMES 2
+
+typedef struct {
+	int num_frames;
+	/* Set when the frames can't be reused, i.e. when a filter was called */
+	gboolean invalid;
+	MonoJitInfo *ji [EH_CACHED_FRAMES];
+	MonoContext new_ctx [EH_CACHED_FRAMES];
+	MonoLMF *lmf [EH_CACHED_FRAMES];
+} EHFrameCache;
+
 /*
  * mono_handle_exception_internal_first_pass:
  *
  *   The first pass of exception handling. Unwind the stack until a catch clause which can catch
  * OBJ is found. Run the index of the filter clause which caught the exception into
  * OUT_FILTER_IDX. Return TRUE if the exception is caught, FALSE otherwise.
+ * If FRAMES is not NULL, the first frames unwound are saved into it.
  */
 static gboolean
-mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpointer original_ip, gint32 *out_filter_idx, MonoJitInfo **out_ji, MonoObject *non_exception)
+mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpointer original_ip, gint32 *out_filter_idx, MonoJitInfo **out_ji, MonoObject *non_exception, EHFrameCache *frames)
 {
 	MonoDomain *domain = mono_domain_get ();
 	MonoJitInfo *ji;
@@ -1247,6 +1293,9 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 		unwind_res = mono_find_jit_info_ext (domain, jit_tls, NULL, ctx, &new_ctx, NULL, &lmf, NULL, &frame);
 		if (unwind_res) {
 			if (frame.type == FRAME_TYPE_DEBUGGER_INVOKE || frame.type == FRAME_TYPE_MANAGED_TO_NATIVE) {
+				/* The second pass only reuses consecutive managed frames */
+				if (frames)
+					frames->invalid = TRUE;
 				*ctx = new_ctx;
 				continue;
 			}
@@ -1259,6 +1308,13 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 			return FALSE;
 		}
 
+		if (frames && frame_count < EH_CACHED_FRAMES) {
+			frames->ji [frame_count] = ji;
+			frames->new_ctx [frame_count] = new_ctx;
+			frames->lmf [frame_count] = lmf;
+			frames->num_frames = frame_count + 1;
+		}
+
 		frame_count ++;
 		//printf ("M: %s %d.\n", mono_method_full_name (ji->method, TRUE), frame_count);
 
@@ -1274,7 +1330,7 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 			 * rethrown. Also avoid giant stack traces during a stack
 			 * overflow.
 			 */
-			if (!initial_trace_ips && (frame_count < 1000)) {
+			if (!initial_trace_ips && (frame_count < 1000) && !is_osr_caller_frame (ji, MONO_CONTEXT_GET_IP (ctx))) {
 				trace_ips = g_list_prepend (trace_ips, MONO_CONTEXT_GET_IP (ctx));
 				trace_ips = g_list_prepend (trace_ips,
 											get_generic_info_from_stack_frame (ji, ctx));
@@ -1342,6 +1398,10 @@ mono_handle_exception_internal_first_pass (MonoContext *ctx, gpointer obj, gpoin
 						*((gpointer *)(gpointer)((char *)MONO_CONTEXT_GET_BP (ctx) + ei->exvar_offset)) = ex_obj;
 					}
 
+					/* The filter can change the state of the frames */
+					if (frames)
+						frames->invalid = TRUE;
+
 					mono_debugger_agent_begin_exception_filter (mono_ex, ctx, &initial_ctx);
 					filtered = call_filter (ctx, ei->data.filter);
 					mono_debugger_agent_end_exception_filter (mono_ex, ctx, &initial_ctx);
@@ -1402,6 +1462,7 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 	int i;
 	MonoObject *ex_obj;
 	MonoObject *non_exception = NULL;
+	EHFrameCache frames;
 
 	g_assert (ctx != NULL);
 	if (!obj) {
@@ -1473,6 +1534,9 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 	 */
 	memcpy (&jit_tls->orig_ex_ctx, ctx, sizeof (MonoContext));
 
+	frames.num_frames = 0;
+	frames.invalid = FALSE;
+
 	if (!resume) {
 		gboolean res;
 
@@ -1505,7 +1569,8 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 		mono_profiler_exception_thrown (obj);
 		jit_tls->orig_ex_ctx_set = FALSE;
 
-		res = mono_handle_exception_internal_first_pass (&ctx_cp, obj, original_ip, &first_filter_idx, &ji, non_exception);
+		/* The debugger can change the values saved in the frames between the two passes */
+		res = mono_handle_exception_internal_first_pass (&ctx_cp, obj, original_ip, &first_filter_idx, &ji, non_exception, mini_get_debug_options ()->gen_seq_points ? NULL : &frames);
 
 		if (!res) {
 			if (mono_break_on_exc)
@@ -1552,6 +1617,11 @@ mono_handle_exception_internal (MonoContext *ctx, gpointer obj, gpointer origina
 			lmf = jit_tls->resume_state.lmf;
 			first_filter_idx = jit_tls->resume_state.first_filter_idx;
 			filter_idx = jit_tls->resume_state.filter_idx;
+		} else if (frame_count < frames.num_frames && !frames.invalid) {
+			/* Reuse the frame unwound by the first pass */
+			ji = frames.ji [frame_count];
+			new_ctx = frames.new_ctx [frame_count];
+			lmf = frames.lmf [frame_count];
 		} else {
 			StackFrameInfo frame;
 
@@ -1779,7 +1849,7 @@ mono_debugger_handle_exception (MonoContext *ctx, MonoObject *obj)
 		 * The debugger wants us to stop only if this exception is user-unhandled.
 		 */
 
-		ret = mono_handle_exception_internal_first_pass (&ctx_cp, obj, MONO_CONTEXT_GET_IP (ctx), NULL, &ji, NULL);
+		ret = mono_handle_exception_internal_first_pass (&ctx_cp, obj, MONO_CONTEXT_GET_IP (ctx), NULL, &ji, NULL, NULL);
 		if (ret && (ji != NULL) && (ji->method->wrapper_type == MONO_WRAPPER_RUNTIME_INVOKE)) {
 			/*
 			 * The exception is handled in a runtime-invoke wrapper, that means that it's unhandled
@@ -242,6 +242,10 @@ typedef struct {
 	int scanned_registers;
 	int scanned_native;
 	int scanned_other;
+
+	int frames_with_maps;
+	int frames_without_maps;
+	int frames_unknown_callsite;
 	
 	int all_slots;
 	int noref_slots;
@@ -623,6 +627,41 @@ get_frame_pointer (MonoContext *ctx, int frame_reg)
 		return 0;
 }
 
+/*
+ * find_callsite:
+ *
+ *   Return the index of the callsite at PC_OFFSET in MAP, or -1 if there is none.
+ * The callsites are ordered by pc offset.
+ */
+static int
+find_callsite (GCMap *map, int pc_offset)
+{
+	int low = 0, high = map->ncallsites - 1;
+
+	/* ip points inside the call instruction */
+	pc_offset ++;
+
+	while (low <= high) {
+		int mid = low + ((high - low) >> 1);
+		int offset;
+
+		if (map->callsite_entry_size == 1)
+			offset = map->callsites.offsets8 [mid];
+		else if (map->callsite_entry_size == 2)
+			offset = map->callsites.offsets16 [mid];
+		else
+			offset = map->callsites.offsets32 [mid];
+
+		if (offset == pc_offset)
+			return mid;
+		else if (offset < pc_offset)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1;
+}
+
 /*
  * conservatively_pass:
  *
@@ -783,6 +822,7 @@ conservative_pass (TlsData *tls, guint8 *stack_start, guint8 *stack_end)
 		if (!emap) {
 			DEBUG (char *fname = mono_method_full_name (ji->method, TRUE); fprintf (logfile, "Mark(0): %s+0x%x (%p)\n", fname, pc_offset, (gpointer)MONO_CONTEXT_GET_IP (&ctx)); g_free (fname));
 			DEBUG (fprintf (logfile, "\tNo GC Map.\n"));
+			stats.frames_without_maps ++;
 			continue;
 		}
 
@@ -824,29 +864,18 @@ conservative_pass (TlsData *tls, guint8 *stack_start, guint8 *stack_end)
 		DEBUG (char *fname = mono_method_full_name (ji->method, TRUE); fprintf (logfile, "Mark(0): %s+0x%x (%p) limit=%p fp=%p frame=%p-%p (%d)\n", fname, pc_offset, (gpointer)MONO_CONTEXT_GET_IP (&ctx), stack_limit, fp, frame_start, frame_end, (int)(frame_end - frame_start)); g_free (fname));
 
 		/* Find the callsite index */
-		if (map->callsite_entry_size == 1) {
-			for (i = 0; i < map->ncallsites; ++i)
-				/* ip points inside the call instruction */
-				if (map->callsites.offsets8 [i] == pc_offset + 1)
-					break;
-		} else if (map->callsite_entry_size == 2) {
-			// FIXME: Use a binary search
-			for (i = 0; i < map->ncallsites; ++i)
-				/* ip points inside the call instruction */
-				if (map->callsites.offsets16 [i] == pc_offset + 1)
-					break;
-		} else {
-			// FIXME: Use a binary search
-			for (i = 0; i < map->ncallsites; ++i)
-				/* ip points inside the call instruction */
-				if (map->callsites.offsets32 [i] == pc_offset + 1)
-					break;
-		}
-		if (i == map->ncallsites) {
-			printf ("Unable to find ip offset 0x%x in callsite list of %s.\n", pc_offset + 1, mono_method_full_name (ji->method, TRUE));
-			g_assert_not_reached ();
+		cindex = find_callsite (map, pc_offset);
+		if (cindex == -1) {
+			/*
+			 * This happens for frames stopped inside finally clauses or epilogs, see
+			 * the comment at the end of the file. Treat them like frames without a GC
+			 * map: the frame is scanned conservatively together with the next frame.
+			 */
+			DEBUG (fprintf (logfile, "\tUnable to find ip offset 0x%x in callsite list.\n", pc_offset + 1));
+			stats.frames_unknown_callsite ++;
+			continue;
 		}
-		cindex = i;
+		stats.frames_with_maps ++;
 
 		g_assert (real_frame_start >= stack_limit);
 
@@ -2366,6 +2395,13 @@ mini_gc_init (void)
 							MONO_COUNTER_GC | MONO_COUNTER_INT, &stats.scanned_conservatively);
 	mono_counters_register ("Stack space scanned (pin registers)",
 							MONO_COUNTER_GC | MONO_COUNTER_INT, &stats.scanned_registers);
+
+	mono_counters_register ("Stack frames scanned (using GC Maps)",
+							MONO_COUNTER_GC | MONO_COUNTER_INT, &stats.frames_with_maps);
+	mono_counters_register ("Stack frames scanned (no GC Map)",
+							MONO_COUNTER_GC | MONO_COUNTER_INT, &stats.frames_without_maps);
+	mono_counters_register ("Stack frames scanned (unknown callsite)",
+							MONO_COUNTER_GC | MONO_COUNTER_INT, &stats.frames_unknown_callsite);
 }
 
 #else
@@ -2421,7 +2457,7 @@ mini_gc_init_cfg (MonoCompile *cfg)
  *   we promote all surviving objects to old-gen.
  * - the unwind code can't handle a method stopped inside a finally region, it thinks the caller is
  *   another method, but in reality it is either the exception handling code or the CALL_HANDLER opcode.
- *   This manifests in "Unable to find ip offset x in callsite list" assertions.
+ *   Such frames are not found in the callsite list, so they are scanned conservatively.
  * - the unwind code also can't handle frames which are in the epilog, since the unwind info is not
  *   precise there.
  */
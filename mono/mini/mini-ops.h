@@ -580,6 +580,8 @@ MINI_OP(OP_ROUND,   "round", FREG, FREG, NONE)
 /* to optimize strings */
 MINI_OP(OP_STRLEN, "strlen", IREG, IREG, NONE)
 MINI_OP(OP_NEWARR, "newarr", IREG, IREG, NONE)
+/* object allocation, decomposed after mono_ssa_escape_analysis () */
+MINI_OP(OP_NEWOBJ, "newobj", IREG, NONE, NONE)
 MINI_OP(OP_LDLEN, "ldlen", IREG, IREG, NONE)
 MINI_OP(OP_BOUNDS_CHECK, "bounds_check", NONE, IREG, IREG)
 /* get adress of element in a 2D array */
@@ -592,7 +594,12 @@ MINI_OP(OP_SAVE_LMF, "save_lmf", NONE, NONE, NONE)
 MINI_OP(OP_RESTORE_LMF, "restore_lmf", NONE, NONE, NONE)
 
 /* write barrier */
+#if defined(TARGET_AMD64)
+/* sreg3 is the address of the card table */
+MINI_OP3(OP_CARD_TABLE_WBARRIER, "card_table_wbarrier", NONE, IREG, IREG, IREG)
+#else
 MINI_OP(OP_CARD_TABLE_WBARRIER, "card_table_wbarrier", NONE, IREG, IREG)
+#endif
 
 /* arch-dep tls access */
 MINI_OP(OP_TLS_GET,            "tls_get", IREG, NONE, NONE)
@@ -0,0 +1,636 @@
+/*
+ * mini-tiered.c: Tiered compilation support for the mono JIT
+ *
+ * When tiered compilation is enabled, methods are first compiled quickly using
+ * MONO_TIER0_OPTS, with a call counter in their prolog. When the counter reaches
+ * zero, the method is queued, and a background thread recompiles it with the full
+ * set of optimizations. The entry of the tier 0 code is then patched to jump to the
+ * new code, so callers which already have the address of the tier 0 code (vtable
+ * slots, patched call sites, delegates) end up in the tier 1 code too.
+ *
+ * Methods with loops can be hot even if they are called only once, so tier 0 code
+ * also counts the iterations of its loops. When the count of a loop reaches zero,
+ * a version of the method whose entry point is the loop header is compiled in the
+ * background (OSR code). The next time the count reaches zero, the tier 0 code copies
+ * its locals to a per thread buffer and calls the OSR code with its current arguments,
+ * which loads the locals and continues the loop. The tier 0 frame stays below the OSR
+ * frame, and returns the value returned by the OSR code.
+ *
+ * Copyright 2011 Xamarin, Inc (http://www.xamarin.com)
+ */
+
+#include "config.h"
+#include "mini-tiered.h"
+#include <mono/metadata/threads-types.h>
+#include <mono/metadata/mono-basic-block.h>
+#include <mono/metadata/mono-endian.h>
+#include <mono/metadata/gc-internal.h>
+#include <mono/utils/mono-memory-model.h>
+
+#ifdef MONO_ARCH_HAVE_TIERED_COMPILATION
+
+/* The number of calls after which a method is recompiled, set by MONO_TIER_UP_THRESHOLD */
+static int tier_up_threshold = 1000;
+/* The number of loop iterations after which OSR is tried, set by MONO_OSR_THRESHOLD */
+static int osr_threshold = 10000;
+
+/* Protects the fields below */
+static CRITICAL_SECTION tiered_mutex;
+
+#define mono_tiered_lock() EnterCriticalSection (&tiered_mutex)
+#define mono_tiered_unlock() LeaveCriticalSection (&tiered_mutex)
+
+/* Maps MonoMethod -> MonoTierInfo, only methods of the root domain are tiered */
+static GHashTable *tier_infos;
+/* The MonoTierInfo's waiting to be recompiled */
+static GQueue *tier_up_queue;
+/* The MonoOsrSite's waiting for their OSR code to be compiled */
+static GQueue *osr_queue;
+static gboolean tier_up_thread_started;
+/* Signalled when something is added to tier_up_queue */
+static HANDLE tier_up_event;
+
+void
+mini_tiered_init (void)
+{
+	const char *threshold;
+
+	if (!mono_tiered_compilation)
+		return;
+
+	InitializeCriticalSection (&tiered_mutex);
+	tier_infos = g_hash_table_new (NULL, NULL);
+	tier_up_queue = g_queue_new ();
+	osr_queue = g_queue_new ();
+	tier_up_event = CreateEvent (NULL, FALSE, FALSE, NULL);
+	g_assert (tier_up_event);
+
+	threshold = g_getenv ("MONO_TIER_UP_THRESHOLD");
+	if (threshold) {
+		tier_up_threshold = atoi (threshold);
+		if (tier_up_threshold <= 0) {
+			fprintf (stderr, "Invalid value for MONO_TIER_UP_THRESHOLD: '%s'.\n", threshold);
+			exit (1);
+		}
+	}
+
+	threshold = g_getenv ("MONO_OSR_THRESHOLD");
+	if (threshold) {
+		osr_threshold = atoi (threshold);
+		if (osr_threshold <= 0) {
+			fprintf (stderr, "Invalid value for MONO_OSR_THRESHOLD: '%s'.\n", threshold);
+			exit (1);
+		}
+	}
+}
+
+/*
+ * is_in_clause:
+ *
+ *   Return whenever OFFSET is inside a protected block, a handler or a filter of HEADER.
+ */
+static gboolean
+is_in_clause (MonoMethodHeader *header, guint32 offset)
+{
+	int i;
+
+	for (i = 0; i < header->num_clauses; ++i) {
+		MonoExceptionClause *clause = &header->clauses [i];
+
+		if (MONO_OFFSET_IN_CLAUSE (clause, offset) || MONO_OFFSET_IN_HANDLER (clause, offset) || MONO_OFFSET_IN_FILTER (clause, offset))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * add_backward_branch:
+ *
+ *   If the branch at IP of SIZE bytes with displacement DISP goes backwards, add its
+ * target to HEADERS, unless it is inside an exception clause, since the OSR code can
+ * only be entered from outside of them.
+ */
+static void
+add_backward_branch (MonoMethodHeader *header, const unsigned char *ip, int size, int disp, gboolean *has_loops, GSList **headers)
+{
+	guint32 target;
+
+	/* Branch offsets are relative to the next instruction */
+	if (disp + size > 0)
+		return;
+
+	*has_loops = TRUE;
+	target = ip + size + disp - header->code;
+	if (!is_in_clause (header, target) && !g_slist_find (*headers, GUINT_TO_POINTER (target)))
+		*headers = g_slist_prepend (*headers, GUINT_TO_POINTER (target));
+}
+
+/*
+ * method_has_loops:
+ *
+ *   Return whenever the IL code of HEADER contains a backward branch. Set OSR_HEADERS
+ * to the IL offsets of the loop headers where OSR code can be entered.
+ */
+static gboolean
+method_has_loops (MonoMethodHeader *header, GSList **osr_headers)
+{
+	const unsigned char *ip = header->code;
+	const unsigned char *end = ip + header->code_size;
+	gboolean has_loops = FALSE, has_localloc = FALSE;
+	GSList *headers = NULL;
+
+	while (ip < end) {
+		const unsigned char *p = ip;
+		int i, op, size, nentries;
+
+		size = mono_opcode_value_and_size (&p, end, &op);
+		if (size < 0) {
+			/* Let the JIT report the error */
+			has_loops = TRUE;
+			has_localloc = TRUE;
+			break;
+		}
+
+		switch (mono_opcodes [op].argument) {
+		case MonoShortInlineBrTarget:
+			add_backward_branch (header, ip, size, (gint8)ip [size - 1], &has_loops, &headers);
+			break;
+		case MonoInlineBrTarget:
+			add_backward_branch (header, ip, size, (gint32)read32 (ip + size - 4), &has_loops, &headers);
+			break;
+		case MonoInlineSwitch:
+			nentries = read32 (ip + 1);
+			for (i = 0; i < nentries; ++i)
+				add_backward_branch (header, ip, size, (gint32)read32 (ip + 5 + (i * 4)), &has_loops, &headers);
+			break;
+		default:
+			break;
+		}
+
+		/* The OSR code would have its own copy of the memory */
+		if (op == MONO_CEE_LOCALLOC)
+			has_localloc = TRUE;
+
+		ip += size;
+	}
+
+	if (has_localloc) {
+		g_slist_free (headers);
+		headers = NULL;
+	}
+	*osr_headers = headers;
+
+	return has_loops;
+}
+
+/*
+ * can_osr:
+ *
+ *   Return whenever the state of METHOD at its loop headers can be moved to OSR code,
+ * which receives the arguments as normal arguments and the locals through the per
+ * thread OSR buffer. Pointers to the locals of the tier 0 frame would keep pointing
+ * into it, so methods with locals which can hold them are excluded.
+ */
+static gboolean
+can_osr (MonoMethod *method, MonoMethodHeader *header)
+{
+	MonoMethodSignature *sig = mono_method_signature (method);
+	int i;
+
+	if (!sig || sig->call_convention == MONO_CALL_VARARG || MONO_TYPE_ISSTRUCT (sig->ret))
+		return FALSE;
+
+	for (i = 0; i < header->num_locals; ++i) {
+		MonoType *t = header->locals [i];
+
+		if (t->byref || t->pinned || t->type == MONO_TYPE_PTR || t->type == MONO_TYPE_FNPTR ||
+			t->type == MONO_TYPE_TYPEDBYREF)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * mini_tiered_get_tier0_info:
+ *
+ *   Return the MonoTierInfo to use when compiling METHOD as tier 0 code, or NULL if
+ * METHOD should be compiled normally, either because it can't be tiered, or
+ * because it is being recompiled.
+ */
+MonoTierInfo*
+mini_tiered_get_tier0_info (MonoMethod *method, MonoDomain *domain, guint32 opts)
+{
+	MonoTierInfo *info;
+	MonoMethodHeader *header;
+	GSList *osr_headers, *l;
+	gboolean has_loops;
+
+	if (!mono_tiered_compilation)
+		return NULL;
+	/* Domain specific code is freed when its domain is unloaded */
+	if (domain != mono_get_root_domain () || (opts & MONO_OPT_SHARED))
+		return NULL;
+	if (method->wrapper_type != MONO_WRAPPER_NONE || method->dynamic)
+		return NULL;
+	if ((method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL) || (method->iflags & METHOD_IMPL_ATTRIBUTE_RUNTIME) ||
+		(method->flags & METHOD_ATTRIBUTE_PINVOKE_IMPL))
+		return NULL;
+
+	mono_tiered_lock ();
+	info = g_hash_table_lookup (tier_infos, method);
+	mono_tiered_unlock ();
+	if (info)
+		return info->state == MONO_TIER_STATE_TIER0 ? info : NULL;
+
+	header = mono_method_get_header (method);
+	if (!header)
+		return NULL;
+	/*
+	 * Methods with loops can be hot even if they are called only once, so compile
+	 * them normally unless their tier 0 code can continue in OSR code.
+	 */
+	has_loops = method_has_loops (header, &osr_headers);
+	if (osr_headers && !can_osr (method, header)) {
+		g_slist_free (osr_headers);
+		osr_headers = NULL;
+	}
+	mono_metadata_free_mh (header);
+	if (has_loops && !osr_headers)
+		return NULL;
+
+	mono_tiered_lock ();
+	info = g_hash_table_lookup (tier_infos, method);
+	if (!info) {
+		info = g_new0 (MonoTierInfo, 1);
+		info->method = method;
+		info->domain = domain;
+		info->opts = opts;
+		info->call_count = tier_up_threshold;
+		info->state = MONO_TIER_STATE_TIER0;
+		for (l = osr_headers; l; l = l->next) {
+			MonoOsrSite *site = g_new0 (MonoOsrSite, 1);
+
+			site->info = info;
+			site->il_offset = GPOINTER_TO_UINT (l->data);
+			site->count = osr_threshold;
+			site->state = MONO_TIER_STATE_TIER0;
+			site->next = info->osr_sites;
+			info->osr_sites = site;
+		}
+		g_hash_table_insert (tier_infos, method, info);
+		mono_jit_stats.methods_tier0++;
+	}
+	mono_tiered_unlock ();
+
+	g_slist_free (osr_headers);
+
+	return info->state == MONO_TIER_STATE_TIER0 ? info : NULL;
+}
+
+/*
+ * mini_tiered_get_receiver_profile:
+ *
+ *   Return the profile of the virtual call site at IL_OFFSET in the tier 0 code of
+ * INFO->method, creating it if needed.
+ */
+MonoReceiverProfile*
+mini_tiered_get_receiver_profile (MonoTierInfo *info, guint32 il_offset)
+{
+	MonoReceiverProfile *prof;
+
+	mono_tiered_lock ();
+	for (prof = info->receivers; prof; prof = prof->next) {
+		if (prof->il_offset == il_offset)
+			break;
+	}
+	if (!prof) {
+		prof = g_new0 (MonoReceiverProfile, 1);
+		prof->il_offset = il_offset;
+		prof->next = info->receivers;
+		info->receivers = prof;
+	}
+	mono_tiered_unlock ();
+
+	return prof;
+}
+
+/*
+ * mini_tiered_get_monomorphic_receiver:
+ *
+ *   Return the vtable of the receivers seen by the tier 0 code of METHOD at the
+ * virtual call site at IL_OFFSET, if they all had the same vtable, NULL otherwise.
+ */
+MonoVTable*
+mini_tiered_get_monomorphic_receiver (MonoMethod *method, MonoDomain *domain, guint32 il_offset)
+{
+	MonoTierInfo *info;
+	MonoReceiverProfile *prof;
+	MonoVTable *vtable = NULL;
+
+	if (!mono_tiered_compilation)
+		return NULL;
+
+	mono_tiered_lock ();
+	info = g_hash_table_lookup (tier_infos, method);
+	if (info && info->domain == domain) {
+		for (prof = info->receivers; prof; prof = prof->next) {
+			if (prof->il_offset == il_offset) {
+				if (!prof->polymorphic)
+					vtable = prof->vtable;
+				break;
+			}
+		}
+	}
+	mono_tiered_unlock ();
+
+	return vtable;
+}
+
+/*
+ * mini_tiered_get_osr_site:
+ *
+ *   Return the MonoOsrSite for the loop header at IL_OFFSET in the tier 0 code of
+ * INFO->method, or NULL if OSR is not possible there.
+ */
+MonoOsrSite*
+mini_tiered_get_osr_site (MonoTierInfo *info, guint32 il_offset)
+{
+	MonoOsrSite *site;
+
+	for (site = info->osr_sites; site; site = site->next) {
+		if (site->il_offset == il_offset)
+			return site;
+	}
+	return NULL;
+}
+
+/* Called with the tiered lock held */
+static void
+add_compile_stats (MonoCompile *cfg)
+{
+	mono_jit_stats.allocations_removed += cfg->stat_allocations_removed;
+	mono_jit_stats.bounds_checks_removed += cfg->stat_bounds_checks_removed;
+	mono_jit_stats.loops_vectorized += cfg->stat_loops_vectorized;
+	mono_jit_stats.cold_bblocks += cfg->stat_cold_bblocks;
+	mono_jit_stats.wbarriers_removed += cfg->stat_wbarriers_removed;
+}
+
+/*
+ * tier_up:
+ *
+ *   Recompile the method described by INFO using all optimizations, and redirect
+ * its tier 0 code to the new code.
+ */
+static void
+tier_up (MonoTierInfo *info)
+{
+	MonoDomain *domain = info->domain;
+	MonoMethod *method = info->method;
+	MonoCompile *cfg;
+	MonoJitInfo *tier0_ji;
+	GTimer *timer;
+	gboolean patched = FALSE;
+
+	timer = g_timer_new ();
+	/* This runs on the tier up thread, so leave the cctors to the generated code */
+	cfg = mini_method_compile_full (method, info->opts | MONO_TIER1_OPTS, domain, TRUE, FALSE, 0, NULL, TRUE);
+	g_timer_stop (timer);
+
+	if (cfg->exception_type == MONO_EXCEPTION_NONE) {
+		mono_domain_jit_code_hash_lock (domain);
+
+		tier0_ji = mono_internal_hash_table_lookup (&domain->jit_code_hash, method);
+		if (tier0_ji && mono_arch_patch_tier0_entry (tier0_ji, cfg->native_code)) {
+			/* Later lookups of the method should return the tier 1 code */
+			mono_internal_hash_table_remove (&domain->jit_code_hash, method);
+			mono_internal_hash_table_insert (&domain->jit_code_hash, method, cfg->jit_info);
+			patched = TRUE;
+		}
+
+		mono_domain_jit_code_hash_unlock (domain);
+	} else if (cfg->exception_type == MONO_EXCEPTION_OBJECT_SUPPLIED) {
+		MONO_GC_UNREGISTER_ROOT (cfg->exception_ptr);
+	}
+
+	if (patched) {
+		info->state = MONO_TIER_STATE_DONE;
+		mono_emit_jit_map (cfg->jit_info);
+
+		mono_tiered_lock ();
+		mono_jit_stats.methods_tiered_up++;
+		mono_jit_stats.tier_up_time += g_timer_elapsed (timer, NULL);
+		add_compile_stats (cfg);
+		mono_tiered_unlock ();
+	} else {
+		/* The tier 0 code stays in use */
+		info->state = MONO_TIER_STATE_FAILED;
+		InterlockedIncrement (&mono_jit_stats.tier_up_failures);
+	}
+
+	g_timer_destroy (timer);
+	mono_destroy_compile (cfg);
+}
+
+/*
+ * osr_compile:
+ *
+ *   Compile the OSR code of SITE, which enters the method at the loop header of SITE.
+ */
+static void
+osr_compile (MonoOsrSite *site)
+{
+	MonoTierInfo *info = site->info;
+	MonoCompile *cfg;
+
+	cfg = mini_method_compile_full (info->method, info->opts | MONO_TIER1_OPTS, info->domain, TRUE, FALSE, 0, site, TRUE);
+
+	if (cfg->exception_type == MONO_EXCEPTION_NONE) {
+		mono_emit_jit_map (cfg->jit_info);
+
+		site->code = cfg->native_code;
+		/* The tier 0 code reads the code after seeing the new state */
+		mono_memory_barrier ();
+		site->state = MONO_TIER_STATE_DONE;
+
+		mono_tiered_lock ();
+		mono_jit_stats.methods_osr_compiled++;
+		add_compile_stats (cfg);
+		mono_tiered_unlock ();
+	} else {
+		if (cfg->exception_type == MONO_EXCEPTION_OBJECT_SUPPLIED)
+			MONO_GC_UNREGISTER_ROOT (cfg->exception_ptr);
+		/* The loop stays in tier 0 code */
+		site->state = MONO_TIER_STATE_FAILED;
+		InterlockedIncrement (&mono_jit_stats.osr_failures);
+	}
+
+	mono_destroy_compile (cfg);
+}
+
+static void
+tier_up_thread (gpointer unused)
+{
+	MonoTierInfo *info;
+	MonoOsrSite *site;
+
+	while (!mono_runtime_is_shutting_down ()) {
+		WaitForSingleObjectEx (tier_up_event, INFINITE, TRUE);
+
+		while (!mono_runtime_is_shutting_down ()) {
+			mono_tiered_lock ();
+			/* The loops of the OSR requests are running right now, so do them first */
+			site = g_queue_pop_head (osr_queue);
+			info = site ? NULL : g_queue_pop_head (tier_up_queue);
+			mono_tiered_unlock ();
+
+			if (site)
+				osr_compile (site);
+			else if (info)
+				tier_up (info);
+			else
+				break;
+		}
+	}
+}
+
+/*
+ * queue_request:
+ *
+ *   Add ITEM to QUEUE, starting the tier up thread if needed.
+ */
+static void
+queue_request (GQueue *queue, gpointer item)
+{
+	gboolean start_thread;
+
+	mono_tiered_lock ();
+	g_queue_push_tail (queue, item);
+	start_thread = !tier_up_thread_started;
+	tier_up_thread_started = TRUE;
+	mono_tiered_unlock ();
+
+	if (start_thread)
+		mono_thread_create_internal (mono_get_root_domain (), tier_up_thread, NULL, TRUE, 0);
+
+	SetEvent (tier_up_event);
+}
+
+/*
+ * mono_tier_up_request:
+ *
+ *   Called by tier 0 code when its call counter reaches zero. Queue the method for
+ * recompilation.
+ */
+void
+mono_tier_up_request (MonoTierInfo *info)
+{
+	if (InterlockedCompareExchange (&info->state, MONO_TIER_STATE_QUEUED, MONO_TIER_STATE_TIER0) != MONO_TIER_STATE_TIER0)
+		return;
+
+	queue_request (tier_up_queue, info);
+}
+
+/*
+ * mono_tier_osr_request:
+ *
+ *   Called by tier 0 code when the iteration counter of the loop at SITE reaches zero.
+ * Return the OSR code of the loop if it is ready. Otherwise queue its compilation if
+ * needed, and return NULL, so the tier 0 code continues the loop.
+ */
+gpointer
+mono_tier_osr_request (MonoOsrSite *site)
+{
+	switch (site->state) {
+	case MONO_TIER_STATE_DONE:
+		mono_memory_read_barrier ();
+		InterlockedIncrement (&mono_jit_stats.osr_entries);
+		return site->code;
+	case MONO_TIER_STATE_FAILED:
+		site->count = G_MAXINT32;
+		return NULL;
+	default:
+		break;
+	}
+
+	site->count = osr_threshold;
+	if (InterlockedCompareExchange (&site->state, MONO_TIER_STATE_QUEUED, MONO_TIER_STATE_TIER0) == MONO_TIER_STATE_TIER0)
+		queue_request (osr_queue, site);
+	return NULL;
+}
+
+/*
+ * mono_tier_osr_locals:
+ *
+ *   Return the per thread buffer used by tier 0 code to pass its locals to OSR code,
+ * making sure it is at least SIZE bytes long. The GC scans it conservatively, since
+ * it holds object references between the two.
+ */
+gpointer
+mono_tier_osr_locals (int size)
+{
+	MonoJitTlsData *jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
+
+	if (size > jit_tls->osr_locals_size) {
+		if (jit_tls->osr_locals)
+			mono_gc_free_fixed (jit_tls->osr_locals);
+		jit_tls->osr_locals = mono_gc_alloc_fixed (size, NULL);
+		jit_tls->osr_locals_size = size;
+	}
+
+	return jit_tls->osr_locals;
+}
+
+#else
+
+void
+mini_tiered_init (void)
+{
+}
+
+MonoTierInfo*
+mini_tiered_get_tier0_info (MonoMethod *method, MonoDomain *domain, guint32 opts)
+{
+	return NULL;
+}
+
+void
+mono_tier_up_request (MonoTierInfo *info)
+{
+	g_assert_not_reached ();
+}
+
+MonoReceiverProfile*
+mini_tiered_get_receiver_profile (MonoTierInfo *info, guint32 il_offset)
+{
+	g_assert_not_reached ();
+	return NULL;
+}
+
+MonoVTable*
+mini_tiered_get_monomorphic_receiver (MonoMethod *method, MonoDomain *domain, guint32 il_offset)
+{
+	return NULL;
+}
+
+MonoOsrSite*
+mini_tiered_get_osr_site (MonoTierInfo *info, guint32 il_offset)
+{
+	return NULL;
+}
+
+gpointer
+mono_tier_osr_request (MonoOsrSite *site)
+{
+	g_assert_not_reached ();
+	return NULL;
+}
+
+gpointer
+mono_tier_osr_locals (int size)
+{
+	g_assert_not_reached ();
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef __MONO_MINI_TIERED_H__
+#define __MONO_MINI_TIERED_H__
+
+#include "mini.h"
+
+/*
+ * The optimizations used for tier 0 code. These are the ones which are either
+ * needed for correctness or don't cost anything.
+ */
+#define MONO_TIER0_OPTS (MONO_OPT_SHARED | MONO_OPT_GSHARED | MONO_OPT_AOT | MONO_OPT_INTRINS | MONO_OPT_PEEPHOLE | MONO_OPT_BRANCH)
+
+/* The optimizations added to the normal ones when recompiling hot methods */
+#define MONO_TIER1_OPTS (MONO_OPT_INLINE | MONO_OPT_SSA | MONO_OPT_ABCREM | MONO_OPT_LOOP | MONO_OPT_LICM | MONO_OPT_ESCAPE)
+
+typedef enum {
+	/* The method runs tier 0 code which counts calls */
+	MONO_TIER_STATE_TIER0,
+	/* The method is waiting to be recompiled */
+	MONO_TIER_STATE_QUEUED,
+	/* Tier 1 code is installed */
+	MONO_TIER_STATE_DONE,
+	/* Recompilation failed, the method stays at tier 0 */
+	MONO_TIER_STATE_FAILED
+} MonoTierState;
+
+/*
+ * The receivers seen by a virtual call site in tier 0 code. Used by the tier 1
+ * compilation to emit a guarded, inlined call to the implementation in the class of
+ * the receiver, when all receivers have the same class.
+ */
+typedef struct MonoReceiverProfile {
+	struct MonoReceiverProfile *next;
+	/* The IL offset of the call instruction */
+	guint32 il_offset;
+	/* The vtable of the first receiver, updated without a lock by tier 0 code */
+	MonoVTable *vtable;
+	/* Set by tier 0 code when it sees a receiver with another vtable */
+	gint32 polymorphic;
+} MonoReceiverProfile;
+
+/*
+ * A loop header in tier 0 code where execution can continue in OSR (on-stack
+ * replacement) code, a version of the method compiled with all optimizations whose
+ * entry point is the loop header. See mono_tier_osr_request ().
+ */
+struct MonoOsrSite {
+	struct MonoOsrSite *next;
+	MonoTierInfo *info;
+	/* The IL offset of the loop header */
+	guint32 il_offset;
+	/*
+	 * Decremented by the tier 0 code on every iteration of the loop, OSR is tried
+	 * when it reaches 0. Updates are not atomic, so this is only approximate.
+	 */
+	gint32 count;
+	/* A MonoTierState */
+	gint32 state;
+	/* The OSR code, valid once state is MONO_TIER_STATE_DONE */
+	gpointer code;
+};
+
+struct MonoTierInfo {
+	MonoMethod *method;
+	MonoDomain *domain;
+	/* The optimizations the method would have been compiled with without tiering */
+	guint32 opts;
+	/*
+	 * Decremented by the prolog of the tier 0 code, the method is queued for
+	 * recompilation when it reaches 0. Updates are not atomic, so this is only
+	 * approximate.
+	 */
+	gint32 call_count;
+	/* A MonoTierState */
+	gint32 state;
+	/* The profiles of the virtual call sites, protected by the tiered lock */
+	MonoReceiverProfile *receivers;
+	/* The loop headers where OSR is possible, immutable */
+	MonoOsrSite *osr_sites;
+};
+
+void mini_tiered_init (void) MONO_INTERNAL;
+
+MonoTierInfo* mini_tiered_get_tier0_info (MonoMethod *method, MonoDomain *domain, guint32 opts) MONO_INTERNAL;
+
+void mono_tier_up_request (MonoTierInfo *info) MONO_INTERNAL;
+
+MonoReceiverProfile* mini_tiered_get_receiver_profile (MonoTierInfo *info, guint32 il_offset) MONO_INTERNAL;
+
+MonoVTable* mini_tiered_get_monomorphic_receiver (MonoMethod *method, MonoDomain *domain, guint32 il_offset) MONO_INTERNAL;
+
+MonoOsrSite* mini_tiered_get_osr_site (MonoTierInfo *info, guint32 il_offset) MONO_INTERNAL;
+
+gpointer mono_tier_osr_request (MonoOsrSite *site) MONO_INTERNAL;
+
+gpointer mono_tier_osr_locals (int size) MONO_INTERNAL;
+
+#endif
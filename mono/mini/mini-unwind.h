@@ -107,6 +107,11 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 				   mgreg_t **save_locations, int save_locations_len,
 				   guint8 **out_cfa) MONO_INTERNAL;
 
+void
+mono_unwind_frame_cached (guint32 index, guint8 *start_ip, guint8 *end_ip, guint8 *ip, mgreg_t *regs, int nregs,
+						  mgreg_t **save_locations, int save_locations_len,
+						  guint8 **out_cfa) MONO_INTERNAL;
+
 void mono_unwind_init (void) MONO_INTERNAL;
 
 void mono_unwind_cleanup (void) MONO_INTERNAL;
@@ -233,6 +233,7 @@ typedef struct {
 #define MONO_ARCH_HAVE_GET_TRAMPOLINES 1
 
 #define MONO_ARCH_HAVE_CMOV_OPS 1
+#define MONO_ARCH_HAVE_INLINE_CACHES 1
 
 #ifdef MONO_ARCH_SIMD_INTRINSICS
 #define MONO_ARCH_HAVE_DECOMPOSE_OPTS 1
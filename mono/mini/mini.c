@@ -69,6 +69,7 @@
 
 #include "debug-mini.h"
 #include "mini-gc.h"
+#include "mini-tiered.h"
 #include "debugger-agent.h"
 
 static gpointer mono_jit_compile_method_with_opt (MonoMethod *method, guint32 opt, MonoException **ex);
@@ -113,6 +114,7 @@ static int mini_verbose = 0;
  * it can load AOT code compiled by LLVM.
  */
 gboolean mono_use_llvm = FALSE;
+gboolean mono_tiered_compilation = FALSE;
 
 #define mono_jit_lock() EnterCriticalSection (&jit_mutex)
 #define mono_jit_unlock() LeaveCriticalSection (&jit_mutex)
@@ -441,6 +443,10 @@ void *mono_global_codeman_reserve (int size)
 		return mono_code_manager_reserve (global_codeman, size);
 	}
 	else {
+		ptr = mono_code_manager_try_reserve (global_codeman, size);
+		if (ptr)
+			return ptr;
+
 		mono_jit_lock ();
 		ptr = mono_code_manager_reserve (global_codeman, size);
 		mono_jit_unlock ();
@@ -1556,6 +1562,9 @@ mono_compile_is_broken (MonoCompile *cfg, MonoMethod *method, gboolean fail_comp
 	return !dont_verify && mini_method_verify (cfg, method_definition, fail_compile);
 }
 
+/* Maps MonoJitICallInfo -> wrapper method, protected by the lock of the root domain */
+static GHashTable *icall_wrapper_methods;
+
 static gconstpointer
 mono_icall_get_wrapper_full (MonoJitICallInfo* callinfo, gboolean do_compile)
 {
@@ -1571,34 +1580,38 @@ mono_icall_get_wrapper_full (MonoJitICallInfo* callinfo, gboolean do_compile)
 	if (callinfo->trampoline)
 		return callinfo->trampoline;
 
-	/* 
-	 * We use the lock on the root domain instead of the JIT lock to protect 
-	 * callinfo->trampoline, since we do a lot of stuff inside the critical section.
+	/*
+	 * The wrapper is created under the lock, so every thread gets the same method.
+	 * It is compiled without holding any locks, concurrent compilations of the same
+	 * method are shared, see jit_compilation_begin ().
 	 */
-	mono_loader_lock (); /*FIXME mono_compile_method requires the loader lock, by large.*/
+	mono_loader_lock (); /* mono_mb_create_method () takes it */
 	mono_domain_lock (domain);
-
-	if (callinfo->trampoline) {
-		mono_domain_unlock (domain);
-		mono_loader_unlock ();
-		return callinfo->trampoline;
+	if (!icall_wrapper_methods)
+		icall_wrapper_methods = g_hash_table_new (NULL, NULL);
+	wrapper = g_hash_table_lookup (icall_wrapper_methods, callinfo);
+	if (!wrapper) {
+		name = g_strdup_printf ("__icall_wrapper_%s", callinfo->name);
+		wrapper = mono_marshal_get_icall_wrapper (callinfo->sig, name, callinfo->func, check_for_pending_exc);
+		g_free (name);
+		g_hash_table_insert (icall_wrapper_methods, callinfo, wrapper);
 	}
-
-	name = g_strdup_printf ("__icall_wrapper_%s", callinfo->name);
-	wrapper = mono_marshal_get_icall_wrapper (callinfo->sig, name, callinfo->func, check_for_pending_exc);
-	g_free (name);
+	mono_domain_unlock (domain);
+	mono_loader_unlock ();
 
 	if (do_compile)
 		trampoline = mono_compile_method (wrapper);
 	else
 		trampoline = mono_create_ftnptr (domain, mono_create_jit_trampoline_in_domain (domain, wrapper));
-	mono_register_jit_icall_wrapper (callinfo, trampoline);
-
-	callinfo->trampoline = trampoline;
 
+	/* We use the lock on the root domain instead of the JIT lock to protect callinfo->trampoline */
+	mono_domain_lock (domain);
+	if (!callinfo->trampoline) {
+		mono_register_jit_icall_wrapper (callinfo, trampoline);
+		callinfo->trampoline = trampoline;
+	}
 	mono_domain_unlock (domain);
-	mono_loader_unlock ();
-	
+
 	return callinfo->trampoline;
 }
 
@@ -2675,6 +2688,8 @@ free_jit_tls_data (MonoJitTlsData *jit_tls)
 	mono_free_altstack (jit_tls);
 
 	g_free (jit_tls->first_lmf);
+	if (jit_tls->osr_locals)
+		mono_gc_free_fixed (jit_tls->osr_locals);
 	g_free (jit_tls);
 }
 
@@ -3798,7 +3813,7 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 	MonoJitInfo *jinfo;
 	int num_clauses;
 	int generic_info_size;
-	int holes_size = 0, num_holes = 0;
+	int holes_size = 0, num_holes = 0, osr_calls_size = 0, num_osr_calls = 0;
 
 	g_assert (method_to_compile == cfg->method);
 	header = cfg->header;
@@ -3826,6 +3841,16 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 			printf ("Number of try block holes %d\n", num_holes);
 	}
 
+	for (tmp = cfg->osr_calls; tmp; tmp = tmp->next) {
+		MonoInst *call = tmp->data;
+
+		/* backend.pc_offset is only valid if the backend set this flag */
+		if (call->flags & MONO_INST_GC_CALLSITE)
+			++num_osr_calls;
+	}
+	if (num_osr_calls)
+		osr_calls_size = sizeof (MonoOsrCallTableJitInfo) + num_osr_calls * sizeof (guint32);
+
 	if (COMPILE_LLVM (cfg))
 		num_clauses = cfg->llvm_ex_info_len;
 	else
@@ -3833,11 +3858,11 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 
 	if (cfg->method->dynamic) {
 		jinfo = g_malloc0 (MONO_SIZEOF_JIT_INFO + (num_clauses * sizeof (MonoJitExceptionInfo)) +
-				generic_info_size + holes_size);
+				generic_info_size + holes_size + osr_calls_size);
 	} else {
 		jinfo = mono_domain_alloc0 (cfg->domain, MONO_SIZEOF_JIT_INFO +
 				(num_clauses * sizeof (MonoJitExceptionInfo)) +
-				generic_info_size + holes_size);
+				generic_info_size + holes_size + osr_calls_size);
 	}
 
 	jinfo->method = cfg->method_to_register;
@@ -3935,6 +3960,22 @@ create_jit_info (MonoCompile *cfg, MonoMethod *method_to_compile)
 		g_assert (i == num_holes);
 	}
 
+	if (num_osr_calls) {
+		MonoOsrCallTableJitInfo *table;
+		int i = 0;
+
+		jinfo->has_osr_calls = 1;
+		table = mono_jit_info_get_osr_call_table_info (jinfo);
+		table->num_calls = num_osr_calls;
+		for (tmp = cfg->osr_calls; tmp; tmp = tmp->next) {
+			MonoInst *call = tmp->data;
+
+			if (call->flags & MONO_INST_GC_CALLSITE)
+				table->offsets [i++] = call->backend.pc_offset;
+		}
+		g_assert (i == num_osr_calls);
+	}
+
 	if (COMPILE_LLVM (cfg)) {
 		if (num_clauses)
 			memcpy (&jinfo->clauses [0], &cfg->llvm_ex_info [0], num_clauses * sizeof (MonoJitExceptionInfo));
@@ -4134,6 +4175,21 @@ mini_get_shared_method (MonoMethod *method)
  */
 MonoCompile*
 mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gboolean run_cctors, gboolean compile_aot, int parts)
+{
+	return mini_method_compile_full (method, opts, domain, run_cctors, compile_aot, parts, NULL, FALSE);
+}
+
+/*
+ * mini_method_compile_full:
+ *
+ *   Same as mini_method_compile (), but if @osr_site is not NULL, compile the OSR code
+ * entered at the loop header of @osr_site instead of the normal code of @method.
+ * If @defer_cctors is TRUE, type ctors are not run during the compilation, the
+ * generated code calls them when needed instead. This is used when compiling on a
+ * background thread, since cctors have to run on the thread which triggers them.
+ */
+MonoCompile*
+mini_method_compile_full (MonoMethod *method, guint32 opts, MonoDomain *domain, gboolean run_cctors, gboolean compile_aot, int parts, MonoOsrSite *osr_site, gboolean defer_cctors)
 {
 	MonoMethodHeader *header;
 	MonoMethodSignature *sig;
@@ -4144,6 +4200,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	gboolean deadce_has_run = FALSE;
 	gboolean try_generic_shared, try_llvm = FALSE;
 	MonoMethod *method_to_compile, *method_to_register;
+	MonoTierInfo *tier_info = NULL;
 
 	InterlockedIncrement (&mono_jit_stats.methods_compiled);
 	if (mono_profiler_get_events () & MONO_PROFILE_JIT_COMPILATION)
@@ -4174,6 +4231,19 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	try_llvm = mono_use_llvm;
 #endif
 
+	if (mono_tiered_compilation && run_cctors && !compile_aot && !try_generic_shared && !osr_site)
+		tier_info = mini_tiered_get_tier0_info (method, domain, opts);
+	if (tier_info) {
+		/* Compile quickly, the method is recompiled with opts if it becomes hot */
+		opts &= MONO_TIER0_OPTS;
+		try_llvm = FALSE;
+	}
+	if (osr_site) {
+		/* The tier 0 code calls the OSR code with the signature of the method */
+		g_assert (!try_generic_shared);
+		try_llvm = FALSE;
+	}
+
  restart_compile:
 	if (try_generic_shared) {
 		method_to_compile = mini_get_shared_method (method);
@@ -4189,6 +4259,7 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	cfg->opt = opts;
 	cfg->prof_options = mono_profiler_get_events ();
 	cfg->run_cctors = run_cctors;
+	cfg->defer_cctors = defer_cctors;
 	cfg->domain = domain;
 	cfg->verbose_level = mini_verbose;
 	cfg->compile_aot = compile_aot;
@@ -4200,6 +4271,8 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	if (try_generic_shared)
 		cfg->generic_sharing_context = (MonoGenericSharingContext*)&cfg->generic_sharing_context;
 	cfg->compile_llvm = try_llvm;
+	cfg->tier_info = tier_info;
+	cfg->osr_site = osr_site;
 	cfg->token_info_hash = g_hash_table_new (NULL, NULL);
 
 	if (cfg->gen_seq_points)
@@ -4356,8 +4429,10 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		g_free (method_name);
 	}
 
-	if (cfg->opt & (MONO_OPT_ABCREM | MONO_OPT_SSAPRE))
+	if (cfg->opt & (MONO_OPT_ABCREM | MONO_OPT_SSAPRE | MONO_OPT_ESCAPE))
 		cfg->opt |= MONO_OPT_SSA;
+	if (cfg->opt & MONO_OPT_LICM)
+		cfg->opt |= MONO_OPT_LOOP;
 
 	/* 
 	if ((cfg->method->klass->image != mono_defaults.corlib) || (strstr (cfg->method->klass->name, "StackOverflowException") && strstr (cfg->method->name, ".ctor")) || (strstr (cfg->method->klass->name, "OutOfMemoryException") && strstr (cfg->method->name, ".ctor")))
@@ -4570,6 +4645,30 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	if (cfg->opt & MONO_OPT_LOOP) {
 		mono_compile_dominator_info (cfg, MONO_COMP_DOM | MONO_COMP_IDOM);
 		mono_compute_natural_loops (cfg);
+
+		if ((cfg->opt & MONO_OPT_LICM) && !COMPILE_LLVM (cfg))
+			mono_loop_invariant_code_motion (cfg);
+
+#ifdef MONO_ARCH_SIMD_INTRINSICS
+		if ((cfg->opt & MONO_OPT_SIMD) && !COMPILE_LLVM (cfg) && mono_vectorize_loops (cfg)) {
+			MonoBasicBlock *bb;
+
+			/* Recompute the depth first order and the loop info to include the new bblocks */
+			mono_free_loop_info (cfg);
+			cfg->comp_done &= ~(MONO_COMP_DOM | MONO_COMP_DFRONTIER);
+			for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+				bb->dfn = 0;
+				bb->loop_body_start = 0;
+			}
+			cfg->bblocks = mono_mempool_alloc (cfg->mempool, sizeof (MonoBasicBlock*) * (cfg->max_block_num + 1));
+			dfn = 0;
+			df_visit (cfg->bb_entry, &dfn, cfg->bblocks);
+			cfg->num_bblocks = dfn + 1;
+
+			mono_compile_dominator_info (cfg, MONO_COMP_DOM | MONO_COMP_IDOM);
+			mono_compute_natural_loops (cfg);
+		}
+#endif
 	}
 
 	/* after method_to_ir */
@@ -4641,6 +4740,9 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 		if ((cfg->flags & (MONO_CFG_HAS_LDELEMA|MONO_CFG_HAS_CHECK_THIS)) && (cfg->opt & MONO_OPT_ABCREM))
 			mono_perform_abc_removal (cfg);
 
+		if (cfg->opt & MONO_OPT_ESCAPE)
+			mono_ssa_escape_analysis (cfg);
+
 		mono_ssa_remove (cfg);
 		mono_local_cprop (cfg);
 		mono_handle_global_vregs (cfg);
@@ -4784,6 +4886,9 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 			}
 		}
 
+		if ((cfg->opt & MONO_OPT_BRANCH) && !cfg->disable_out_of_line_bblocks && !cfg->globalra && !COMPILE_LLVM (cfg))
+			mono_layout_cold_bblocks (cfg);
+
 		/* Add branches between non-consecutive bblocks */
 		for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
 			if (bb->last_ins && MONO_IS_COND_BRANCH_OP (bb->last_ins) &&
@@ -4932,17 +5037,32 @@ mini_method_compile (MonoMethod *method, guint32 opts, MonoDomain *domain, gbool
 	return NULL;
 }
 
+MonoCompile*
+mini_method_compile_full (MonoMethod *method, guint32 opts, MonoDomain *domain, gboolean run_cctors, gboolean compile_aot, int parts, MonoOsrSite *osr_site, gboolean defer_cctors)
+{
+	g_assert_not_reached ();
+	return NULL;
+}
+
 #endif /* DISABLE_JIT */
 
+/*
+ * mono_domain_lookup_shared_generic:
+ *
+ *   Return the shared generic code registered for SHARED_METHOD, which is the result
+ * of mini_get_shared_method () on the method being looked up.
+ *
+ * LOCKING: Assumes domain->jit_code_hash_lock is held.
+ */
 MonoJitInfo*
-mono_domain_lookup_shared_generic (MonoDomain *domain, MonoMethod *method)
+mono_domain_lookup_shared_generic (MonoDomain *domain, MonoMethod *shared_method)
 {
 	static gboolean inited = FALSE;
 	static int lookups = 0;
 	static int failed_lookups = 0;
 	MonoJitInfo *ji;
 
-	ji = mono_internal_hash_table_lookup (&domain->jit_code_hash, mini_get_shared_method (method));
+	ji = mono_internal_hash_table_lookup (&domain->jit_code_hash, shared_method);
 	if (ji && !ji->has_generic_jit_info)
 		ji = NULL;
 
@@ -4959,36 +5079,374 @@ mono_domain_lookup_shared_generic (MonoDomain *domain, MonoMethod *method)
 	return ji;
 }
 
+/*
+ * lookup_method_shared_method:
+ *
+ *   Return the method whose shared generic code can be used for METHOD, or NULL.
+ * This can inflate methods, so it has to be called before taking the jit_code_hash
+ * lock, since that lock nests inside the loader lock.
+ */
+static MonoMethod*
+lookup_method_shared_method (MonoMethod *method)
+{
+	if (!mono_method_is_generic_sharable_impl (method, FALSE))
+		return NULL;
+	return mini_get_shared_method (method);
+}
+
 /*
  * LOCKING: Assumes domain->jit_code_hash_lock is held.
  */
 static MonoJitInfo*
-lookup_method_inner (MonoDomain *domain, MonoMethod *method)
+lookup_method_inner (MonoDomain *domain, MonoMethod *method, MonoMethod *shared_method)
 {
 	MonoJitInfo *ji = mono_internal_hash_table_lookup (&domain->jit_code_hash, method);
 
 	if (ji)
 		return ji;
 
-	if (!mono_method_is_generic_sharable_impl (method, FALSE))
+	if (!shared_method)
 		return NULL;
-	return mono_domain_lookup_shared_generic (domain, method);
+	return mono_domain_lookup_shared_generic (domain, shared_method);
 }
 
 static MonoJitInfo*
 lookup_method (MonoDomain *domain, MonoMethod *method)
 {
+	MonoMethod *shared_method = lookup_method_shared_method (method);
 	MonoJitInfo *info;
 
-	mono_loader_lock (); /*FIXME lookup_method_inner acquired it*/
 	mono_domain_jit_code_hash_lock (domain);
-	info = lookup_method_inner (domain, method);
+	info = lookup_method_inner (domain, method, shared_method);
 	mono_domain_jit_code_hash_unlock (domain);
-	mono_loader_unlock ();
 
 	return info;
 }
 
+/*
+ * A method being compiled. Threads requesting a method which is being compiled by
+ * another thread wait for that compilation to finish instead of compiling the method
+ * again.
+ */
+typedef struct {
+	MonoMethod *method;
+	MonoDomain *domain;
+	/* The number of threads waiting for this compilation */
+	int waiters;
+	/* Created by the first waiter, set when the compilation is done */
+	HANDLE done_event;
+	gboolean done;
+	/* Set when a waiter timed out, later requests don't wait */
+	gboolean abandoned;
+} JitCompilation;
+
+/* The JitCompilation's in progress, protected by jit_mutex */
+static GPtrArray *jit_compilations;
+
+/*
+ * The maximum time in msecs a thread waits for another thread compiling the same
+ * method. The compiling thread might be blocked on something held by the waiting
+ * thread, like a type initialization lock, so the wait can't be infinite.
+ */
+#define JIT_COMPILATION_WAIT_TIMEOUT 500
+
+static JitCompilation*
+find_jit_compilation (MonoMethod *method, MonoDomain *domain)
+{
+	int i;
+
+	for (i = 0; i < jit_compilations->len; ++i) {
+		JitCompilation *comp = g_ptr_array_index (jit_compilations, i);
+
+		if (comp->method == method && comp->domain == domain)
+			return comp;
+	}
+	return NULL;
+}
+
+static void
+jit_compilation_free (JitCompilation *comp)
+{
+	if (comp->done_event)
+		CloseHandle (comp->done_event);
+	g_free (comp);
+}
+
+/*
+ * jit_compilation_begin:
+ *
+ *   Register that the current thread is going to compile METHOD in DOMAIN. If another
+ * thread is compiling it already, wait for it to finish, unless BACKGROUND is TRUE.
+ * Return NULL if nothing was registered, in which case the caller should look up the
+ * method again before compiling it.
+ * Managed exceptions can't be caught on the way out, so the compilation has to be
+ * ended before calling anything which can raise one, like code running cctors.
+ */
+static JitCompilation*
+jit_compilation_begin (MonoMethod *method, MonoDomain *domain, gboolean background)
+{
+	MonoJitTlsData *jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
+	JitCompilation *comp;
+	HANDLE done_event;
+	guint32 res;
+
+	if (!jit_tls)
+		return NULL;
+
+	mono_jit_lock ();
+	comp = find_jit_compilation (method, domain);
+	if (!comp) {
+		comp = g_new0 (JitCompilation, 1);
+		comp->method = method;
+		comp->domain = domain;
+		g_ptr_array_add (jit_compilations, comp);
+		mono_jit_unlock ();
+
+		jit_tls->jit_compile_depth ++;
+		return comp;
+	}
+
+	/*
+	 * Threads which are already compiling something don't wait, since the other thread
+	 * might be waiting for them.
+	 */
+	if (background || comp->abandoned || jit_tls->jit_compile_depth) {
+		mono_jit_unlock ();
+		return NULL;
+	}
+
+	if (!comp->done_event)
+		comp->done_event = CreateEvent (NULL, TRUE, FALSE, NULL);
+	done_event = comp->done_event;
+	comp->waiters ++;
+	mono_jit_stats.jit_compilation_waits ++;
+	mono_jit_unlock ();
+
+	res = WaitForSingleObjectEx (done_event, JIT_COMPILATION_WAIT_TIMEOUT, FALSE);
+
+	mono_jit_lock ();
+	if (res != WAIT_OBJECT_0 && !comp->done) {
+		comp->abandoned = TRUE;
+		mono_jit_stats.jit_compilation_wait_timeouts ++;
+	}
+	comp->waiters --;
+	if (comp->done && !comp->waiters)
+		jit_compilation_free (comp);
+	mono_jit_unlock ();
+
+	return NULL;
+}
+
+/*
+ * jit_compilation_end:
+ *
+ *   Wake up the threads waiting for the compilation in *COMP_PTR, and clear
+ * *COMP_PTR. Does nothing if it is NULL.
+ */
+static void
+jit_compilation_end (JitCompilation **comp_ptr)
+{
+	JitCompilation *comp = *comp_ptr;
+	MonoJitTlsData *jit_tls;
+	gboolean free_comp;
+
+	if (!comp)
+		return;
+	*comp_ptr = NULL;
+
+	jit_tls = mono_native_tls_get_value (mono_jit_tls_id);
+	jit_tls->jit_compile_depth --;
+
+	mono_jit_lock ();
+	g_ptr_array_remove_fast (jit_compilations, comp);
+	comp->done = TRUE;
+	if (comp->done_event)
+		SetEvent (comp->done_event);
+	free_comp = !comp->waiters;
+	mono_jit_unlock ();
+
+	if (free_comp)
+		jit_compilation_free (comp);
+}
+
+static gpointer mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, int opt, gboolean defer_cctors, JitCompilation **comp, MonoException **jit_ex);
+
+/*
+ * Background JIT compilation: the callees of newly compiled methods are queued and
+ * compiled by MONO_BACKGROUND_JIT_THREADS threads, so they are usually ready by the
+ * time their JIT trampoline is hit.
+ */
+
+/* The number of background JIT threads, 0 disables background compilation */
+static int background_jit_threads;
+/* The methods waiting to be compiled, protected by jit_mutex */
+static GQueue *background_jit_queue;
+/* The methods queued or being compiled in the background, protected by jit_mutex */
+static GHashTable *background_jit_queued;
+static gboolean background_jit_threads_started;
+/* Signalled when something is added to background_jit_queue */
+static HANDLE background_jit_event;
+
+/* The maximum number of callees queued after compiling a method */
+#define BACKGROUND_JIT_MAX_CALLEES 16
+/* The maximum length of background_jit_queue */
+#define BACKGROUND_JIT_MAX_QUEUE 1024
+
+static void
+background_jit_init (void)
+{
+	const char *threads = g_getenv ("MONO_BACKGROUND_JIT_THREADS");
+
+	if (!threads)
+		return;
+	background_jit_threads = atoi (threads);
+	if (background_jit_threads <= 0) {
+		background_jit_threads = 0;
+		return;
+	}
+
+	background_jit_queue = g_queue_new ();
+	background_jit_queued = g_hash_table_new (NULL, NULL);
+	background_jit_event = CreateEvent (NULL, FALSE, FALSE, NULL);
+	g_assert (background_jit_event);
+}
+
+/*
+ * background_jit_collect_callees:
+ *
+ *   Return the methods called directly by the code of CFG which can be compiled in
+ * the background.
+ */
+static GSList*
+background_jit_collect_callees (MonoCompile *cfg)
+{
+	MonoJumpInfo *patch_info;
+	GSList *callees = NULL;
+	int ncallees = 0;
+
+	if (!background_jit_threads || cfg->domain != mono_get_root_domain () || (cfg->opt & MONO_OPT_SHARED))
+		return NULL;
+
+	for (patch_info = cfg->patch_info; patch_info && ncallees < BACKGROUND_JIT_MAX_CALLEES; patch_info = patch_info->next) {
+		MonoMethod *callee;
+
+		if (patch_info->type != MONO_PATCH_INFO_METHOD)
+			continue;
+		callee = patch_info->data.method;
+		if (callee == cfg->method || callee->wrapper_type != MONO_WRAPPER_NONE || callee->dynamic)
+			continue;
+		if ((callee->iflags & (METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL | METHOD_IMPL_ATTRIBUTE_RUNTIME)) ||
+			(callee->flags & (METHOD_ATTRIBUTE_PINVOKE_IMPL | METHOD_ATTRIBUTE_ABSTRACT)))
+			continue;
+		if (callee->is_generic || callee->klass->generic_container)
+			continue;
+		if (lookup_method (cfg->domain, callee))
+			continue;
+
+		callees = g_slist_prepend (callees, callee);
+		ncallees ++;
+	}
+
+	return callees;
+}
+
+static void
+background_jit_compile (MonoDomain *domain, MonoMethod *method)
+{
+	JitCompilation *comp;
+	MonoVTable *vtable;
+	MonoException *ex = NULL;
+
+	if (lookup_method (domain, method))
+		return;
+
+	/*
+	 * Code in the JIT tables is assumed to belong to an initialized class, see
+	 * mono_create_jump_trampoline (), and the class constructor can't run on this thread.
+	 * For the same reason, the cctors of the classes used by the method are left to the
+	 * generated code.
+	 */
+	vtable = mono_class_vtable (domain, method->klass);
+	if (!vtable || !vtable->initialized)
+		return;
+
+	comp = jit_compilation_begin (method, domain, TRUE);
+	if (!comp)
+		/* Being compiled by another thread */
+		return;
+
+	if (!lookup_method (domain, method) && mono_jit_compile_method_inner (method, domain, default_opt, TRUE, &comp, &ex))
+		InterlockedIncrement (&mono_jit_stats.methods_compiled_in_background);
+
+	jit_compilation_end (&comp);
+}
+
+static void
+background_jit_thread (gpointer unused)
+{
+	MonoDomain *domain = mono_get_root_domain ();
+	MonoMethod *method;
+
+	while (!mono_runtime_is_shutting_down ()) {
+		WaitForSingleObjectEx (background_jit_event, INFINITE, TRUE);
+
+		while (!mono_runtime_is_shutting_down ()) {
+			mono_jit_lock ();
+			method = g_queue_pop_head (background_jit_queue);
+			mono_jit_unlock ();
+
+			if (!method)
+				break;
+			background_jit_compile (domain, method);
+
+			mono_jit_lock ();
+			g_hash_table_remove (background_jit_queued, method);
+			mono_jit_unlock ();
+		}
+	}
+}
+
+/*
+ * background_jit_queue_methods:
+ *
+ *   Queue METHODS for background compilation, and free the list.
+ */
+static void
+background_jit_queue_methods (GSList *methods)
+{
+	GSList *l;
+	gboolean start_threads;
+	int i, nqueued = 0;
+
+	if (!methods)
+		return;
+
+	mono_jit_lock ();
+	for (l = methods; l; l = l->next) {
+		if (background_jit_queue->length >= BACKGROUND_JIT_MAX_QUEUE)
+			break;
+		if (g_hash_table_lookup (background_jit_queued, l->data))
+			continue;
+		g_hash_table_insert (background_jit_queued, l->data, l->data);
+		g_queue_push_tail (background_jit_queue, l->data);
+		nqueued ++;
+	}
+	start_threads = nqueued && !background_jit_threads_started;
+	if (start_threads)
+		background_jit_threads_started = TRUE;
+	mono_jit_unlock ();
+
+	g_slist_free (methods);
+
+	if (start_threads) {
+		for (i = 0; i < background_jit_threads; ++i)
+			mono_thread_create_internal (mono_get_root_domain (), background_jit_thread, NULL, TRUE, 0);
+	}
+
+	for (i = 0; i < MIN (nqueued, background_jit_threads); ++i)
+		SetEvent (background_jit_event);
+}
+
 #if ENABLE_JIT_MAP
 static FILE* perf_map_file = NULL;
 
@@ -5028,8 +5486,15 @@ mono_jit_map_is_enabled (void)
 
 #endif
 
+/*
+ * mono_jit_compile_method_inner:
+ *
+ *   Compile METHOD and publish the code in TARGET_DOMAIN. If *COMP is not NULL, the
+ * compilation is ended as soon as the code is published, or before anything which
+ * can throw a managed exception. DEFER_CCTORS is passed to mini_method_compile_full ().
+ */
 static gpointer
-mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, int opt, MonoException **jit_ex)
+mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, int opt, gboolean defer_cctors, JitCompilation **comp, MonoException **jit_ex)
 {
 	MonoCompile *cfg;
 	gpointer code = NULL;
@@ -5038,12 +5503,16 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 	MonoException *ex = NULL;
 	guint32 prof_options;
 	GTimer *jit_timer;
-	MonoMethod *prof_method;
+	MonoMethod *prof_method, *shared_method;
+	GSList *callees;
 
 #ifdef MONO_USE_AOT_COMPILER
 	if (opt & MONO_OPT_AOT) {
 		MonoDomain *domain = mono_domain_get ();
 
+		/* Loading AOT code runs the cctors used by it, which can throw */
+		jit_compilation_end (comp);
+
 		mono_class_init (method->klass);
 
 		if ((code = mono_aot_get_method (domain, method))) {
@@ -5061,6 +5530,9 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 		MonoMethod *nm;
 		MonoMethodPInvoke* piinfo = (MonoMethodPInvoke *) method;
 
+		/* The wrapper is compiled by mono_compile_method (), which throws on failure */
+		jit_compilation_end (comp);
+
 		if (!piinfo->addr) {
 			if (method->iflags & METHOD_IMPL_ATTRIBUTE_INTERNAL_CALL)
 				piinfo->addr = mono_lookup_internal_call (method);
@@ -5089,6 +5561,8 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 		char *full_name, *msg;
 		MonoMethod *nm;
 
+		jit_compilation_end (comp);
+
 		if (method->klass->parent == mono_defaults.multicastdelegate_class) {
 			if (*name == '.' && (strcmp (name, ".ctor") == 0)) {
 				MonoJitICallInfo *mi = mono_find_jit_icall_by_name ("mono_delegate_ctor");
@@ -5141,7 +5615,7 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 
 	jit_timer = g_timer_new ();
 
-	cfg = mini_method_compile (method, opt, target_domain, TRUE, FALSE, 0);
+	cfg = mini_method_compile_full (method, opt, target_domain, TRUE, FALSE, 0, NULL, defer_cctors);
 	prof_method = cfg->method;
 
 	g_timer_stop (jit_timer);
@@ -5230,15 +5704,18 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 		return NULL;
 	}
 
-	mono_loader_lock (); /*FIXME lookup_method_inner requires the loader lock*/
-	mono_domain_lock (target_domain);
-
-	/* Check if some other thread already did the job. In this case, we can
-       discard the code this thread generated. */
+	shared_method = lookup_method_shared_method (method);
 
+	/*
+	 * Publish the code. Only the jit_code_hash lock is held, so this doesn't contend
+	 * with other threads compiling or looking up methods.
+	 *
+	 * Check if some other thread already did the job. In this case, we can discard the
+	 * code this thread generated.
+	 */
 	mono_domain_jit_code_hash_lock (target_domain);
 
-	info = lookup_method_inner (target_domain, method);
+	info = lookup_method_inner (target_domain, method, shared_method);
 	if (info) {
 		/* We can't use a domain specific method in another domain */
 		if ((target_domain == mono_domain_get ()) || info->domain_neutral) {
@@ -5266,6 +5743,7 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 	 * Update global stats while holding a lock, instead of doing many
 	 * InterlockedIncrement operations during JITting.
 	 */
+	mono_jit_lock ();
 	mono_jit_stats.allocate_var += cfg->stat_allocate_var;
 	mono_jit_stats.locals_stack_size += cfg->stat_locals_stack_size;
 	mono_jit_stats.basic_blocks += cfg->stat_basic_blocks;
@@ -5276,10 +5754,19 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 	mono_jit_stats.inlined_methods += cfg->stat_inlined_methods;
 	mono_jit_stats.cas_demand_generation += cfg->stat_cas_demand_generation;
 	mono_jit_stats.code_reallocs += cfg->stat_code_reallocs;
+	mono_jit_stats.allocations_removed += cfg->stat_allocations_removed;
+	mono_jit_stats.bounds_checks_removed += cfg->stat_bounds_checks_removed;
+	mono_jit_stats.loops_vectorized += cfg->stat_loops_vectorized;
+	mono_jit_stats.cold_bblocks += cfg->stat_cold_bblocks;
+	mono_jit_stats.wbarriers_removed += cfg->stat_wbarriers_removed;
+	mono_jit_unlock ();
+
+	callees = background_jit_collect_callees (cfg);
 
 	mono_destroy_compile (cfg);
 
 #ifndef DISABLE_JIT
+	mono_domain_lock (target_domain);
 	if (domain_jit_info (target_domain)->jump_target_hash) {
 		MonoJumpInfo patch_info;
 		MonoJumpList *jlist;
@@ -5296,11 +5783,15 @@ mono_jit_compile_method_inner (MonoMethod *method, MonoDomain *target_domain, in
 				mono_arch_patch_code (NULL, target_domain, tmp->data, &patch_info, NULL, TRUE);
 		}
 	}
+	mono_domain_unlock (target_domain);
 
 	mono_emit_jit_map (jinfo);
 #endif
-	mono_domain_unlock (target_domain);
-	mono_loader_unlock ();
+
+	/* Threads waiting for this compilation can use the code now */
+	jit_compilation_end (comp);
+
+	background_jit_queue_methods (callees);
 
 	vtable = mono_class_vtable (target_domain, method->klass);
 	if (!vtable) {
@@ -5339,6 +5830,7 @@ mono_jit_compile_method_with_opt (MonoMethod *method, guint32 opt, MonoException
 	MonoJitInfo *info;
 	gpointer code, p;
 	MonoJitICallInfo *callinfo = NULL;
+	JitCompilation *comp = NULL;
 
 	/*
 	 * ICALL wrappers are handled specially, since there is only one copy of them
@@ -5362,6 +5854,12 @@ mono_jit_compile_method_with_opt (MonoMethod *method, guint32 opt, MonoException
 		target_domain = domain;
 
 	info = lookup_method (target_domain, method);
+	if (!info) {
+		/* Wait for the compilation if another thread is compiling the method already */
+		comp = jit_compilation_begin (method, target_domain, FALSE);
+		if (!comp)
+			info = lookup_method (target_domain, method);
+	}
 	if (info) {
 		/* We can't use a domain specific method in another domain */
 		if (! ((domain != target_domain) && !info->domain_neutral)) {
@@ -5380,7 +5878,8 @@ mono_jit_compile_method_with_opt (MonoMethod *method, guint32 opt, MonoException
 		}
 	}
 
-	code = mono_jit_compile_method_inner (method, target_domain, opt, ex);
+	code = mono_jit_compile_method_inner (method, target_domain, opt, FALSE, &comp, ex);
+	jit_compilation_end (&comp);
 	if (!code)
 		return NULL;
 
@@ -5448,7 +5947,9 @@ mono_jit_free_method (MonoDomain *domain, MonoMethod *method)
 
 	mono_domain_lock (domain);
 	g_hash_table_remove (domain_jit_info (domain)->dynamic_code_hash, method);
+	mono_domain_jit_code_hash_lock (domain);
 	mono_internal_hash_table_remove (&domain->jit_code_hash, method);
+	mono_domain_jit_code_hash_unlock (domain);
 	g_hash_table_remove (domain_jit_info (domain)->jump_trampoline_hash, method);
 	g_hash_table_remove (domain_jit_info (domain)->runtime_invoke_hash, method);
 
@@ -6089,6 +6590,33 @@ register_jit_stats (void)
 	mono_counters_register ("Methods JITted using mono JIT", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_without_llvm);
 	mono_counters_register ("Methods JITted using LLVM", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_with_llvm);	
 	mono_counters_register ("Total time spent JITting (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.jit_time);
+	mono_counters_register ("Methods JITted as tier 0", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_tier0);
+	mono_counters_register ("Methods tiered up", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_tiered_up);
+	mono_counters_register ("Tier up failures", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.tier_up_failures);
+	mono_counters_register ("Methods compiled for OSR", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_osr_compiled);
+	mono_counters_register ("OSR failures", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.osr_failures);
+	mono_counters_register ("OSR entries", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.osr_entries);
+	mono_counters_register ("Time spent tiering up (sec)", MONO_COUNTER_JIT | MONO_COUNTER_DOUBLE, &mono_jit_stats.tier_up_time);
+	mono_counters_register ("Methods JITted in the background", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.methods_compiled_in_background);
+	mono_counters_register ("Waits for JIT compilations", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.jit_compilation_waits);
+	mono_counters_register ("Timed out waits for JIT compilations", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.jit_compilation_wait_timeouts);
+	mono_counters_register ("Inline cached call sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.pic_call_sites);
+	mono_counters_register ("Inline cache hits", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.pic_hits);
+	mono_counters_register ("Inline cache slow calls", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.pic_slow_calls);
+	mono_counters_register ("Inline cache misses", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.pic_misses);
+	mono_counters_register ("Megamorphic inline cached call sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.pic_megamorphic_sites);
+	mono_counters_register ("Guarded devirtualized call sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.guarded_devirt_call_sites);
+	mono_counters_register ("Guarded inlined call sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.guarded_inlined_call_sites);
+	mono_counters_register ("Allocations removed", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.allocations_removed);
+	mono_counters_register ("Bounds checks removed", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.bounds_checks_removed);
+	mono_counters_register ("Loops vectorized", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.loops_vectorized);
+	mono_counters_register ("Cold bblocks moved", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.cold_bblocks);
+	mono_counters_register ("Write barriers removed", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.wbarriers_removed);
+	mono_counters_register ("Direct delegate invoke call sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.direct_delegate_invoke_sites);
+	mono_counters_register ("Cast cache sites", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.cast_cache_sites);
+	mono_counters_register ("Cast cache hits", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.cast_cache_hits);
+	mono_counters_register ("Cast cache misses", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.cast_cache_misses);
+	mono_counters_register ("Class init checks removed", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.class_inits_removed);
 	mono_counters_register ("Basic blocks", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.basic_blocks);
 	mono_counters_register ("Max basic blocks", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.max_basic_blocks);
 	mono_counters_register ("Allocated vars", MONO_COUNTER_JIT | MONO_COUNTER_INT, &mono_jit_stats.allocate_var);
@@ -6206,6 +6734,8 @@ mini_init (const char *filename, const char *runtime_version)
 		default_opt = mono_parse_default_optimizations (NULL);
 
 	InitializeCriticalSection (&jit_mutex);
+	jit_compilations = g_ptr_array_new ();
+	background_jit_init ();
 
 #ifdef MONO_DEBUGGER_SUPPORTED
 	if (mini_debug_running_inside_mdb ())
@@ -6369,6 +6899,8 @@ mini_init (const char *filename, const char *runtime_version)
 	/* This should come after mono_init () too */
 	mini_gc_init ();
 
+	mini_tiered_init ();
+
 	mono_add_internal_call ("System.Diagnostics.StackFrame::get_frame_info", 
 				ves_icall_get_frame_info);
 	mono_add_internal_call ("System.Diagnostics.StackTrace::get_trace", 
@@ -6565,8 +7097,14 @@ mini_init (const char *filename, const char *runtime_version)
 	register_icall (mono_resume_unwind, "mono_resume_unwind", "void", TRUE);
 
 	register_icall (mono_gc_wbarrier_value_copy_bitmap, "mono_gc_wbarrier_value_copy_bitmap", "void ptr ptr int int", FALSE);
+	register_icall (mono_gc_wbarrier_arrayref_copy, "mono_gc_wbarrier_arrayref_copy", "void ptr ptr int", FALSE);
+
+	register_icall (mono_tier_up_request, "mono_tier_up_request", "void ptr", FALSE);
+	register_icall (mono_tier_osr_request, "mono_tier_osr_request", "ptr ptr", FALSE);
+	register_icall (mono_tier_osr_locals, "mono_tier_osr_locals", "ptr int32", FALSE);
 
 	register_icall (mono_object_castclass_with_cache, "mono_object_castclass_with_cache", "object object ptr ptr", FALSE);
+	register_icall (mono_pic_miss, "mono_pic_miss", "void object ptr", FALSE);
 	register_icall (mono_object_isinst_with_cache, "mono_object_isinst_with_cache", "object object ptr ptr", FALSE);
 
 	register_icall (mono_debugger_agent_user_break, "mono_debugger_agent_user_break", "void", FALSE);
@@ -6615,6 +7153,8 @@ print_jit_stats (void)
 				 mono_jit_stats.max_ratio_method);
 		g_print ("Biggest method:         %ld (%s)\n", mono_jit_stats.biggest_method_size,
 				 mono_jit_stats.biggest_method);
+		if (mono_jit_stats.cast_cache_hits + mono_jit_stats.cast_cache_misses)
+			g_print ("Cast cache hit rate:    %.2f%%\n", mono_jit_stats.cast_cache_hits * 100.0 / (mono_jit_stats.cast_cache_hits + mono_jit_stats.cast_cache_misses));
 
 		g_print ("\nCreated object count:   %ld\n", mono_stats.new_object_count);
 		g_print ("Delegates created:      %ld\n", mono_stats.delegate_creations);
@@ -6637,6 +7177,10 @@ print_jit_stats (void)
 		g_print ("Dynamic code allocs:    %ld\n", mono_stats.dynamic_code_alloc_count);
 		g_print ("Dynamic code bytes:     %ld\n", mono_stats.dynamic_code_bytes_count);
 		g_print ("Dynamic code frees:     %ld\n", mono_stats.dynamic_code_frees_count);
+		g_print ("Code arenas:            %ld\n", mono_stats.code_arena_count);
+		g_print ("Code arena bytes:       %ld\n", mono_stats.code_arena_bytes);
+		g_print ("Code arena wasted bytes: %ld\n", mono_stats.code_arena_wasted_bytes);
+		g_print ("Huge page code chunks:  %ld\n", mono_stats.code_huge_page_chunks);
 
 		g_print ("IMT tables size:        %ld\n", mono_stats.imt_tables_size);
 		g_print ("IMT number of tables:   %ld\n", mono_stats.imt_number_of_tables);
@@ -6650,6 +7194,8 @@ print_jit_stats (void)
 		g_print ("JIT info table inserts: %ld\n", mono_stats.jit_info_table_insert_count);
 		g_print ("JIT info table removes: %ld\n", mono_stats.jit_info_table_remove_count);
 		g_print ("JIT info table lookups: %ld\n", mono_stats.jit_info_table_lookup_count);
+		g_print ("JIT info cache hits:    %ld\n", mono_stats.jit_info_table_cache_hit_count);
+		g_print ("JIT info index hits:    %ld\n", mono_stats.jit_info_table_index_hit_count);
 
 		g_print ("Hazardous pointers:     %ld\n", mono_stats.hazardous_pointer_count);
 		g_print ("Minor GC collections:   %ld\n", mono_stats.minor_gc_count);
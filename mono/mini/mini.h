@@ -440,6 +440,8 @@ typedef struct MonoBasicBlock MonoBasicBlock;
 typedef struct MonoLMF MonoLMF;
 typedef struct MonoSpillInfo MonoSpillInfo;
 typedef struct MonoTraceSpec MonoTraceSpec;
+typedef struct MonoTierInfo MonoTierInfo;
+typedef struct MonoOsrSite MonoOsrSite;
 
 extern MonoNativeTlsKey mono_jit_tls_id;
 extern MonoTraceSpec *mono_jit_trace_calls;
@@ -460,6 +462,7 @@ extern gboolean mono_do_x86_stack_align;
 extern const char *mono_build_date;
 extern gboolean mono_do_signal_chaining;
 extern gboolean mono_use_llvm;
+extern gboolean mono_tiered_compilation;
 
 #define INS_INFO(opcode) (&ins_info [((opcode) - OP_START - 1) * 4])
 
@@ -839,6 +842,9 @@ enum {
 #define inst_newa_len   data.op[0].src
 #define inst_newa_class data.op[1].klass
 
+#define inst_newobj_vtable  inst_p0
+#define inst_newobj_for_box inst_c1
+
 #define inst_var    data.op[0].var
 #define inst_vtype  data.op[1].vtype
 /* in branch instructions */
@@ -973,6 +979,13 @@ typedef struct {
 	 */
 	MonoContext orig_ex_ctx;
 	gboolean orig_ex_ctx_set;
+
+	/* The number of methods this thread is compiling, see jit_compilation_begin () */
+	int jit_compile_depth;
+
+	/* Used to pass the locals of tier 0 code to OSR code, see mono_tier_osr_locals () */
+	gpointer osr_locals;
+	int osr_locals_size;
 } MonoJitTlsData;
 
 /*
@@ -1214,6 +1227,7 @@ typedef struct {
 	guint            disable_llvm : 1;
 	guint            enable_extended_bblocks : 1;
 	guint            run_cctors : 1;
+	guint            defer_cctors : 1;
 	guint            need_lmf_area : 1;
 	guint            compile_aot : 1;
 	guint            compile_llvm : 1;
@@ -1361,6 +1375,13 @@ typedef struct {
 	guint8 *gc_map;
 	guint32 gc_map_size;
 
+	/* Set when compiling tier 0 code, see mini-tiered.c */
+	MonoTierInfo *tier_info;
+	/* Set when compiling the OSR code entered at the loop header of this site */
+	MonoOsrSite *osr_site;
+	/* The calls from tier 0 code to OSR code, see emit_osr_check () */
+	GSList *osr_calls;
+
 	/* Stats */
 	int stat_allocate_var;
 	int stat_locals_stack_size;
@@ -1371,6 +1392,11 @@ typedef struct {
 	int stat_inlined_methods;
 	int stat_cas_demand_generation;
 	int stat_code_reallocs;
+	int stat_allocations_removed;
+	int stat_bounds_checks_removed;
+	int stat_loops_vectorized;
+	int stat_cold_bblocks;
+	int stat_wbarriers_removed;
 } MonoCompile;
 
 typedef enum {
@@ -1411,14 +1437,62 @@ typedef struct {
 	gint32 generic_virtual_invocations;
 	int methods_with_llvm;
 	int methods_without_llvm;
+	gint32 methods_tier0;
+	gint32 methods_tiered_up;
+	gint32 tier_up_failures;
+	gint32 methods_osr_compiled;
+	gint32 osr_failures;
+	gint32 osr_entries;
+	gint32 methods_compiled_in_background;
+	gint32 jit_compilation_waits;
+	gint32 jit_compilation_wait_timeouts;
+	gint32 pic_call_sites;
+	gint32 pic_hits;
+	gint32 pic_slow_calls;
+	gint32 pic_misses;
+	gint32 pic_megamorphic_sites;
+	gint32 guarded_devirt_call_sites;
+	gint32 guarded_inlined_call_sites;
+	gint32 allocations_removed;
+	gint32 bounds_checks_removed;
+	gint32 loops_vectorized;
+	gint32 cold_bblocks;
+	gint32 wbarriers_removed;
+	gint32 direct_delegate_invoke_sites;
+	gint32 cast_cache_sites;
+	gint32 cast_cache_hits;
+	gint32 cast_cache_misses;
+	gint32 class_inits_removed;
 	char *max_ratio_method;
 	char *biggest_method;
 	double jit_time;
+	double tier_up_time;
 	gboolean enabled;
 } MonoJitStats;
 
 extern MonoJitStats mono_jit_stats;
 
+/* The number of receiver types a MonoPicCache can hold */
+#define MONO_PIC_SIZE 2
+
+/*
+ * The inline cache of an interface call site, mapping the vtables of its receivers
+ * to the code of their implementation of METHOD. Used on architectures which define
+ * MONO_ARCH_HAVE_INLINE_CACHES, where loads are not reordered with other loads,
+ * since call sites read it without a barrier. See emit_pic_call () and
+ * mono_pic_miss ().
+ */
+typedef struct {
+	/* Set after the corresponding entry of TARGETS, so a matching vtable implies a valid target. Never changed afterwards */
+	MonoVTable *vtables [MONO_PIC_SIZE];
+	gpointer targets [MONO_PIC_SIZE];
+	MonoMethod *method;
+	/* The number of misses since the cache became full */
+	gint32 misses_when_full;
+	/* Set when the call site is megamorphic, misses then no longer call mono_pic_miss () */
+	gint32 megamorphic;
+} MonoPicCache;
+
 /* opcodes: value assigned after all the CIL opcodes */
 #ifdef MINI_OP
 #undef MINI_OP
@@ -1706,6 +1780,7 @@ void      mono_remove_bblock                (MonoCompile *cfg, MonoBasicBlock *b
 void      mono_nullify_basic_block          (MonoBasicBlock *bb) MONO_INTERNAL;
 void      mono_merge_basic_blocks           (MonoCompile *cfg, MonoBasicBlock *bb, MonoBasicBlock *bbn) MONO_INTERNAL;
 void      mono_optimize_branches            (MonoCompile *cfg) MONO_INTERNAL;
+void      mono_layout_cold_bblocks          (MonoCompile *cfg) MONO_INTERNAL;
 
 void      mono_blockset_print               (MonoCompile *cfg, MonoBitSet *set, const char *name, guint idom) MONO_INTERNAL;
 void      mono_print_ins_index              (int i, MonoInst *ins) MONO_INTERNAL;
@@ -1754,6 +1829,7 @@ void      mono_global_regalloc              (MonoCompile *cfg) MONO_INTERNAL;
 void      mono_create_jump_table            (MonoCompile *cfg, MonoInst *label, MonoBasicBlock **bbs, int num_blocks) MONO_INTERNAL;
 int       mono_compile_assembly             (MonoAssembly *ass, guint32 opts, const char *aot_options) MONO_INTERNAL;
 MonoCompile *mini_method_compile            (MonoMethod *method, guint32 opts, MonoDomain *domain, gboolean run_cctors, gboolean compile_aot, int parts) MONO_INTERNAL;
+MonoCompile *mini_method_compile_full       (MonoMethod *method, guint32 opts, MonoDomain *domain, gboolean run_cctors, gboolean compile_aot, int parts, MonoOsrSite *osr_site, gboolean defer_cctors) MONO_INTERNAL;
 void      mono_destroy_compile              (MonoCompile *cfg) MONO_INTERNAL;
 MonoJitICallInfo *mono_find_jit_opcode_emulation (int opcode) MONO_INTERNAL;
 void	  mono_print_ins_index (int i, MonoInst *ins) MONO_INTERNAL;
@@ -1764,6 +1840,7 @@ MonoInst *mono_get_got_var (MonoCompile *cfg) MONO_INTERNAL;
 void      mono_add_seq_point (MonoCompile *cfg, MonoBasicBlock *bb, MonoInst *ins, int native_offset) MONO_INTERNAL;
 MonoInst* mono_emit_jit_icall (MonoCompile *cfg, gconstpointer func, MonoInst **args) MONO_INTERNAL;
 MonoInst* mono_emit_method_call (MonoCompile *cfg, MonoMethod *method, MonoInst **args, MonoInst *this) MONO_INTERNAL;
+MonoInst* mini_emit_alloc_obj (MonoCompile *cfg, MonoVTable *vtable, gboolean for_box) MONO_INTERNAL;
 void      mono_create_helper_signatures (void) MONO_INTERNAL;
 
 gboolean  mini_class_is_system_array (MonoClass *klass) MONO_INTERNAL;
@@ -2063,6 +2140,7 @@ gpointer mono_arch_get_static_rgctx_trampoline  (MonoMethod *m, MonoMethodRuntim
 gpointer  mono_arch_get_llvm_imt_trampoline     (MonoDomain *domain, MonoMethod *method, int vt_offset) MONO_INTERNAL;
 void     mono_arch_patch_callsite               (guint8 *method_start, guint8 *code, guint8 *addr) MONO_INTERNAL;
 void     mono_arch_patch_plt_entry              (guint8 *code, gpointer *got, mgreg_t *regs, guint8 *addr) MONO_INTERNAL;
+gboolean mono_arch_patch_tier0_entry            (MonoJitInfo *ji, guint8 *addr) MONO_INTERNAL;
 void     mono_arch_nullify_class_init_trampoline(guint8 *code, mgreg_t *regs) MONO_INTERNAL;
 void     mono_arch_nullify_plt_entry            (guint8 *code, mgreg_t *regs) MONO_INTERNAL;
 int      mono_arch_get_this_arg_reg             (guint8 *code) MONO_INTERNAL;
@@ -2144,12 +2222,14 @@ void mono_set_cast_details                      (MonoClass *from, MonoClass *to)
 /* Dominator/SSA methods */
 void        mono_compile_dominator_info         (MonoCompile *cfg, int dom_flags) MONO_INTERNAL;
 void        mono_compute_natural_loops          (MonoCompile *cfg) MONO_INTERNAL;
+void        mono_loop_invariant_code_motion     (MonoCompile *cfg) MONO_INTERNAL;
 MonoBitSet* mono_compile_iterated_dfrontier     (MonoCompile *cfg, MonoBitSet *set) MONO_INTERNAL;
 void        mono_ssa_compute                    (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_ssa_remove                     (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_ssa_cprop                      (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_ssa_deadce                     (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_ssa_strength_reduction         (MonoCompile *cfg) MONO_INTERNAL;
+void        mono_ssa_escape_analysis            (MonoCompile *cfg) MONO_INTERNAL;
 void        mono_free_loop_info                 (MonoCompile *cfg) MONO_INTERNAL;
 
 void        mono_ssa_compute2                   (MonoCompile *cfg);
@@ -2357,6 +2437,7 @@ void        mono_simd_simplify_indirection (MonoCompile *cfg) MONO_INTERNAL;
 MonoInst*   mono_emit_simd_intrinsics (MonoCompile *cfg, MonoMethod *cmethod, MonoMethodSignature *fsig, MonoInst **args) MONO_INTERNAL;
 guint32     mono_arch_cpu_enumerate_simd_versions (void) MONO_INTERNAL;
 void        mono_simd_intrinsics_init (void) MONO_INTERNAL;
+gboolean    mono_vectorize_loops (MonoCompile *cfg) MONO_INTERNAL;
 
 #ifdef __linux__
 /* maybe enable also for other systems? */
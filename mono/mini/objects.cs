@@ -1529,5 +1529,134 @@ ncells ) {
 		return regress_679467_inner ();
 	}
 	*/
+
+	interface IShape {
+		long Area (int scale);
+	}
+
+	class Square : IShape {
+		public long Area (int scale) { return scale * scale; }
+	}
+
+	class Rect : IShape {
+		public long Area (int scale) { return scale * 2 * scale; }
+	}
+
+	struct Line : IShape {
+		public long Area (int scale) { return 0; }
+	}
+
+	class Circle : IShape {
+		public long Area (int scale) { return scale * 3 * scale; }
+	}
+
+	[MethodImplAttribute (MethodImplOptions.NoInlining)]
+	static long total_area (IShape[] shapes, int scale) {
+		long res = 0;
+		for (int i = 0; i < shapes.Length; ++i)
+			res += shapes [i].Area (scale);
+		return res;
+	}
+
+	/* The call site in total_area () goes from monomorphic to megamorphic */
+	static int test_0_interface_call_inline_cache () {
+		IShape[] mono = new IShape [] { new Square (), new Square () };
+		IShape[] poly = new IShape [] { new Square (), new Rect () };
+		IShape[] mega = new IShape [] { new Square (), new Rect (), new Line (), new Circle () };
+
+		for (int i = 0; i < 100; ++i) {
+			if (total_area (mono, i) != 2 * i * i)
+				return 1;
+			if (total_area (poly, i) != 3 * i * i)
+				return 2;
+		}
+		for (int i = 0; i < 100; ++i) {
+			if (total_area (mega, i) != 6 * i * i)
+				return 3;
+			if (total_area (mono, i) != 2 * i * i)
+				return 4;
+		}
+		try {
+			total_area (new IShape [] { null }, 1);
+			return 5;
+		} catch (NullReferenceException) {
+		}
+		return 0;
+	}
+
+	class Pair {
+		public byte tag;
+		public int x;
+		public double y;
+		public object o;
+
+		public Pair (int x, double y) {
+			this.tag = (byte)(x + 250);
+			this.x = x;
+			this.y = y;
+		}
+	}
+
+	/* The Pair objects don't escape, so they are replaced by their fields with -O=escape */
+	static int test_0_scalar_replaced_object () {
+		int sum = 0;
+		double dsum = 0;
+
+		for (int i = 0; i < 10; ++i) {
+			Pair p = new Pair (i, i * 0.5);
+
+			if (p.o != null)
+				return 1;
+			p.o = p.x > 5 ? "big" : null;
+			if ((p.o != null) != (i > 5))
+				return 2;
+			if (p.tag != (byte)(i + 250))
+				return 3;
+			sum += p.x;
+			dsum += p.y;
+		}
+		if (sum != 45 || dsum != 22.5)
+			return 4;
+
+		object boxed = sum;
+		if (!boxed.Equals (45) || (int)boxed != 45)
+			return 5;
+		return 0;
+	}
+
+	static int count_enumerables (object[] objs) {
+		int n = 0;
+
+		foreach (object o in objs)
+			if (o is System.Collections.IEnumerable)
+				n ++;
+		return n;
+	}
+
+	static IComparable cast_comparable (object o) {
+		return (IComparable)o;
+	}
+
+	/* Objects with different vtables miss the per call site cast cache */
+	public static int test_0_iface_cast_cache_miss () {
+		object[] objs = new object [] { "A", new int [1], 1, new System.Collections.ArrayList (), null, "B", 2.0 };
+
+		for (int i = 0; i < 3; ++i)
+			if (count_enumerables (objs) != 4)
+				return 1;
+
+		for (int i = 0; i < 3; ++i) {
+			if (cast_comparable ("A") == null || cast_comparable (1) == null || cast_comparable (2.0) == null)
+				return 2;
+			if (cast_comparable (null) != null)
+				return 3;
+			try {
+				cast_comparable (new System.Collections.ArrayList ());
+				return 4;
+			} catch (InvalidCastException) {
+			}
+		}
+		return 0;
+	}
 }
 
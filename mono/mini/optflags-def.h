@@ -20,7 +20,11 @@ OPTFLAG(ABCREM   ,18, "abcrem",     "Array bound checks removal")
 OPTFLAG(SSAPRE   ,19, "ssapre",     "SSA based Partial Redundancy Elimination")
 OPTFLAG(EXCEPTION,20, "exception",  "Optimize exception catch blocks")
 OPTFLAG(SSA      ,21, "ssa",        "Use plain SSA form")
+OPTFLAG(LICM     ,22, "licm",       "Loop invariant code motion")
 OPTFLAG(SSE2     ,23, "sse2",       "SSE2 instructions on x86")
 OPTFLAG(GSHARED  ,24, "gshared",    "Share generics")
-OPTFLAG(SIMD	 ,25, "simd",	    "Simd intrinsics")
+OPTFLAG(SIMD	 ,25, "simd",	    "Simd intrinsics and loop vectorization")
 OPTFLAG(UNSAFE	 ,26, "unsafe",	    "Remove bound checks and perform other dangerous changes")
+OPTFLAG(PIC      ,27, "pic",        "Inline caches for interface calls")
+OPTFLAG(ESCAPE   ,28, "escape",     "Scalar replacement of non escaping objects")
+OPTFLAG(DELEGATE ,29, "delegate",   "Direct calls to delegate targets")
@@ -0,0 +1,215 @@
+using System;
+using System.Diagnostics;
+using System.Reflection;
+using System.Runtime.CompilerServices;
+
+/*
+ * Regression tests for on-stack replacement in tiered compilation.
+ *
+ * Each test needs to be of the form:
+ *
+ * public static int test_<result>_<name> ();
+ *
+ * where <result> is an integer (the value that needs to be returned by
+ * the method to make it pass.
+ * <name> is a user-displayed name used to identify the test.
+ *
+ * The tests only exercise OSR when run with --tiered, ideally with a low
+ * MONO_OSR_THRESHOLD, see the tieredcheck target. The loops run long enough
+ * for the OSR code to be compiled and entered while they are running, so the
+ * locals live at the loop header are transferred from the tier 0 frame.
+ */
+
+struct OsrPoint {
+	public int x;
+	public double y;
+	public object o;
+}
+
+class Tests {
+
+	static int Main () {
+		return TestDriver.RunTests (typeof (Tests));
+	}
+
+	const int N = 1000000;
+
+	public static int test_0_int_locals () {
+		int sum = 0, odd = 0;
+
+		for (int i = 0; i < N; ++i) {
+			sum += i % 100;
+			if ((i & 1) != 0)
+				odd ++;
+		}
+		if (sum != (N / 100) * 4950 || odd != N / 2)
+			return 1;
+		return 0;
+	}
+
+	public static int test_0_long_and_double_locals () {
+		long lsum = 0;
+		double dsum = 0.5;
+		float fsum = 0;
+
+		for (int i = 0; i < N; ++i) {
+			lsum += (long)i << 20;
+			dsum += 0.25;
+			fsum = (float)(i & 3);
+		}
+		if (lsum != ((long)N * (N - 1) / 2) << 20)
+			return 1;
+		if (dsum != 0.5 + N * 0.25)
+			return 2;
+		if (fsum != 3.0f)
+			return 3;
+		return 0;
+	}
+
+	public static int test_0_struct_locals () {
+		OsrPoint p = new OsrPoint ();
+		OsrPoint last = new OsrPoint ();
+
+		p.o = "start";
+		for (int i = 0; i < N; ++i) {
+			last = p;
+			p.x += 2;
+			p.y += 0.5;
+			if (i == N / 2)
+				p.o = "middle";
+		}
+		if (p.x != 2 * N || p.y != 0.5 * N || (string)p.o != "middle")
+			return 1;
+		if (last.x != p.x - 2 || last.y != p.y - 0.5 || last.o != p.o)
+			return 2;
+		return 0;
+	}
+
+	public static int test_0_object_locals () {
+		object o = null;
+		string s = "";
+		int[] arr = new int [16];
+
+		for (int i = 0; i < N; ++i) {
+			arr [i & 15] ++;
+			if ((i % 100000) == 0) {
+				/* The references have to survive a collection while in the OSR buffer */
+				o = new object [] { s, i };
+				s = s + "x";
+				GC.Collect ();
+			}
+		}
+		if (s.Length != 10 || arr [15] != N / 16)
+			return 1;
+		object[] last = (object[])o;
+		if ((string)last [0] != "xxxxxxxxx" || (int)last [1] != 900000)
+			return 2;
+		return 0;
+	}
+
+	static int sum_args (int a, double b, string c) {
+		int sum = 0;
+
+		for (int i = 0; i < N; ++i) {
+			sum += a;
+			a = (a + 1) & 7;
+		}
+		return sum + (int)b + c.Length;
+	}
+
+	public static int test_0_args () {
+		if (sum_args (0, 2.5, "abc") != (N / 8) * 28 + 2 + 3)
+			return 1;
+		return 0;
+	}
+
+	int field;
+
+	int instance_loop (int n) {
+		int sum = 0;
+
+		for (int i = 0; i < n; ++i)
+			sum += field;
+		return sum;
+	}
+
+	public static int test_0_instance_method () {
+		Tests t = new Tests ();
+
+		t.field = 3;
+		if (t.instance_loop (N) != 3 * N)
+			return 1;
+		return 0;
+	}
+
+	public static int test_0_try_in_loop () {
+		int caught = 0, finallys = 0, sum = 0;
+		object o = null;
+
+		for (int i = 0; i < N; ++i) {
+			try {
+				if ((i % 1000) == 0)
+					throw new ArgumentException ();
+				sum += i & 3;
+			} catch (ArgumentException) {
+				caught ++;
+				o = "caught";
+			} finally {
+				finallys ++;
+			}
+		}
+		if (caught != N / 1000 || finallys != N || (string)o != "caught")
+			return 1;
+		/* The multiples of 1000 add nothing */
+		if (sum != (N / 4) * 6)
+			return 2;
+		return 0;
+	}
+
+	public static int test_0_nested_loops () {
+		int sum = 0;
+
+		for (int i = 0; i < 1000; ++i)
+			for (int j = 0; j < 1000; ++j)
+				sum += (i ^ j) & 1;
+		if (sum != 500000)
+			return 1;
+		return 0;
+	}
+
+	[MethodImplAttribute (MethodImplOptions.NoInlining)]
+	static string caller_in_loop () {
+		string caller = null;
+
+		for (int i = 0; i < N; ++i) {
+			if (i == N - 1)
+				caller = new StackFrame (1).GetMethod ().Name;
+		}
+		return caller;
+	}
+
+	[MethodImplAttribute (MethodImplOptions.NoInlining)]
+	static void throw_in_loop () {
+		for (int i = 0; i < N; ++i) {
+			if (i == N - 1)
+				throw new ArgumentException ();
+		}
+	}
+
+	/* The tier 0 frame below the OSR code is not visible */
+	public static int test_0_stack_frames () {
+		if (caller_in_loop () != "test_0_stack_frames")
+			return 1;
+
+		try {
+			throw_in_loop ();
+		} catch (ArgumentException ex) {
+			string trace = ex.StackTrace;
+			int first = trace.IndexOf ("throw_in_loop");
+
+			if (first < 0 || trace.IndexOf ("throw_in_loop", first + 1) >= 0)
+				return 2;
+		}
+		return 0;
+	}
+}
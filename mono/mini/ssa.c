@@ -1313,6 +1313,434 @@ mono_ssa_deadce (MonoCompile *cfg)
 	}
 }
 
+/*
+ * Escape analysis.
+ *
+ *   Objects allocated by OP_NEWOBJ which don't escape the method, i.e. which are
+ * only used as the base address of loads and stores of their fields, are replaced
+ * by one vreg per field. This removes the allocation, the write barriers and the
+ * null checks. Since the method is in SSA form, every use of the object is reached
+ * from the most recent execution of its allocation, so the field vregs can be
+ * initialized to zero at the place of the allocation.
+ */
+
+typedef struct {
+	MonoClassField *field;
+	/* The vreg holding the value of the field, -1 until the field is accessed */
+	int vreg;
+	int load_op, store_op;
+	/* The opcode used to store a value into VREG */
+	int move_op;
+	/* The opcode used to load a constant into VREG */
+	int const_op;
+	gboolean is_ref;
+} ScalarField;
+
+/*
+ * init_scalar_field:
+ *
+ *   Initialize SF for FIELD. Return FALSE if fields of this type can't be scalar
+ * replaced.
+ */
+static gboolean
+init_scalar_field (MonoCompile *cfg, ScalarField *sf, MonoClassField *field)
+{
+	MonoType *type = mono_type_get_underlying_type (field->type);
+
+	sf->field = field;
+	sf->vreg = -1;
+	sf->is_ref = FALSE;
+	sf->move_op = OP_MOVE;
+	sf->const_op = OP_ICONST;
+
+	if (type->byref) {
+		sf->const_op = OP_PCONST;
+	} else if (MONO_TYPE_IS_REFERENCE (type)) {
+		sf->const_op = OP_PCONST;
+		sf->is_ref = TRUE;
+	} else {
+		switch (type->type) {
+		case MONO_TYPE_I1:
+			sf->move_op = OP_ICONV_TO_I1;
+			break;
+		case MONO_TYPE_U1:
+		case MONO_TYPE_BOOLEAN:
+			sf->move_op = OP_ICONV_TO_U1;
+			break;
+		case MONO_TYPE_I2:
+			sf->move_op = OP_ICONV_TO_I2;
+			break;
+		case MONO_TYPE_U2:
+		case MONO_TYPE_CHAR:
+			sf->move_op = OP_ICONV_TO_U2;
+			break;
+		case MONO_TYPE_I4:
+		case MONO_TYPE_U4:
+			break;
+		case MONO_TYPE_I:
+		case MONO_TYPE_U:
+		case MONO_TYPE_PTR:
+		case MONO_TYPE_FNPTR:
+			sf->const_op = OP_PCONST;
+			break;
+#if SIZEOF_REGISTER == 8
+		case MONO_TYPE_I8:
+		case MONO_TYPE_U8:
+			sf->const_op = OP_I8CONST;
+			break;
+#endif
+#if !defined(MONO_ARCH_SOFT_FLOAT)
+		case MONO_TYPE_R8:
+			if (MONO_ARCH_USE_FPSTACK)
+				return FALSE;
+			sf->move_op = OP_FMOVE;
+			sf->const_op = OP_R8CONST;
+			break;
+#endif
+		default:
+			/* R4 needs a precision change on stores, valuetypes are accessed in pieces */
+			return FALSE;
+		}
+	}
+
+	sf->load_op = mono_type_to_load_membase (cfg, field->type);
+	sf->store_op = mono_type_to_store_membase (cfg, field->type);
+	return TRUE;
+}
+
+/*
+ * find_scalar_field:
+ *
+ *   Return the field of KLASS or its parents at OFFSET, initializing FIELDS if
+ * needed. Return NULL if there is no such field, or it can't be scalar replaced.
+ */
+static ScalarField*
+find_scalar_field (MonoCompile *cfg, MonoClass *klass, int offset, GSList **fields)
+{
+	MonoClass *k;
+	MonoClassField *field;
+	ScalarField *sf;
+	GSList *l;
+	gpointer iter;
+
+	for (l = *fields; l; l = l->next) {
+		sf = l->data;
+		if (sf->field->offset == offset)
+			return sf;
+	}
+
+	for (k = klass; k; k = k->parent) {
+		iter = NULL;
+		while ((field = mono_class_get_fields (k, &iter))) {
+			if (field->type->attrs & FIELD_ATTRIBUTE_STATIC)
+				continue;
+			if (field->offset != offset)
+				continue;
+			sf = mono_mempool_alloc0 (cfg->mempool, sizeof (ScalarField));
+			if (!init_scalar_field (cfg, sf, field))
+				return NULL;
+			*fields = g_slist_prepend_mempool (cfg->mempool, *fields, sf);
+			return sf;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * scalar_replace_alloc:
+ *
+ *   Replace the object allocated by ALLOC in BB with vregs holding its fields if it
+ * doesn't escape. DEF_COUNT holds the number of definitions of each vreg below
+ * NUM_VREGS, IMPLICIT_USES the vregs used without appearing in the sregs of an
+ * instruction. ALIASES is a scratch array of NUM_VREGS entries set to -1. Return
+ * whenever the allocation was removed.
+ */
+static gboolean
+scalar_replace_alloc (MonoCompile *cfg, MonoBasicBlock *alloc_bb, MonoInst *alloc, int num_vregs, int *def_count, gboolean *implicit_uses, int *aliases)
+{
+	MonoVTable *vtable = alloc->inst_newobj_vtable;
+	MonoClass *klass = vtable->klass;
+	MonoBasicBlock *bb;
+	MonoClass *k;
+	MonoInst *ins;
+	GSList *alias_list = NULL, *fields = NULL, *l;
+	ScalarField *sf;
+	gboolean changed, escapes = FALSE;
+	int i, num_sregs, sregs [MONO_MAX_SRC_REGS];
+
+#define IS_ALIAS(reg) ((reg) >= 0 && (reg) < num_vregs && aliases [(reg)] != -1)
+
+	if (def_count [alloc->dreg] != 1)
+		return FALSE;
+	/* Fields with explicit offsets can overlap */
+	for (k = klass; k; k = k->parent) {
+		if ((k->flags & TYPE_ATTRIBUTE_LAYOUT_MASK) == TYPE_ATTRIBUTE_EXPLICIT_LAYOUT)
+			return FALSE;
+	}
+
+	aliases [alloc->dreg] = 0;
+	alias_list = g_slist_prepend_mempool (cfg->mempool, alias_list, GINT_TO_POINTER (alloc->dreg));
+
+	/* Collect the vregs holding the object or pointers into it */
+	do {
+		changed = FALSE;
+		for (bb = cfg->bb_entry; bb && !escapes; bb = bb->next_bb) {
+			for (ins = bb->code; ins; ins = ins->next) {
+				MonoInst *var;
+
+				if (!(ins->opcode == OP_MOVE || ins->opcode == OP_PADD_IMM) || !IS_ALIAS (ins->sreg1) || IS_ALIAS (ins->dreg))
+					continue;
+
+				var = get_vreg_to_inst (cfg, ins->dreg);
+				if (ins->dreg < MONO_MAX_IREGS || ins->dreg >= num_vregs || def_count [ins->dreg] != 1 || implicit_uses [ins->dreg] ||
+					(cfg->ret && ins->dreg == cfg->ret->dreg) || (var && (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))) {
+					escapes = TRUE;
+					break;
+				}
+
+				aliases [ins->dreg] = aliases [ins->sreg1] + (ins->opcode == OP_PADD_IMM ? ins->inst_imm : 0);
+				alias_list = g_slist_prepend_mempool (cfg->mempool, alias_list, GINT_TO_POINTER (ins->dreg));
+				changed = TRUE;
+			}
+		}
+	} while (changed && !escapes);
+
+	/* Check that every use of the aliases is a field access or a null check */
+	for (bb = cfg->bb_entry; bb && !escapes; bb = bb->next_bb) {
+		for (ins = bb->code; ins && !escapes; ins = ins->next) {
+			gboolean uses_alias = FALSE;
+
+			if (MONO_IS_PHI (ins)) {
+				for (i = ins->inst_phi_args [0]; i > 0; i--) {
+					if (IS_ALIAS (ins->inst_phi_args [i]))
+						escapes = TRUE;
+				}
+				continue;
+			}
+
+			num_sregs = mono_inst_get_src_registers (ins, sregs);
+			for (i = 0; i < num_sregs; ++i) {
+				if (IS_ALIAS (sregs [i]))
+					uses_alias = TRUE;
+			}
+			if (MONO_IS_STORE_MEMBASE (ins) && IS_ALIAS (ins->dreg))
+				uses_alias = TRUE;
+			if (!uses_alias)
+				continue;
+
+			if ((ins->opcode == OP_MOVE || ins->opcode == OP_PADD_IMM) && IS_ALIAS (ins->dreg)) {
+				/* Removed below */
+			} else if (MONO_IS_LOAD_MEMBASE (ins) && IS_ALIAS (ins->sreg1)) {
+				int offset = aliases [ins->sreg1] + ins->inst_offset;
+
+				if (offset == 0 && ins->opcode == OP_LOAD_MEMBASE)
+					/* Vtable load */
+					continue;
+				sf = find_scalar_field (cfg, klass, offset, &fields);
+				if (!sf || ins->opcode != sf->load_op)
+					escapes = TRUE;
+			} else if (MONO_IS_STORE_MEMBASE (ins) && IS_ALIAS (ins->dreg) && !IS_ALIAS (ins->sreg1)) {
+				sf = find_scalar_field (cfg, klass, aliases [ins->dreg] + ins->inst_offset, &fields);
+				if (!sf || (ins->opcode != sf->store_op && ins->opcode != mono_op_to_op_imm (sf->store_op)))
+					escapes = TRUE;
+			} else if (ins->opcode == OP_CARD_TABLE_WBARRIER && !IS_ALIAS (ins->sreg2)) {
+				/* The barrier of a store into the object */
+			} else if ((ins->opcode == OP_CHECK_THIS || ins->opcode == OP_NOT_NULL) && aliases [ins->sreg1] == 0) {
+			} else if ((ins->opcode == OP_COMPARE_IMM || ins->opcode == OP_ICOMPARE_IMM || ins->opcode == OP_LCOMPARE_IMM) &&
+					   aliases [ins->sreg1] == 0 && ins->inst_imm == 0 && ins->next &&
+					   (ins->next->opcode == OP_COND_EXC_EQ || ins->next->opcode == OP_COND_EXC_IEQ)) {
+				/* Explicit null check */
+			} else {
+				escapes = TRUE;
+			}
+		}
+	}
+
+	if (escapes) {
+		for (l = alias_list; l; l = l->next)
+			aliases [GPOINTER_TO_INT (l->data)] = -1;
+		return FALSE;
+	}
+
+	if (cfg->verbose_level > 2)
+		printf ("SCALAR REPLACED: %s.%s allocated in BB%d\n", klass->name_space, klass->name, alloc_bb->block_num);
+
+	/* Allocate the vregs and initialize them where the object was allocated */
+	for (l = fields; l; l = l->next) {
+		static double r8_0 = 0.0;
+		MonoInst *zero;
+
+		sf = l->data;
+		if (sf->is_ref)
+			sf->vreg = mono_alloc_ireg_ref (cfg);
+		else if (sf->move_op == OP_FMOVE)
+			sf->vreg = mono_alloc_freg (cfg);
+		else
+			sf->vreg = mono_alloc_ireg (cfg);
+
+		MONO_INST_NEW (cfg, zero, sf->const_op);
+		zero->dreg = sf->vreg;
+		if (sf->const_op == OP_R8CONST)
+			zero->inst_p0 = &r8_0;
+		else if (sf->const_op == OP_I8CONST)
+			zero->inst_l = 0;
+		else if (sf->const_op == OP_PCONST)
+			zero->inst_p0 = NULL;
+		else
+			zero->inst_c0 = 0;
+		mono_bblock_insert_after_ins (alloc_bb, alloc, zero);
+	}
+	NULLIFY_INS (alloc);
+
+	/* Rewrite the uses */
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		for (ins = bb->code; ins; ins = ins->next) {
+			if ((ins->opcode == OP_MOVE || ins->opcode == OP_PADD_IMM) && IS_ALIAS (ins->dreg)) {
+				NULLIFY_INS (ins);
+			} else if (MONO_IS_LOAD_MEMBASE (ins) && IS_ALIAS (ins->sreg1)) {
+				int offset = aliases [ins->sreg1] + ins->inst_offset;
+
+				if (offset == 0 && ins->opcode == OP_LOAD_MEMBASE) {
+					ins->opcode = OP_PCONST;
+					ins->inst_p0 = vtable;
+					ins->sreg1 = -1;
+				} else {
+					sf = find_scalar_field (cfg, klass, offset, &fields);
+					ins->opcode = sf->move_op == OP_FMOVE ? OP_FMOVE : OP_MOVE;
+					ins->sreg1 = sf->vreg;
+				}
+				ins->flags &= ~MONO_INST_FAULT;
+			} else if (MONO_IS_STORE_MEMBASE (ins) && IS_ALIAS (ins->dreg)) {
+				sf = find_scalar_field (cfg, klass, aliases [ins->dreg] + ins->inst_offset, &fields);
+				if (ins->opcode == sf->store_op) {
+					ins->opcode = sf->move_op;
+				} else {
+					gssize imm = ins->inst_imm;
+
+					/* Store the value which a load would return */
+					switch (sf->move_op) {
+					case OP_ICONV_TO_I1:
+						imm = (gint8)imm;
+						break;
+					case OP_ICONV_TO_U1:
+						imm = (guint8)imm;
+						break;
+					case OP_ICONV_TO_I2:
+						imm = (gint16)imm;
+						break;
+					case OP_ICONV_TO_U2:
+						imm = (guint16)imm;
+						break;
+					default:
+						break;
+					}
+
+					ins->opcode = sf->const_op;
+					if (sf->const_op == OP_I8CONST)
+						ins->inst_l = imm;
+					else if (sf->const_op == OP_PCONST)
+						ins->inst_p0 = (gpointer)imm;
+					else
+						ins->inst_c0 = (gint32)imm;
+					ins->sreg1 = -1;
+				}
+				ins->dreg = sf->vreg;
+				ins->sreg2 = -1;
+				ins->flags &= ~MONO_INST_FAULT;
+			} else if ((ins->opcode == OP_CARD_TABLE_WBARRIER || ins->opcode == OP_CHECK_THIS || ins->opcode == OP_NOT_NULL) && IS_ALIAS (ins->sreg1)) {
+				NULLIFY_INS (ins);
+			} else if ((ins->opcode == OP_COMPARE_IMM || ins->opcode == OP_ICOMPARE_IMM || ins->opcode == OP_LCOMPARE_IMM) && IS_ALIAS (ins->sreg1)) {
+				NULLIFY_INS (ins->next);
+				NULLIFY_INS (ins);
+			}
+		}
+	}
+
+	for (l = alias_list; l; l = l->next)
+		aliases [GPOINTER_TO_INT (l->data)] = -1;
+
+#undef IS_ALIAS
+
+	return TRUE;
+}
+
+/*
+ * mono_ssa_escape_analysis:
+ *
+ *   Remove the allocations of objects which don't escape the method, see above.
+ */
+void
+mono_ssa_escape_analysis (MonoCompile *cfg)
+{
+	MonoBasicBlock *bb;
+	MonoInst *ins;
+	GSList *allocs = NULL, *alloc_bbs = NULL, *l, *l2;
+	int *def_count, *aliases;
+	gboolean *implicit_uses;
+	int num_vregs = cfg->next_vreg;
+
+	g_assert (cfg->comp_done & MONO_COMP_SSA);
+
+	/* OP_NEWOBJ is decomposed together with the array opcodes */
+	if (!(cfg->flags & MONO_CFG_HAS_ARRAY_ACCESS))
+		return;
+
+	def_count = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * num_vregs);
+	implicit_uses = mono_mempool_alloc0 (cfg->mempool, sizeof (gboolean) * num_vregs);
+	for (bb = cfg->bb_entry; bb; bb = bb->next_bb) {
+		for (ins = bb->code; ins; ins = ins->next) {
+			const char *spec = INS_INFO (ins->opcode);
+
+			if (ins->opcode == OP_NEWOBJ) {
+				allocs = g_slist_prepend_mempool (cfg->mempool, allocs, ins);
+				alloc_bbs = g_slist_prepend_mempool (cfg->mempool, alloc_bbs, bb);
+			}
+
+			if (spec [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg >= 0)
+				def_count [ins->dreg] ++;
+
+			if (MONO_IS_CALL (ins)) {
+				MonoCallInst *call = (MonoCallInst*)ins;
+
+				/* Arguments passed in registers are not sregs of the call */
+				for (l = call->out_ireg_args; l; l = l->next) {
+					guint32 regpair = (guint32)(gssize)(l->data);
+
+					implicit_uses [regpair & 0xffffff] = TRUE;
+				}
+			}
+		}
+	}
+
+	if (!allocs)
+		return;
+
+	aliases = mono_mempool_alloc (cfg->mempool, sizeof (int) * num_vregs);
+	memset (aliases, 0xff, sizeof (int) * num_vregs);
+
+	for (l = allocs, l2 = alloc_bbs; l; l = l->next, l2 = l2->next) {
+		if (scalar_replace_alloc (cfg, l2->data, l->data, num_vregs, def_count, implicit_uses, aliases))
+			cfg->stat_allocations_removed ++;
+	}
+
+	if (cfg->stat_allocations_removed) {
+		/* The def-use chains refer to the removed instructions */
+		cfg->comp_done &= ~MONO_COMP_SSA_DEF_USE;
+
+		if (cfg->verbose_level > 0) {
+			char *name = mono_method_full_name (cfg->method, TRUE);
+			printf ("ESCAPE: removed %d allocations in %s\n", cfg->stat_allocations_removed, name);
+			g_free (name);
+		}
+	}
+
+	if (cfg->verbose_level >= 4) {
+		for (bb = cfg->bb_entry; bb; bb = bb->next_bb)
+			mono_print_bb (bb, "AFTER ESCAPE ANALYSIS");
+	}
+}
+
 #if 0
 void
 mono_ssa_strength_reduction (MonoCompile *cfg)
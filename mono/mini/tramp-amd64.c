@@ -22,6 +22,7 @@
 #include <mono/arch/amd64/amd64-codegen.h>
 
 #include <mono/utils/memcheck.h>
+#include <mono/utils/mono-memory-model.h>
 
 #include "mini.h"
 #include "mini-amd64.h"
@@ -267,6 +268,46 @@ mono_arch_patch_plt_entry (guint8 *code, gpointer *got, mgreg_t *regs, guint8 *a
 	InterlockedExchangePointer (plt_jump_table_entry, addr);
 }
 
+/*
+ * mono_arch_patch_tier0_entry:
+ *
+ *   Redirect the tier 0 code described by JI to ADDR. Tier 0 code starts with an 8
+ * byte nop, and ends with a 'jmp *0(%rip)' stub followed by the jump target. The
+ * target is set first, then the nop is replaced atomically by a jump to the stub, so
+ * threads entering the method concurrently run either the old or the new code.
+ * Return FALSE if JI doesn't look like tier 0 code.
+ */
+gboolean
+mono_arch_patch_tier0_entry (MonoJitInfo *ji, guint8 *addr)
+{
+#ifdef MONO_ARCH_HAVE_TIERED_COMPILATION
+	static const guint8 nop [] = { 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	guint8 *code = ji->code_start;
+	guint8 *stub = code + ji->code_size - AMD64_TIER0_STUB_SIZE;
+	guint8 buf [8];
+	guint8 *p;
+
+	if (((gsize)code & 7) || memcmp (code, nop, sizeof (nop)))
+		return FALSE;
+	if (stub [0] != 0xff || stub [1] != 0x25 || *(gint32*)(stub + 2) != 0)
+		return FALSE;
+
+	*(gpointer*)(stub + 6) = addr;
+	mono_memory_barrier ();
+
+	p = buf;
+	x86_jump32 (p, stub - (code + 5));
+	while (p < buf + sizeof (buf))
+		x86_nop (p);
+	InterlockedExchangePointer ((gpointer*)code, *(gpointer*)buf);
+	mono_arch_flush_icache (code, sizeof (buf));
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
 static gpointer
 get_vcall_slot (guint8 *code, mgreg_t *regs, int *displacement)
 {
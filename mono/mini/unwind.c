@@ -26,21 +26,6 @@ typedef struct {
 	int offset;
 } Loc;
 
-typedef struct {
-	guint32 len;
-	guint8 info [MONO_ZERO_LEN_ARRAY];
-} MonoUnwindInfo;
-
-static CRITICAL_SECTION unwind_mutex;
-
-static MonoUnwindInfo **cached_info;
-static int cached_info_next, cached_info_size;
-/* Statistics */
-static int unwind_info_size;
-
-#define unwind_lock() EnterCriticalSection (&unwind_mutex)
-#define unwind_unlock() LeaveCriticalSection (&unwind_mutex)
-
 #ifdef TARGET_AMD64
 static int map_hw_reg_to_dwarf_reg [] = { 0, 2, 1, 3, 7, 6, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
 #define NUM_REGS AMD64_NREG
@@ -83,6 +68,28 @@ static gboolean dwarf_reg_to_hw_reg_inited;
 
 static int map_dwarf_reg_to_hw_reg [NUM_REGS];
 
+typedef struct {
+	guint32 len;
+	/*
+	 * The state after executing all the unwind ops, which are all executed for IPs
+	 * after END_POS.
+	 */
+	int end_pos;
+	int cfa_reg, cfa_offset;
+	Loc locations [NUM_REGS];
+	guint8 info [MONO_ZERO_LEN_ARRAY];
+} MonoUnwindInfo;
+
+static CRITICAL_SECTION unwind_mutex;
+
+static MonoUnwindInfo **cached_info;
+static int cached_info_next, cached_info_size;
+/* Statistics */
+static int unwind_info_size;
+
+#define unwind_lock() EnterCriticalSection (&unwind_mutex)
+#define unwind_unlock() LeaveCriticalSection (&unwind_mutex)
+
 /*
  * mono_hw_reg_to_dwarf_reg:
  *
@@ -322,24 +329,18 @@ print_dwarf_state (int cfa_reg, int cfa_offset, int ip, int nregs, Loc *location
 }
 
 /*
- * Given the state of the current frame as stored in REGS, execute the unwind 
- * operations in unwind_info until the location counter reaches POS. The result is 
- * stored back into REGS. OUT_CFA will receive the value of the CFA.
- * If SAVE_LOCATIONS is non-NULL, it should point to an array of size SAVE_LOCATIONS_LEN.
- * On return, the nth entry will point to the address of the stack slot where register
- * N was saved, or NULL, if it was not saved by this frame.
+ * decode_unwind_ops:
+ *
+ *   Execute the unwind operations in UNWIND_INFO until the location counter reaches
+ * IP_OFFSET, storing the resulting state into LOCATIONS, OUT_CFA_REG and OUT_CFA_OFFSET.
+ * Return the final value of the location counter.
  * This function is signal safe.
  */
-void
-mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len, 
-				   guint8 *start_ip, guint8 *end_ip, guint8 *ip, mgreg_t *regs, int nregs,
-				   mgreg_t **save_locations, int save_locations_len,
-				   guint8 **out_cfa)
+static int
+decode_unwind_ops (guint8 *unwind_info, guint32 unwind_info_len, int ip_offset, Loc *locations, int *out_cfa_reg, int *out_cfa_offset)
 {
-	Loc locations [NUM_REGS];
 	int i, pos, reg, cfa_reg, cfa_offset;
 	guint8 *p;
-	guint8 *cfa_val;
 
 	for (i = 0; i < NUM_REGS; ++i)
 		locations [i].loc_type = LOC_SAME;
@@ -348,12 +349,12 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 	pos = 0;
 	cfa_reg = -1;
 	cfa_offset = -1;
-	while (pos <= ip - start_ip && p < unwind_info + unwind_info_len) {
+	while (pos <= ip_offset && p < unwind_info + unwind_info_len) {
 		int op = *p & 0xc0;
 
 		switch (op) {
 		case DW_CFA_advance_loc:
-			UNW_DEBUG (print_dwarf_state (cfa_reg, cfa_offset, pos, nregs, locations));
+			UNW_DEBUG (print_dwarf_state (cfa_reg, cfa_offset, pos, NUM_REGS, locations));
 			pos += *p & 0x3f;
 			p ++;
 			break;
@@ -396,6 +397,26 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 		}
 	}
 
+	*out_cfa_reg = cfa_reg;
+	*out_cfa_offset = cfa_offset;
+
+	return pos;
+}
+
+/*
+ * apply_unwind_state:
+ *
+ *   Compute the CFA and restore the registers saved by the current frame into REGS
+ * using the state computed by decode_unwind_ops ().
+ * This function is signal safe.
+ */
+static void
+apply_unwind_state (Loc *locations, int cfa_reg, int cfa_offset, mgreg_t *regs, int nregs,
+					mgreg_t **save_locations, int save_locations_len, guint8 **out_cfa)
+{
+	int i;
+	guint8 *cfa_val;
+
 	if (save_locations)
 		memset (save_locations, 0, save_locations_len * sizeof (mgreg_t*));
 
@@ -413,6 +434,59 @@ mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len,
 	*out_cfa = cfa_val;
 }
 
+/*
+ * Given the state of the current frame as stored in REGS, execute the unwind 
+ * operations in unwind_info until the location counter reaches POS. The result is 
+ * stored back into REGS. OUT_CFA will receive the value of the CFA.
+ * If SAVE_LOCATIONS is non-NULL, it should point to an array of size SAVE_LOCATIONS_LEN.
+ * On return, the nth entry will point to the address of the stack slot where register
+ * N was saved, or NULL, if it was not saved by this frame.
+ * This function is signal safe.
+ */
+void
+mono_unwind_frame (guint8 *unwind_info, guint32 unwind_info_len, 
+				   guint8 *start_ip, guint8 *end_ip, guint8 *ip, mgreg_t *regs, int nregs,
+				   mgreg_t **save_locations, int save_locations_len,
+				   guint8 **out_cfa)
+{
+	Loc locations [NUM_REGS];
+	int cfa_reg, cfa_offset;
+
+	decode_unwind_ops (unwind_info, unwind_info_len, ip - start_ip, locations, &cfa_reg, &cfa_offset);
+
+	apply_unwind_state (locations, cfa_reg, cfa_offset, regs, nregs, save_locations, save_locations_len, out_cfa);
+}
+
+/*
+ * mono_unwind_frame_cached:
+ *
+ *   Same as mono_unwind_frame (), but use the unwind info cached at INDEX by
+ * mono_cache_unwind_info (). Once IP is past the last unwind op, which is the case
+ * for most frames, the state decoded when the info was cached is used, so the ops
+ * don't need to be decoded again.
+ * This function is signal safe.
+ */
+void
+mono_unwind_frame_cached (guint32 index, guint8 *start_ip, guint8 *end_ip, guint8 *ip, mgreg_t *regs, int nregs,
+						  mgreg_t **save_locations, int save_locations_len,
+						  guint8 **out_cfa)
+{
+	MonoUnwindInfo **table;
+	MonoUnwindInfo *info;
+	MonoThreadHazardPointers *hp = mono_hazard_pointer_get ();
+
+	table = get_hazardous_pointer ((gpointer volatile*)&cached_info, hp, 0);
+	/* The entries are never freed, only the table */
+	info = table [index];
+	mono_hazard_pointer_clear (hp, 0);
+
+	if (ip - start_ip >= info->end_pos) {
+		apply_unwind_state (info->locations, info->cfa_reg, info->cfa_offset, regs, nregs, save_locations, save_locations_len, out_cfa);
+	} else {
+		mono_unwind_frame (info->info, info->len, start_ip, end_ip, ip, regs, nregs, save_locations, save_locations_len, out_cfa);
+	}
+}
+
 void
 mono_unwind_init (void)
 {
@@ -475,6 +549,7 @@ mono_cache_unwind_info (guint8 *unwind_info, guint32 unwind_info_len)
 	info = g_malloc (sizeof (MonoUnwindInfo) + unwind_info_len);
 	info->len = unwind_info_len;
 	memcpy (&info->info, unwind_info, unwind_info_len);
+	info->end_pos = decode_unwind_ops (info->info, info->len, G_MAXINT32, info->locations, &info->cfa_reg, &info->cfa_offset);
 
 	i = cached_info_next;
 	
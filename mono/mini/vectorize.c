@@ -0,0 +1,1074 @@
+/*
+ * vectorize.c: Loop vectorization using the SIMD opcodes
+ *
+ *   Simple counted loops over primitive arrays, like
+ *
+ *     for (i = 0; i < n; ++i)
+ *         c [i] = a [i] * b [i] + k;
+ *
+ * are rewritten to process 16 bytes of elements per iteration with the SIMD
+ * opcodes used by the Mono.Simd intrinsics. The loop must consist of a header
+ * which compares the induction variable with an invariant limit, and a body which
+ * accesses arrays only at the induction variable, then increments it by one.
+ * The vectorized loop is inserted before the original one, guarded by checks which
+ * make sure none of its array accesses can fail, so the bounds checks can be
+ * omitted. The original loop runs the remaining iterations, and all the iterations
+ * if the guards fail, so exceptions are thrown the same way as before.
+ *
+ *   Single precision expressions are only vectorized if they contain at most one
+ * operation, since the scalar code computes them with double precision. Sums of
+ * ints are vectorized using a horizontal add in every iteration, since vector
+ * values can't be live across bblocks. Floating point sums are not vectorized,
+ * since reordering the additions would change their result.
+ *
+ * Copyright 2011 Xamarin, Inc (http://www.xamarin.com)
+ */
+
+#include "mini.h"
+#include "ir-emit.h"
+
+#if defined(MONO_ARCH_SIMD_INTRINSICS) && !defined(DISABLE_JIT)
+
+/* The kind of value computed by an instruction in the loop body */
+enum {
+	VEC_NONE,
+	/* The induction variable, possibly sign extended */
+	VEC_IV,
+	/* The induction variable plus one */
+	VEC_IV_NEXT,
+	/* The address of the element at the induction variable of an array */
+	VEC_ADDR,
+	/* A value which can be computed for a vector of elements */
+	VEC_VALUE,
+	/* The sum of an accumulator and a VEC_VALUE */
+	VEC_SUM,
+	/* The accumulator of a sum */
+	VEC_ACC
+};
+
+/* The element types of the vector values */
+enum {
+	VEC_TYPE_NONE,
+	VEC_TYPE_I4,
+	VEC_TYPE_R4,
+	VEC_TYPE_R8
+};
+
+typedef struct {
+	guint8 kind;
+	guint8 etype;
+	/* The number of fp operations computing a VEC_VALUE */
+	guint8 nops;
+	/* The element size for VEC_ADDR, the accumulator for VEC_SUM */
+	int reg;
+} VecValue;
+
+typedef struct {
+	MonoCompile *cfg;
+	MonoBasicBlock *h, *body, *preheader;
+	/* The loop runs while iv < limit, the limit is LIMIT_REG, LIMIT_IMM or the length of LIMIT_ARRAY */
+	int iv, limit_reg, limit_array;
+	gint32 limit_imm;
+	/* The number of definitions of each vreg in the loop */
+	int *loop_defs;
+	/* Indexed by vreg, set for the vregs defined by the loop body */
+	VecValue *values;
+	/* Maps the vregs of the loop body to the vregs of the vectorized loop */
+	int *xregs;
+	/* The vregs of the arrays accessed at the induction variable */
+	GSList *arrays;
+	/* The vregs checked for null, they must all be in ARRAYS */
+	GSList *objects;
+	int elem_size, nstores, nsums, nopen_sums;
+	gboolean incremented;
+	/* The sign extended induction variable in the vectorized loop */
+	int ivx;
+} VecLoop;
+
+static guint32 simd_versions;
+
+static gboolean
+is_invariant (VecLoop *l, int vreg)
+{
+	MonoInst *var;
+
+	if (vreg < MONO_MAX_IREGS || l->loop_defs [vreg])
+		return FALSE;
+	var = get_vreg_to_inst (l->cfg, vreg);
+	return !var || !(var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT));
+}
+
+static gboolean
+is_iv (VecLoop *l, int vreg)
+{
+	return (vreg == l->iv && !l->incremented) || l->values [vreg].kind == VEC_IV;
+}
+
+/*
+ * var_etype:
+ *
+ *   Return the element type of a vector containing copies of the variable VREG.
+ */
+static int
+var_etype (MonoCompile *cfg, int vreg)
+{
+	MonoInst *var = get_vreg_to_inst (cfg, vreg);
+
+	if (!var || var->inst_vtype->byref)
+		return VEC_TYPE_NONE;
+	switch (var->inst_vtype->type) {
+	case MONO_TYPE_BOOLEAN:
+	case MONO_TYPE_CHAR:
+	case MONO_TYPE_I1:
+	case MONO_TYPE_U1:
+	case MONO_TYPE_I2:
+	case MONO_TYPE_U2:
+	case MONO_TYPE_I4:
+	case MONO_TYPE_U4:
+		return VEC_TYPE_I4;
+	case MONO_TYPE_R4:
+		return MONO_ARCH_USE_FPSTACK ? VEC_TYPE_NONE : VEC_TYPE_R4;
+	case MONO_TYPE_R8:
+		return MONO_ARCH_USE_FPSTACK ? VEC_TYPE_NONE : VEC_TYPE_R8;
+	default:
+		return VEC_TYPE_NONE;
+	}
+}
+
+static gboolean
+is_accumulator (VecLoop *l, int vreg)
+{
+	MonoInst *var = get_vreg_to_inst (l->cfg, vreg);
+
+	if (!var || vreg == l->iv || l->values [vreg].kind != VEC_NONE || l->loop_defs [vreg] != 1 || (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+		return FALSE;
+	return !var->inst_vtype->byref && (var->inst_vtype->type == MONO_TYPE_I4 || var->inst_vtype->type == MONO_TYPE_U4);
+}
+
+static void
+add_object (VecLoop *l, int vreg, gboolean is_array)
+{
+	MonoMemPool *mp = l->cfg->mempool;
+
+	if (is_array) {
+		if (!g_slist_find (l->arrays, GINT_TO_POINTER (vreg)))
+			l->arrays = g_slist_prepend_mempool (mp, l->arrays, GINT_TO_POINTER (vreg));
+	} else {
+		if (!g_slist_find (l->objects, GINT_TO_POINTER (vreg)))
+			l->objects = g_slist_prepend_mempool (mp, l->objects, GINT_TO_POINTER (vreg));
+	}
+}
+
+static int
+emit_xop (MonoCompile *cfg, int opcode, int sreg1, int sreg2)
+{
+	MonoInst *ins;
+
+	MONO_INST_NEW (cfg, ins, opcode);
+	ins->dreg = alloc_ireg (cfg);
+	ins->sreg1 = sreg1;
+	ins->sreg2 = sreg2;
+	ins->type = STACK_VTYPE;
+	MONO_ADD_INS (cfg->cbb, ins);
+	return ins->dreg;
+}
+
+/*
+ * emit_expand:
+ *
+ *   Emit code to create a vector whose elements are copies of the scalar in VREG.
+ */
+static int
+emit_expand (MonoCompile *cfg, int etype, int vreg)
+{
+	switch (etype) {
+	case VEC_TYPE_I4:
+		return emit_xop (cfg, OP_EXPAND_I4, vreg, -1);
+	case VEC_TYPE_R4:
+		return emit_xop (cfg, OP_EXPAND_R4, vreg, -1);
+	default:
+		return emit_xop (cfg, OP_EXPAND_R8, vreg, -1);
+	}
+}
+
+static int
+emit_expand_iconst (MonoCompile *cfg, gint32 imm)
+{
+	int reg = alloc_ireg (cfg);
+
+	MONO_EMIT_NEW_ICONST (cfg, reg, imm);
+	return emit_xop (cfg, OP_EXPAND_I4, reg, -1);
+}
+
+/*
+ * emit_sum:
+ *
+ *   Emit code to add the elements of the vector XREG to the int variable ACC.
+ */
+static void
+emit_sum (MonoCompile *cfg, int acc, int xreg)
+{
+	MonoInst *ins;
+	int shuffled, sum, reg;
+
+	shuffled = emit_xop (cfg, OP_PSHUFLED, xreg, -1);
+	cfg->cbb->last_ins->inst_c0 = 0x4E;
+	sum = emit_xop (cfg, OP_PADDD, xreg, shuffled);
+	shuffled = emit_xop (cfg, OP_PSHUFLED, sum, -1);
+	cfg->cbb->last_ins->inst_c0 = 0xB1;
+	sum = emit_xop (cfg, OP_PADDD, sum, shuffled);
+
+	reg = alloc_ireg (cfg);
+	MONO_INST_NEW (cfg, ins, OP_EXTRACT_I4);
+	ins->dreg = reg;
+	ins->sreg1 = sum;
+	ins->inst_c0 = 0;
+	ins->type = STACK_I4;
+	MONO_ADD_INS (cfg->cbb, ins);
+
+	MONO_EMIT_NEW_BIALU (cfg, OP_IADD, acc, acc, reg);
+}
+
+/*
+ * get_value:
+ *
+ *   Return the element type of the vector value of the operand SREG, or
+ * VEC_TYPE_NONE if it has none. If EMIT is set, store the vreg holding the vector
+ * into *XREG, emitting code to create it from invariant scalars.
+ */
+static int
+get_value (VecLoop *l, int sreg, gboolean emit, int *xreg, int *nops)
+{
+	VecValue *v = &l->values [sreg];
+	int etype;
+
+	*nops = 0;
+	if (v->kind == VEC_VALUE) {
+		*nops = v->nops;
+		if (emit)
+			*xreg = l->xregs [sreg];
+		return v->etype;
+	}
+	if (v->kind != VEC_NONE || !is_invariant (l, sreg))
+		return VEC_TYPE_NONE;
+	etype = var_etype (l->cfg, sreg);
+	if (etype != VEC_TYPE_NONE && emit)
+		*xreg = emit_expand (l->cfg, etype, sreg);
+	return etype;
+}
+
+static gboolean
+set_kind (VecLoop *l, int dreg, int kind, int reg, int xreg)
+{
+	VecValue *v = &l->values [dreg];
+
+	if (dreg == l->iv || v->kind == VEC_ACC)
+		return FALSE;
+	v->kind = kind;
+	v->etype = VEC_TYPE_NONE;
+	v->nops = 0;
+	v->reg = reg;
+	l->xregs [dreg] = xreg;
+	return TRUE;
+}
+
+static gboolean
+set_value (VecLoop *l, int dreg, int etype, int nops, int xreg)
+{
+	if (etype == VEC_TYPE_NONE || (etype == VEC_TYPE_R4 && nops > 1) || (etype != VEC_TYPE_I4 && MONO_ARCH_USE_FPSTACK))
+		return FALSE;
+	if (!set_kind (l, dreg, VEC_VALUE, -1, xreg))
+		return FALSE;
+	l->values [dreg].etype = etype;
+	l->values [dreg].nops = nops;
+	return TRUE;
+}
+
+static int
+int_simd_op (int opcode)
+{
+	switch (opcode) {
+	case OP_IADD:
+	case OP_IADD_IMM:
+		return OP_PADDD;
+	case OP_ISUB:
+	case OP_ISUB_IMM:
+		return OP_PSUBD;
+	case OP_IMUL:
+	case OP_IMUL_IMM:
+		return OP_PMULD;
+	case OP_IAND:
+	case OP_IAND_IMM:
+		return OP_PAND;
+	case OP_IOR:
+	case OP_IOR_IMM:
+		return OP_POR;
+	case OP_IXOR:
+	case OP_IXOR_IMM:
+		return OP_PXOR;
+	case OP_ISHL_IMM:
+		return OP_PSHLD;
+	case OP_ISHR_IMM:
+		return OP_PSARD;
+	case OP_ISHR_UN_IMM:
+		return OP_PSHRD;
+	default:
+		g_assert_not_reached ();
+		return -1;
+	}
+}
+
+static int
+fp_simd_op (int opcode, int etype)
+{
+	gboolean r4 = etype == VEC_TYPE_R4;
+
+	switch (opcode) {
+	case OP_FADD:
+		return r4 ? OP_ADDPS : OP_ADDPD;
+	case OP_FSUB:
+		return r4 ? OP_SUBPS : OP_SUBPD;
+	case OP_FMUL:
+		return r4 ? OP_MULPS : OP_MULPD;
+	case OP_FDIV:
+		return r4 ? OP_DIVPS : OP_DIVPD;
+	default:
+		g_assert_not_reached ();
+		return -1;
+	}
+}
+
+/*
+ * check_addr:
+ *
+ *   Return whenever the memory access INS with base register BASEREG reads or
+ * writes an element of size SIZE at the induction variable.
+ */
+static gboolean
+check_addr (VecLoop *l, MonoInst *ins, int basereg, int size)
+{
+	VecValue *v = &l->values [basereg];
+
+	return v->kind == VEC_ADDR && v->reg == size && ins->inst_offset == 0;
+}
+
+/*
+ * process_body:
+ *
+ *   Check whenever the body of the loop can be vectorized if EMIT is FALSE,
+ * otherwise emit the vectorized body to the current bblock. The two passes
+ * process the instructions the same way, so the emitting pass can't fail.
+ */
+static gboolean
+process_body (VecLoop *l, gboolean emit)
+{
+	MonoCompile *cfg = l->cfg;
+	MonoInst *ins;
+	GSList *list;
+	/* The exception check which has to follow a null or bounds check */
+	int expect_exc = 0;
+
+	l->incremented = FALSE;
+	for (ins = l->body->code; ins; ins = ins->next) {
+		int t1, t2, n1, n2, x1 = -1, x2 = -1, size = 0, etype = VEC_TYPE_NONE;
+
+		if (expect_exc) {
+			if (ins->opcode != expect_exc)
+				return FALSE;
+			expect_exc = 0;
+			continue;
+		}
+
+		switch (ins->opcode) {
+		case OP_NOP:
+		case OP_NOT_NULL:
+			break;
+		case OP_BR:
+			if (ins->next || ins->inst_target_bb != l->h)
+				return FALSE;
+			break;
+		case OP_COMPARE_IMM:
+			/*
+			 * Null check, anything else compared against 0 could be part of a
+			 * decomposed overflow check, which can't be hoisted.
+			 */
+			if (ins->inst_imm != 0 || !is_invariant (l, ins->sreg1))
+				return FALSE;
+			if (!emit)
+				add_object (l, ins->sreg1, FALSE);
+			expect_exc = OP_COND_EXC_EQ;
+			break;
+		case OP_BOUNDS_CHECK:
+			if (ins->inst_imm != G_STRUCT_OFFSET (MonoArray, max_length) || !is_invariant (l, ins->sreg1) || !is_iv (l, ins->sreg2))
+				return FALSE;
+			if (!emit)
+				add_object (l, ins->sreg1, TRUE);
+			break;
+#ifdef TARGET_AMD64
+		case OP_AMD64_ICOMPARE_MEMBASE_REG:
+#else
+		case OP_X86_COMPARE_MEMBASE_REG:
+#endif
+			/* Bounds check */
+			if (ins->inst_offset != G_STRUCT_OFFSET (MonoArray, max_length) || !is_invariant (l, ins->inst_basereg) || !is_iv (l, ins->sreg2))
+				return FALSE;
+			if (!emit)
+				add_object (l, ins->inst_basereg, TRUE);
+			expect_exc = OP_COND_EXC_LE_UN;
+			break;
+#if SIZEOF_REGISTER == 8
+		case OP_SEXT_I4:
+			if (!is_iv (l, ins->sreg1) || !set_kind (l, ins->dreg, VEC_IV, -1, -1))
+				return FALSE;
+			break;
+#endif
+		case OP_MOVE:
+		case OP_ICONV_TO_I4:
+			if (is_iv (l, ins->sreg1)) {
+				if (!set_kind (l, ins->dreg, VEC_IV, -1, -1))
+					return FALSE;
+			} else if (ins->opcode == OP_MOVE && ins->dreg == l->iv && l->values [ins->sreg1].kind == VEC_IV_NEXT) {
+				l->incremented = TRUE;
+			} else if (ins->opcode == OP_MOVE && l->values [ins->sreg1].kind == VEC_SUM && l->values [ins->sreg1].reg == ins->dreg) {
+				if (emit)
+					emit_sum (cfg, ins->dreg, l->xregs [ins->sreg1]);
+				else
+					l->nopen_sums --;
+			} else {
+				t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+				if (t1 != VEC_TYPE_I4 || !set_value (l, ins->dreg, t1, n1, x1))
+					return FALSE;
+			}
+			break;
+		case OP_FMOVE:
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			if (t1 == VEC_TYPE_I4 || !set_value (l, ins->dreg, t1, n1, x1))
+				return FALSE;
+			break;
+		case OP_FCONV_TO_R4:
+			/* A no-op on single precision values computed by at most one operation */
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			if (t1 != VEC_TYPE_R4 || !set_value (l, ins->dreg, t1, n1, x1))
+				return FALSE;
+			break;
+		case OP_ICONST:
+			if (emit)
+				x1 = emit_expand_iconst (cfg, ins->inst_c0);
+			if (!set_value (l, ins->dreg, VEC_TYPE_I4, 0, x1))
+				return FALSE;
+			break;
+		case OP_R4CONST:
+		case OP_R8CONST:
+			etype = ins->opcode == OP_R4CONST ? VEC_TYPE_R4 : VEC_TYPE_R8;
+			if (emit) {
+				MonoInst *c;
+
+				MONO_INST_NEW (cfg, c, ins->opcode);
+				c->dreg = alloc_freg (cfg);
+				c->inst_p0 = ins->inst_p0;
+				c->type = STACK_R8;
+				MONO_ADD_INS (cfg->cbb, c);
+				x1 = emit_expand (cfg, etype, c->dreg);
+			}
+			if (!set_value (l, ins->dreg, etype, 0, x1))
+				return FALSE;
+			break;
+		case OP_X86_LEA:
+			/* The address of an array element */
+			if (ins->inst_imm != G_STRUCT_OFFSET (MonoArray, vector) || !is_invariant (l, ins->sreg1) || !is_iv (l, ins->sreg2))
+				return FALSE;
+			if (ins->backend.shift_amount != 2 && ins->backend.shift_amount != 3)
+				return FALSE;
+			size = 1 << ins->backend.shift_amount;
+			if (l->elem_size && l->elem_size != size)
+				return FALSE;
+			l->elem_size = size;
+			if (emit) {
+				MonoInst *lea;
+
+				MONO_INST_NEW (cfg, lea, OP_X86_LEA);
+				lea->dreg = x1 = alloc_ireg_mp (cfg);
+				lea->sreg1 = ins->sreg1;
+				lea->sreg2 = l->ivx;
+				lea->inst_imm = ins->inst_imm;
+				lea->backend.shift_amount = ins->backend.shift_amount;
+				lea->type = STACK_MP;
+				MONO_ADD_INS (cfg->cbb, lea);
+			} else {
+				add_object (l, ins->sreg1, TRUE);
+			}
+			if (!set_kind (l, ins->dreg, VEC_ADDR, size, x1))
+				return FALSE;
+			break;
+		case OP_LOADI4_MEMBASE:
+		case OP_LOADU4_MEMBASE:
+			etype = VEC_TYPE_I4;
+			size = 4;
+			/* Fall through */
+		case OP_LOADR4_MEMBASE:
+			if (!size) {
+				etype = VEC_TYPE_R4;
+				size = 4;
+			}
+			/* Fall through */
+		case OP_LOADR8_MEMBASE:
+			if (!size) {
+				etype = VEC_TYPE_R8;
+				size = 8;
+			}
+			if (!check_addr (l, ins, ins->inst_basereg, size))
+				return FALSE;
+			if (emit) {
+				MonoInst *load;
+
+				MONO_INST_NEW (cfg, load, OP_LOADX_MEMBASE);
+				load->dreg = x1 = alloc_ireg (cfg);
+				load->sreg1 = l->xregs [ins->inst_basereg];
+				load->inst_offset = 0;
+				load->type = STACK_VTYPE;
+				MONO_ADD_INS (cfg->cbb, load);
+			}
+			if (!set_value (l, ins->dreg, etype, 0, x1))
+				return FALSE;
+			break;
+		case OP_STOREI4_MEMBASE_IMM:
+		case OP_STOREI4_MEMBASE_REG:
+			etype = VEC_TYPE_I4;
+			size = 4;
+			/* Fall through */
+		case OP_STORER4_MEMBASE_REG:
+			if (!size) {
+				etype = VEC_TYPE_R4;
+				size = 4;
+			}
+			/* Fall through */
+		case OP_STORER8_MEMBASE_REG:
+			if (!size) {
+				etype = VEC_TYPE_R8;
+				size = 8;
+			}
+			if (!check_addr (l, ins, ins->inst_destbasereg, size))
+				return FALSE;
+			if (ins->opcode == OP_STOREI4_MEMBASE_IMM) {
+				if (emit)
+					x1 = emit_expand_iconst (cfg, ins->inst_imm);
+			} else {
+				t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+				if (t1 != etype || (etype == VEC_TYPE_R4 && n1 > 1))
+					return FALSE;
+			}
+			if (emit) {
+				MonoInst *store;
+
+				MONO_INST_NEW (cfg, store, OP_STOREX_MEMBASE);
+				store->dreg = l->xregs [ins->inst_destbasereg];
+				store->sreg1 = x1;
+				store->inst_offset = 0;
+				MONO_ADD_INS (cfg->cbb, store);
+			} else {
+				l->nstores ++;
+			}
+			break;
+		case OP_IADD:
+			if (is_accumulator (l, ins->sreg1) || is_accumulator (l, ins->sreg2)) {
+				/* A sum like s += a [i] */
+				int acc = is_accumulator (l, ins->sreg1) ? ins->sreg1 : ins->sreg2;
+				int other = acc == ins->sreg1 ? ins->sreg2 : ins->sreg1;
+
+				t2 = get_value (l, other, emit, &x2, &n2);
+				if (t2 != VEC_TYPE_I4)
+					return FALSE;
+				l->values [acc].kind = VEC_ACC;
+				if (ins->dreg == acc) {
+					if (emit)
+						emit_sum (cfg, acc, x2);
+					else
+						l->nsums ++;
+				} else {
+					if (!set_kind (l, ins->dreg, VEC_SUM, acc, x2))
+						return FALSE;
+					if (!emit) {
+						l->nsums ++;
+						l->nopen_sums ++;
+					}
+				}
+				break;
+			}
+			/* Fall through */
+		case OP_ISUB:
+		case OP_IMUL:
+		case OP_IAND:
+		case OP_IOR:
+		case OP_IXOR:
+			if (ins->opcode == OP_IMUL && (cfg->compile_aot || !(simd_versions & SIMD_VERSION_SSE41)))
+				return FALSE;
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			t2 = get_value (l, ins->sreg2, emit, &x2, &n2);
+			if (t1 != VEC_TYPE_I4 || t2 != VEC_TYPE_I4)
+				return FALSE;
+			if (emit)
+				x1 = emit_xop (cfg, int_simd_op (ins->opcode), x1, x2);
+			if (!set_value (l, ins->dreg, VEC_TYPE_I4, 0, x1))
+				return FALSE;
+			break;
+		case OP_IADD_IMM:
+			if (is_iv (l, ins->sreg1) && ins->inst_imm == 1) {
+				/* The increment of the induction variable */
+				if (ins->dreg == l->iv)
+					l->incremented = TRUE;
+				else if (!set_kind (l, ins->dreg, VEC_IV_NEXT, -1, -1))
+					return FALSE;
+				break;
+			}
+			/* Fall through */
+		case OP_ISUB_IMM:
+		case OP_IMUL_IMM:
+		case OP_IAND_IMM:
+		case OP_IOR_IMM:
+		case OP_IXOR_IMM:
+			if (ins->opcode == OP_IMUL_IMM && (cfg->compile_aot || !(simd_versions & SIMD_VERSION_SSE41)))
+				return FALSE;
+			if ((gint32)ins->inst_imm != ins->inst_imm)
+				return FALSE;
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			if (t1 != VEC_TYPE_I4)
+				return FALSE;
+			if (emit) {
+				x2 = emit_expand_iconst (cfg, ins->inst_imm);
+				x1 = emit_xop (cfg, int_simd_op (ins->opcode), x1, x2);
+			}
+			if (!set_value (l, ins->dreg, VEC_TYPE_I4, 0, x1))
+				return FALSE;
+			break;
+		case OP_ISHL_IMM:
+		case OP_ISHR_IMM:
+		case OP_ISHR_UN_IMM:
+			if (ins->inst_imm < 0 || ins->inst_imm > 31)
+				return FALSE;
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			if (t1 != VEC_TYPE_I4)
+				return FALSE;
+			if (emit) {
+				x1 = emit_xop (cfg, int_simd_op (ins->opcode), x1, -1);
+				cfg->cbb->last_ins->inst_imm = ins->inst_imm;
+			}
+			if (!set_value (l, ins->dreg, VEC_TYPE_I4, 0, x1))
+				return FALSE;
+			break;
+		case OP_FADD:
+		case OP_FSUB:
+		case OP_FMUL:
+		case OP_FDIV:
+			t1 = get_value (l, ins->sreg1, emit, &x1, &n1);
+			t2 = get_value (l, ins->sreg2, emit, &x2, &n2);
+			if (t1 != t2 || (t1 != VEC_TYPE_R4 && t1 != VEC_TYPE_R8))
+				return FALSE;
+			if (emit)
+				x1 = emit_xop (cfg, fp_simd_op (ins->opcode, t1), x1, x2);
+			if (!set_value (l, ins->dreg, t1, n1 + n2 + 1, x1))
+				return FALSE;
+			break;
+		default:
+			return FALSE;
+		}
+	}
+
+	if (expect_exc || !l->incremented || l->nopen_sums)
+		return FALSE;
+	/* The null checks are replaced by the guards of the arrays accessed by the loop */
+	for (list = l->objects; list; list = list->next)
+		if (!g_slist_find (l->arrays, list->data))
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * has_outside_uses:
+ *
+ *   Return whenever a variable set by the loop body, other than the induction
+ * variable and the accumulators of sums, is used outside the loop. Its value
+ * would be wrong after running the vectorized loop.
+ */
+static gboolean
+has_outside_uses (VecLoop *l)
+{
+	MonoBasicBlock *bb;
+	MonoInst *ins;
+	int i;
+
+	for (bb = l->cfg->bb_entry; bb; bb = bb->next_bb) {
+		if (bb == l->h || bb == l->body)
+			continue;
+		for (ins = bb->code; ins; ins = ins->next) {
+			int num_sregs, sregs [MONO_MAX_SRC_REGS];
+
+			num_sregs = mono_inst_get_src_registers (ins, sregs);
+			for (i = 0; i < num_sregs; ++i) {
+				int sreg = sregs [i];
+
+				if (sreg >= 0 && l->loop_defs [sreg] && sreg != l->iv && l->values [sreg].kind != VEC_ACC)
+					return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * find_def:
+ *
+ *   Return the last instruction defining VREG before INS, if any.
+ */
+static MonoInst*
+find_def (MonoInst *ins, int vreg)
+{
+	for (ins = ins->prev; ins; ins = ins->prev) {
+		if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg == vreg)
+			return ins;
+	}
+	return NULL;
+}
+
+/*
+ * analyze_header:
+ *
+ *   Check that the header of the loop only compares the induction variable with an
+ * invariant limit, and compute them.
+ */
+static gboolean
+analyze_header (VecLoop *l)
+{
+	MonoCompile *cfg = l->cfg;
+	MonoBasicBlock *h = l->h;
+	MonoInst *ins, *branch = h->last_ins, *cmp, *def, *var;
+	int reg;
+
+	if (!branch || !branch->inst_true_bb || !branch->inst_false_bb)
+		return FALSE;
+	if (!((branch->opcode == OP_IBLT && branch->inst_true_bb == l->body && branch->inst_false_bb != l->body) ||
+		  (branch->opcode == OP_IBGE && branch->inst_false_bb == l->body && branch->inst_true_bb != l->body)))
+		return FALSE;
+	cmp = branch->prev;
+	if (!cmp || (cmp->opcode != OP_ICOMPARE && cmp->opcode != OP_ICOMPARE_IMM))
+		return FALSE;
+
+	/* The header can only compute the operands of the compare into local vregs */
+	for (ins = h->code; ins != cmp; ins = ins->next) {
+		if (ins->opcode == OP_NOP)
+			continue;
+		if (ins->opcode != OP_MOVE && ins->opcode != OP_ICONV_TO_I4 && ins->opcode != OP_LDLEN)
+			return FALSE;
+		if (get_vreg_to_inst (cfg, ins->dreg))
+			return FALSE;
+	}
+
+	def = cmp;
+	reg = cmp->sreg1;
+	while ((def = find_def (def, reg)) && def->opcode != OP_LDLEN)
+		reg = def->sreg1;
+	var = get_vreg_to_inst (cfg, reg);
+	if (def || !var || var->inst_vtype->byref || var->inst_vtype->type != MONO_TYPE_I4 || (var->flags & (MONO_INST_VOLATILE|MONO_INST_INDIRECT)))
+		return FALSE;
+	if (l->loop_defs [reg] != 1)
+		return FALSE;
+	l->iv = reg;
+
+	l->limit_reg = l->limit_array = -1;
+	if (cmp->opcode == OP_ICOMPARE_IMM) {
+		if ((gint32)cmp->inst_imm != cmp->inst_imm)
+			return FALSE;
+		l->limit_imm = cmp->inst_imm;
+	} else {
+		def = cmp;
+		reg = cmp->sreg2;
+		while ((def = find_def (def, reg)) && def->opcode != OP_LDLEN)
+			reg = def->sreg1;
+		if (def) {
+			if (!is_invariant (l, def->sreg1))
+				return FALSE;
+			l->limit_array = def->sreg1;
+		} else {
+			if (!is_invariant (l, reg))
+				return FALSE;
+			l->limit_reg = reg;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * find_preheader:
+ *
+ *   Return the predecessor of the loop header which is not the loop body, if it
+ * only branches to the header.
+ */
+static MonoBasicBlock*
+find_preheader (MonoBasicBlock *h, MonoBasicBlock *body)
+{
+	MonoBasicBlock *preheader;
+
+	if (h->in_count != 2)
+		return NULL;
+	preheader = h->in_bb [0] == body ? h->in_bb [1] : h->in_bb [0];
+	if (preheader == body || preheader->out_count != 1 || preheader->region != h->region)
+		return NULL;
+	if (preheader->last_ins && MONO_IS_BRANCH_OP (preheader->last_ins)) {
+		if (preheader->last_ins->opcode != OP_BR)
+			return NULL;
+	} else if (preheader->next_bb != h) {
+		return NULL;
+	}
+	return preheader;
+}
+
+static MonoBasicBlock*
+new_bblock (MonoCompile *cfg, MonoBasicBlock *h, MonoBasicBlock *prev)
+{
+	MonoBasicBlock *bb = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoBasicBlock));
+
+	bb->block_num = cfg->max_block_num ++;
+	bb->region = h->region;
+	bb->real_offset = h->real_offset;
+	bb->next_bb = prev->next_bb;
+	prev->next_bb = bb;
+	return bb;
+}
+
+/*
+ * emit_guard:
+ *
+ *   End the current bblock with a branch to the loop header using OPCODE, and
+ * continue in a new bblock.
+ */
+static void
+emit_guard (VecLoop *l, int opcode)
+{
+	MonoCompile *cfg = l->cfg;
+	MonoBasicBlock *next = new_bblock (cfg, l->h, cfg->cbb);
+
+	MONO_EMIT_NEW_BRANCH_BLOCK2 (cfg, opcode, l->h, next);
+	cfg->cbb = next;
+}
+
+/*
+ * emit_vector_loop:
+ *
+ *   Emit the guards and the vectorized loop between the preheader and the header
+ * of the loop.
+ */
+static void
+emit_vector_loop (VecLoop *l)
+{
+	MonoCompile *cfg = l->cfg;
+	MonoBasicBlock *preheader = l->preheader, *h = l->h, *vbb;
+	GSList *list;
+	int width = 16 / l->elem_size;
+	int limit_reg, count_reg, end_reg;
+
+	cfg->cbb = new_bblock (cfg, h, preheader);
+	if (preheader->last_ins && preheader->last_ins->opcode == OP_BR)
+		preheader->last_ins->inst_target_bb = cfg->cbb;
+	mono_unlink_bblock (cfg, preheader, h);
+	mono_link_bblock (cfg, preheader, cfg->cbb);
+
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, l->iv, 0);
+	emit_guard (l, OP_IBLT);
+	for (list = l->arrays; list; list = list->next) {
+		MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, GPOINTER_TO_INT (list->data), 0);
+		emit_guard (l, OP_PBEQ);
+	}
+
+	/* The number of iterations done by the vectorized loop is (limit - iv) rounded down to a multiple of WIDTH */
+	if (l->limit_array != -1) {
+		if (!g_slist_find (l->arrays, GINT_TO_POINTER (l->limit_array))) {
+			MONO_EMIT_NEW_BIALU_IMM (cfg, OP_COMPARE_IMM, -1, l->limit_array, 0);
+			emit_guard (l, OP_PBEQ);
+		}
+		limit_reg = alloc_ireg (cfg);
+		MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, limit_reg, l->limit_array, G_STRUCT_OFFSET (MonoArray, max_length));
+	} else if (l->limit_reg != -1) {
+		limit_reg = l->limit_reg;
+	} else {
+		limit_reg = alloc_ireg (cfg);
+		MONO_EMIT_NEW_ICONST (cfg, limit_reg, l->limit_imm);
+	}
+	/* With 0 <= iv < limit, neither limit - iv nor iv + count can overflow */
+	MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, l->iv, limit_reg);
+	emit_guard (l, OP_IBGE);
+	count_reg = alloc_ireg (cfg);
+	MONO_EMIT_NEW_BIALU (cfg, OP_ISUB, count_reg, limit_reg, l->iv);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_IAND_IMM, count_reg, count_reg, ~(width - 1));
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_ICOMPARE_IMM, -1, count_reg, 0);
+	emit_guard (l, OP_IBLE);
+	end_reg = alloc_ireg (cfg);
+	MONO_EMIT_NEW_BIALU (cfg, OP_IADD, end_reg, l->iv, count_reg);
+
+	/* All the accessed elements must be inside the arrays */
+	for (list = l->arrays; list; list = list->next) {
+		int len_reg = alloc_ireg (cfg);
+
+		MONO_EMIT_NEW_LOAD_MEMBASE_OP (cfg, OP_LOADI4_MEMBASE, len_reg, GPOINTER_TO_INT (list->data), G_STRUCT_OFFSET (MonoArray, max_length));
+		MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, end_reg, len_reg);
+		emit_guard (l, OP_IBGT);
+	}
+
+	/* The vectorized loop */
+	vbb = cfg->cbb;
+#if SIZEOF_REGISTER == 8
+	l->ivx = alloc_preg (cfg);
+	MONO_EMIT_NEW_UNALU (cfg, OP_SEXT_I4, l->ivx, l->iv);
+#else
+	l->ivx = l->iv;
+#endif
+	process_body (l, TRUE);
+	MONO_EMIT_NEW_BIALU_IMM (cfg, OP_IADD_IMM, l->iv, l->iv, width);
+	MONO_EMIT_NEW_BIALU (cfg, OP_ICOMPARE, -1, l->iv, end_reg);
+	MONO_EMIT_NEW_BRANCH_BLOCK2 (cfg, OP_IBLT, vbb, h);
+}
+
+static void
+clear_values (VecLoop *l)
+{
+	MonoBasicBlock *bbs [2];
+	MonoInst *ins;
+	int i;
+
+	bbs [0] = l->h;
+	bbs [1] = l->body;
+	for (i = 0; i < 2; ++i) {
+		for (ins = bbs [i]->code; ins; ins = ins->next) {
+			int num_sregs, j, sregs [MONO_MAX_SRC_REGS];
+
+			if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && ins->dreg >= 0)
+				memset (&l->values [ins->dreg], 0, sizeof (VecValue));
+			/* Accumulators are marked when they are read */
+			num_sregs = mono_inst_get_src_registers (ins, sregs);
+			for (j = 0; j < num_sregs; ++j) {
+				if (sregs [j] >= 0)
+					memset (&l->values [sregs [j]], 0, sizeof (VecValue));
+			}
+		}
+	}
+	l->arrays = l->objects = NULL;
+	l->elem_size = l->nstores = l->nsums = l->nopen_sums = 0;
+}
+
+/*
+ * vectorize_loop:
+ *
+ *   Try to vectorize the loop with header H. Return whenever it was vectorized.
+ */
+static gboolean
+vectorize_loop (VecLoop *l, MonoBasicBlock *h)
+{
+	MonoBasicBlock *body;
+	MonoInst *ins;
+	gboolean res = FALSE;
+
+	if (g_list_length (h->loop_blocks) != 2 || h->region != -1)
+		return FALSE;
+	body = h->loop_blocks->data == h ? h->loop_blocks->next->data : h->loop_blocks->data;
+	if (body->in_count != 1 || body->out_count != 1 || body->out_bb [0] != h || body->region != h->region)
+		return FALSE;
+
+	l->h = h;
+	l->body = body;
+	l->preheader = find_preheader (h, body);
+	if (!l->preheader)
+		return FALSE;
+
+	for (ins = h->code; ins; ins = ins->next)
+		if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg >= 0)
+			l->loop_defs [ins->dreg] ++;
+	for (ins = body->code; ins; ins = ins->next)
+		if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && !MONO_IS_STORE_MEMBASE (ins) && ins->dreg >= 0)
+			l->loop_defs [ins->dreg] ++;
+
+	if (analyze_header (l) && process_body (l, FALSE) && l->elem_size && (l->nstores || l->nsums) &&
+		!(l->nsums && l->elem_size != 4) && !has_outside_uses (l)) {
+		GSList *arrays = l->arrays, *objects = l->objects;
+		int elem_size = l->elem_size;
+
+		/* Process the body again from scratch while emitting the vectorized loop */
+		clear_values (l);
+		l->arrays = arrays;
+		l->objects = objects;
+		l->elem_size = elem_size;
+		emit_vector_loop (l);
+		res = TRUE;
+
+		if (l->cfg->verbose_level > 1)
+			printf ("VECTORIZE: vectorized loop BB%d by %d elements\n", h->block_num, 16 / elem_size);
+	}
+
+	clear_values (l);
+	for (ins = h->code; ins; ins = ins->next)
+		if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && ins->dreg >= 0)
+			l->loop_defs [ins->dreg] = 0;
+	for (ins = body->code; ins; ins = ins->next)
+		if (INS_INFO (ins->opcode) [MONO_INST_DEST] != ' ' && ins->dreg >= 0)
+			l->loop_defs [ins->dreg] = 0;
+	return res;
+}
+
+/*
+ * mono_vectorize_loops:
+ *
+ *   Vectorize the simple innermost loops of the method. Needs the loop information
+ * computed by mono_compute_natural_loops (). Return whenever new bblocks were
+ * added, in which case the caller needs to recompute the loop information.
+ */
+gboolean
+mono_vectorize_loops (MonoCompile *cfg)
+{
+	VecLoop loop;
+	MonoBasicBlock **headers;
+	int i, nheaders = 0, nvectorized = 0;
+
+	g_assert (cfg->comp_done & MONO_COMP_LOOPS);
+
+	if (cfg->gen_seq_points)
+		return FALSE;
+
+	if (!simd_versions)
+		simd_versions = mono_arch_cpu_enumerate_simd_versions ();
+	if (!(simd_versions & SIMD_VERSION_SSE2))
+		return FALSE;
+
+	/* cfg->bblocks doesn't contain the new bblocks, so collect the loops first */
+	headers = mono_mempool_alloc0 (cfg->mempool, sizeof (MonoBasicBlock*) * cfg->num_bblocks);
+	for (i = 0; i < cfg->num_bblocks; ++i) {
+		if (cfg->bblocks [i]->loop_blocks)
+			headers [nheaders ++] = cfg->bblocks [i];
+	}
+	if (!nheaders)
+		return FALSE;
+
+	memset (&loop, 0, sizeof (loop));
+	loop.cfg = cfg;
+	loop.loop_defs = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * cfg->next_vreg);
+	loop.values = mono_mempool_alloc0 (cfg->mempool, sizeof (VecValue) * cfg->next_vreg);
+	loop.xregs = mono_mempool_alloc0 (cfg->mempool, sizeof (int) * cfg->next_vreg);
+
+	for (i = 0; i < nheaders; ++i) {
+		if (vectorize_loop (&loop, headers [i]))
+			nvectorized ++;
+	}
+
+	if (nvectorized) {
+		/* Vregs set by the guards are used by the vectorized loop */
+		mono_handle_global_vregs (cfg);
+		cfg->stat_loops_vectorized += nvectorized;
+	}
+	return nvectorized > 0;
+}
+
+#else /* !MONO_ARCH_SIMD_INTRINSICS || DISABLE_JIT */
+
+gboolean
+mono_vectorize_loops (MonoCompile *cfg)
+{
+	return FALSE;
+}
+
+#endif
@@ -1307,6 +1307,8 @@ gc_event_name (int ev)
 	case MONO_GC_EVENT_POST_STOP_WORLD: return "post stop";
 	case MONO_GC_EVENT_PRE_START_WORLD: return "pre start";
 	case MONO_GC_EVENT_POST_START_WORLD: return "post start";
+	case MONO_GC_EVENT_CLEAR_DOMAIN_START: return "clear domain start";
+	case MONO_GC_EVENT_CLEAR_DOMAIN_END: return "clear domain end";
 	default:
 		return "unknown";
 	}
@@ -4702,6 +4702,9 @@ gc_event_code_from_profiler_event (MonoGCEvent event) {
 		return MONO_PROFILER_EVENT_GC_MARK;
 	case MONO_GC_EVENT_RECLAIM_START:
 	case MONO_GC_EVENT_RECLAIM_END:
+	/* There is no event code for this in the file format, so it's logged as a sweep. */
+	case MONO_GC_EVENT_CLEAR_DOMAIN_START:
+	case MONO_GC_EVENT_CLEAR_DOMAIN_END:
 		return MONO_PROFILER_EVENT_GC_SWEEP;
 	case MONO_GC_EVENT_PRE_STOP_WORLD:
 	case MONO_GC_EVENT_POST_STOP_WORLD:
@@ -4723,12 +4726,14 @@ gc_event_kind_from_profiler_event (MonoGCEvent event) {
 	case MONO_GC_EVENT_RECLAIM_START:
 	case MONO_GC_EVENT_PRE_STOP_WORLD:
 	case MONO_GC_EVENT_PRE_START_WORLD:
+	case MONO_GC_EVENT_CLEAR_DOMAIN_START:
 		return MONO_PROFILER_EVENT_KIND_START;
 	case MONO_GC_EVENT_END:
 	case MONO_GC_EVENT_MARK_END:
 	case MONO_GC_EVENT_RECLAIM_END:
 	case MONO_GC_EVENT_POST_START_WORLD:
 	case MONO_GC_EVENT_POST_STOP_WORLD:
+	case MONO_GC_EVENT_CLEAR_DOMAIN_END:
 		return MONO_PROFILER_EVENT_KIND_END;
 	default:
 		g_assert_not_reached ();
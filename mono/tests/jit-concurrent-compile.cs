@@ -0,0 +1,88 @@
+//
+// jit-concurrent-compile.cs: Compile thousands of methods from many threads at
+// the same time, half of them calling methods which other threads are compiling.
+//
+using System;
+using System.Reflection;
+using System.Reflection.Emit;
+using System.Threading;
+
+public class Tests {
+
+	delegate int IntFunc (int x);
+
+	static int methods = 4000;
+	static int threads = 16;
+
+	static MethodInfo[] infos;
+	static int[] expected;
+	static ManualResetEvent start = new ManualResetEvent (false);
+	static int errors;
+
+	// Mi (x) returns x + i for even i, and Mi-1 (x) + i for odd i
+	static Type CreateType () {
+		AssemblyName name = new AssemblyName ("jit-concurrent-compile-gen");
+		AssemblyBuilder assembly = AppDomain.CurrentDomain.DefineDynamicAssembly (name, AssemblyBuilderAccess.Run);
+		ModuleBuilder module = assembly.DefineDynamicModule ("jit-concurrent-compile-gen");
+		TypeBuilder type = module.DefineType ("Gen", TypeAttributes.Public);
+		MethodBuilder prev = null;
+
+		for (int i = 0; i < methods; ++i) {
+			MethodBuilder method = type.DefineMethod ("M" + i, MethodAttributes.Public | MethodAttributes.Static, typeof (int), new Type [] { typeof (int) });
+			ILGenerator ig = method.GetILGenerator ();
+
+			ig.Emit (OpCodes.Ldarg_0);
+			if (i % 2 == 1)
+				ig.Emit (OpCodes.Call, prev);
+			ig.Emit (OpCodes.Ldc_I4, i);
+			ig.Emit (OpCodes.Add);
+			ig.Emit (OpCodes.Ret);
+			prev = method;
+		}
+
+		return type.CreateType ();
+	}
+
+	static void Worker (object arg) {
+		int offset = (int)arg;
+
+		start.WaitOne ();
+		for (int n = 0; n < methods; ++n) {
+			int i = (n + offset) % methods;
+			IntFunc f = (IntFunc)Delegate.CreateDelegate (typeof (IntFunc), infos [i]);
+			int res = f (n);
+
+			if (res != n + expected [i]) {
+				Console.WriteLine ("M{0} ({1}) returned {2}, expected {3}", i, n, res, n + expected [i]);
+				Interlocked.Increment (ref errors);
+			}
+		}
+	}
+
+	public static int Main (string[] args) {
+		if (args.Length > 0)
+			methods = int.Parse (args [0]);
+		if (args.Length > 1)
+			threads = int.Parse (args [1]);
+
+		Type type = CreateType ();
+		infos = new MethodInfo [methods];
+		expected = new int [methods];
+		for (int i = 0; i < methods; ++i) {
+			infos [i] = type.GetMethod ("M" + i);
+			expected [i] = i % 2 == 1 ? expected [i - 1] + i : i;
+		}
+
+		// Threads start in pairs at the same method, so they race compiling it
+		Thread[] ta = new Thread [threads];
+		for (int i = 0; i < threads; ++i) {
+			ta [i] = new Thread (Worker);
+			ta [i].Start ((i / 2) * (methods / threads) * 2);
+		}
+		start.Set ();
+		for (int i = 0; i < threads; ++i)
+			ta [i].Join ();
+
+		return errors == 0 ? 0 : 1;
+	}
+}
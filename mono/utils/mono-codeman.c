@@ -13,12 +13,17 @@
 
 #include "mono-codeman.h"
 #include "mono-mmap.h"
+#include "mono-compiler.h"
 #include "dlmalloc.h"
+#include <mono/io-layer/io-layer.h>
 #include <mono/metadata/class-internals.h>
 #include <mono/metadata/profiler-private.h>
 #ifdef HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #if defined(__native_client_codegen__) && defined(__native_client__)
 #include <malloc.h>
@@ -65,6 +70,22 @@
 
 #define MONO_PROT_RWX (MONO_MMAP_READ|MONO_MMAP_WRITE|MONO_MMAP_EXEC)
 
+/*
+ * Once a code manager has allocated this much memory, further chunks are allocated
+ * in multiples of this size, aligned to it, and backed by huge pages if possible, so
+ * the code of big applications causes fewer iTLB misses.
+ */
+#define HUGE_CHUNK_SIZE (2 * 1024 * 1024)
+
+#if defined(HAVE_KW_THREAD) && (!defined(__native_client__) || !defined(__native_client_codegen__))
+#define USE_CODE_ARENAS 1
+#endif
+
+/* The size of the per-thread code arenas */
+#define CODE_ARENA_SIZE (32 * 1024)
+/* Larger allocations are done from the chunks directly */
+#define CODE_ARENA_MAX_ALLOC (4 * 1024)
+
 typedef struct _CodeChunck CodeChunk;
 
 enum {
@@ -76,6 +97,8 @@ struct _CodeChunck {
 	char *data;
 	int pos;
 	int size;
+	/* the end of the last thread arena carved from this chunk */
+	int arena_end;
 	CodeChunk *next;
 	unsigned int flags: 8;
 	/* this number of bytes is available to resolve addresses far in memory */
@@ -85,6 +108,10 @@ struct _CodeChunck {
 struct _MonoCodeManager {
 	int dynamic;
 	int read_only;
+	/* Unique id, used to detect arenas belonging to a destroyed code manager */
+	guint32 id;
+	/* The total size of the chunks allocated so far */
+	int chunks_size;
 	CodeChunk *current;
 	CodeChunk *full;
 #if defined(__native_client_codegen__) && defined(__native_client__)
@@ -94,6 +121,28 @@ struct _MonoCodeManager {
 
 #define ALIGN_INT(val,alignment) (((val) + (alignment - 1)) & ~(alignment - 1))
 
+#ifdef USE_CODE_ARENAS
+/*
+ * A part of a chunk of a non-dynamic code manager reserved for the use of one thread.
+ * Allocations which fit into it are done by bumping a pointer, without taking the
+ * lock which protects the code manager, see mono_code_manager_try_reserve_align ().
+ * The arena is only valid while its code manager is alive, so it also records the
+ * id of the code manager.
+ */
+typedef struct {
+	MonoCodeManager *cman;
+	guint32 cman_id;
+	CodeChunk *chunk;
+	char *start;
+	char *pos;
+	char *end;
+} CodeArena;
+
+static __thread CodeArena code_arena MONO_TLS_FAST;
+#endif
+
+static gint32 code_manager_id;
+
 #if defined(__native_client_codegen__) && defined(__native_client__)
 /* End of text segment, set by linker. 
  * Dynamic text starts on the next allocated page.
@@ -221,6 +270,8 @@ mono_code_manager_new (void)
 	cman->full = NULL;
 	cman->dynamic = 0;
 	cman->read_only = 0;
+	cman->id = InterlockedIncrement (&code_manager_id);
+	cman->chunks_size = 0;
 #if defined(__native_client_codegen__) && defined(__native_client__)
 	if (next_dynamic_code_addr == NULL) {
 		const guint kPageMask = 0xFFFF; /* 64K pages */
@@ -374,12 +425,49 @@ mono_code_manager_foreach (MonoCodeManager *cman, MonoCodeManagerFunc func, void
 #define BIND_ROOM 8
 #endif
 
+/* Architectures using BIND_ROOM reserve a part of each chunk for thunks */
+#if defined(HAVE_MMAP) && defined(MADV_HUGEPAGE) && !defined(BIND_ROOM)
+#define USE_HUGE_CHUNKS 1
+#endif
+
+#ifdef USE_HUGE_CHUNKS
+/*
+ * valloc_huge_chunk:
+ *
+ *   Allocate SIZE bytes of code memory aligned to HUGE_CHUNK_SIZE, and ask the OS to
+ * back it with huge pages. Unlike mono_valloc_aligned (), return NULL on failure.
+ */
+static void*
+valloc_huge_chunk (int size)
+{
+	char *mem, *aligned;
+
+	mem = mono_valloc (NULL, size + HUGE_CHUNK_SIZE, MONO_PROT_RWX | ARCH_MAP_FLAGS);
+	if (!mem)
+		return NULL;
+
+	aligned = (char*)(((gsize)mem + HUGE_CHUNK_SIZE - 1) & ~(gsize)(HUGE_CHUNK_SIZE - 1));
+	if (aligned > mem)
+		mono_vfree (mem, aligned - mem);
+	if (aligned + size < mem + size + HUGE_CHUNK_SIZE)
+		mono_vfree (aligned + size, (mem + size + HUGE_CHUNK_SIZE) - (aligned + size));
+
+	if (mono_vadvise_huge_pages (aligned, size) == 0)
+		++mono_stats.code_huge_page_chunks;
+	return aligned;
+}
+#endif
+
 static CodeChunk*
-new_codechunk (int dynamic, int size)
+new_codechunk (MonoCodeManager *cman, int size)
 {
 	int minsize, flags = CODE_FLAG_MMAP;
 	int chunk_size, bsize = 0;
 	int pagesize;
+	int dynamic = cman->dynamic;
+#ifdef USE_HUGE_CHUNKS
+	gboolean huge = FALSE;
+#endif
 	CodeChunk *chunk;
 	void *ptr;
 
@@ -401,6 +489,12 @@ new_codechunk (int dynamic, int size)
 			chunk_size += pagesize - 1;
 			chunk_size &= ~ (pagesize - 1);
 		}
+#ifdef USE_HUGE_CHUNKS
+		if (flags == CODE_FLAG_MMAP && cman->chunks_size >= HUGE_CHUNK_SIZE) {
+			chunk_size = ALIGN_INT (chunk_size, HUGE_CHUNK_SIZE);
+			huge = TRUE;
+		}
+#endif
 	}
 #ifdef BIND_ROOM
 	bsize = chunk_size / BIND_ROOM;
@@ -420,12 +514,20 @@ new_codechunk (int dynamic, int size)
 		if (!ptr)
 			return NULL;
 	} else {
-		/* Allocate MIN_ALIGN-1 more than we need so we can still */
-		/* guarantee MIN_ALIGN alignment for individual allocs    */
-		/* from mono_code_manager_reserve_align.                  */
-		ptr = mono_valloc (NULL, chunk_size + MIN_ALIGN - 1, MONO_PROT_RWX | ARCH_MAP_FLAGS);
-		if (!ptr)
-			return NULL;
+		ptr = NULL;
+#ifdef USE_HUGE_CHUNKS
+		/* Fall back to a normal chunk if this fails */
+		if (huge)
+			ptr = valloc_huge_chunk (chunk_size);
+#endif
+		if (!ptr) {
+			/* Allocate MIN_ALIGN-1 more than we need so we can still */
+			/* guarantee MIN_ALIGN alignment for individual allocs    */
+			/* from mono_code_manager_reserve_align.                  */
+			ptr = mono_valloc (NULL, chunk_size + MIN_ALIGN - 1, MONO_PROT_RWX | ARCH_MAP_FLAGS);
+			if (!ptr)
+				return NULL;
+		}
 	}
 
 	if (flags == CODE_FLAG_MALLOC) {
@@ -448,45 +550,29 @@ new_codechunk (int dynamic, int size)
 	chunk->data = ptr;
 	chunk->flags = flags;
 	chunk->pos = bsize;
+	chunk->arena_end = 0;
 	chunk->bsize = bsize;
+	cman->chunks_size += chunk_size;
 	mono_profiler_code_chunk_new((gpointer) chunk->data, chunk->size);
 
 	/*printf ("code chunk at: %p\n", ptr);*/
 	return chunk;
 }
 
-/**
- * mono_code_manager_reserve:
- * @cman: a code manager
- * @size: size of memory to allocate
- * @alignment: power of two alignment value
- *
- * Allocates at least @size bytes of memory inside the code manager @cman.
- *
- * Returns: the pointer to the allocated memory or #NULL on failure
+#if !defined(__native_client__) || !defined(__native_client_codegen__)
+/*
+ * Allocate SIZE bytes from the chunks of CMAN, creating a new chunk if needed. Return
+ * the chunk used in OUT_CHUNK.
  */
-void*
-mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
+static void*
+reserve_from_chunks (MonoCodeManager *cman, int size, int alignment, CodeChunk **out_chunk)
 {
-#if !defined(__native_client__) || !defined(__native_client_codegen__)
 	CodeChunk *chunk, *prev;
 	void *ptr;
 	guint32 align_mask = alignment - 1;
 
-	g_assert (!cman->read_only);
-
-	/* eventually allow bigger alignments, but we need to fix the dynamic alloc code to
-	 * handle this before
-	 */
-	g_assert (alignment <= MIN_ALIGN);
-
-	if (cman->dynamic) {
-		++mono_stats.dynamic_code_alloc_count;
-		mono_stats.dynamic_code_bytes_count += size;
-	}
-
 	if (!cman->current) {
-		cman->current = new_codechunk (cman->dynamic, size);
+		cman->current = new_codechunk (cman, size);
 		if (!cman->current)
 			return NULL;
 	}
@@ -498,6 +584,7 @@ mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
 			/* or we can't guarantee proper alignment     */
 			ptr = (void*)((((uintptr_t)chunk->data + align_mask) & ~(uintptr_t)align_mask) + chunk->pos);
 			chunk->pos = ((char*)ptr - chunk->data) + size;
+			*out_chunk = chunk;
 			return ptr;
 		}
 	}
@@ -518,7 +605,7 @@ mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
 		cman->full = chunk;
 		break;
 	}
-	chunk = new_codechunk (cman->dynamic, size);
+	chunk = new_codechunk (cman, size);
 	if (!chunk)
 		return NULL;
 	chunk->next = cman->current;
@@ -528,7 +615,113 @@ mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
 	/* or we can't guarantee proper alignment     */
 	ptr = (void*)((((uintptr_t)chunk->data + align_mask) & ~(uintptr_t)align_mask) + chunk->pos);
 	chunk->pos = ((char*)ptr - chunk->data) + size;
+	*out_chunk = chunk;
 	return ptr;
+}
+#endif
+
+#ifdef USE_CODE_ARENAS
+static inline gboolean
+arena_is_valid (CodeArena *arena, MonoCodeManager *cman)
+{
+	return arena->cman == cman && arena->cman_id == cman->id;
+}
+
+static inline void*
+arena_alloc (CodeArena *arena, MonoCodeManager *cman, int size, int alignment)
+{
+	char *ptr;
+
+	if (!arena_is_valid (arena, cman))
+		return NULL;
+	ptr = (char*)(((uintptr_t)arena->pos + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	if (ptr + size > arena->end)
+		return NULL;
+	arena->pos = ptr + size;
+	return ptr;
+}
+
+/*
+ * Replace the arena of the current thread with a new one carved from the chunks of
+ * CMAN. The unused part of the old arena is given back to its chunk if nothing was
+ * allocated after it. LOCKING: the caller holds the lock protecting CMAN.
+ */
+static void
+arena_refill (CodeArena *arena, MonoCodeManager *cman)
+{
+	CodeChunk *chunk;
+	char *ptr;
+
+	if (arena_is_valid (arena, cman) && arena->chunk->data + arena->chunk->pos == arena->end) {
+		arena->chunk->pos = arena->pos - arena->chunk->data;
+		arena->chunk->arena_end = arena->chunk->pos;
+	} else {
+		/* The code manager of the arena might be dead, so only its own fields are used */
+		mono_stats.code_arena_wasted_bytes += arena->end - arena->pos;
+	}
+	memset (arena, 0, sizeof (CodeArena));
+
+	ptr = reserve_from_chunks (cman, CODE_ARENA_SIZE, MIN_ALIGN, &chunk);
+	if (!ptr)
+		return;
+	chunk->arena_end = chunk->pos;
+
+	arena->cman = cman;
+	arena->cman_id = cman->id;
+	arena->chunk = chunk;
+	arena->start = ptr;
+	arena->pos = ptr;
+	arena->end = ptr + CODE_ARENA_SIZE;
+
+	++mono_stats.code_arena_count;
+	mono_stats.code_arena_bytes += CODE_ARENA_SIZE;
+}
+#endif
+
+/**
+ * mono_code_manager_reserve_align:
+ * @cman: a code manager
+ * @size: size of memory to allocate
+ * @alignment: power of two alignment value
+ *
+ * Allocates at least @size bytes of memory inside the code manager @cman.
+ * Small allocations in non-dynamic code managers are done from an arena owned by
+ * the current thread.
+ *
+ * Returns: the pointer to the allocated memory or #NULL on failure
+ */
+void*
+mono_code_manager_reserve_align (MonoCodeManager *cman, int size, int alignment)
+{
+#if !defined(__native_client__) || !defined(__native_client_codegen__)
+	CodeChunk *chunk;
+	void *ptr;
+
+	g_assert (!cman->read_only);
+
+	/* eventually allow bigger alignments, but we need to fix the dynamic alloc code to
+	 * handle this before
+	 */
+	g_assert (alignment <= MIN_ALIGN);
+
+	if (cman->dynamic) {
+		++mono_stats.dynamic_code_alloc_count;
+		mono_stats.dynamic_code_bytes_count += size;
+	}
+
+#ifdef USE_CODE_ARENAS
+	if (!cman->dynamic && size <= CODE_ARENA_MAX_ALLOC) {
+		ptr = arena_alloc (&code_arena, cman, size, alignment);
+		if (ptr)
+			return ptr;
+		arena_refill (&code_arena, cman);
+		ptr = arena_alloc (&code_arena, cman, size, alignment);
+		if (ptr)
+			return ptr;
+	}
+#endif
+
+	return reserve_from_chunks (cman, size, alignment, &chunk);
 #else
 	unsigned char *temp_ptr, *code_ptr;
 	/* Round up size to next bundle */
@@ -568,6 +761,76 @@ mono_code_manager_reserve (MonoCodeManager *cman, int size)
 	return mono_code_manager_reserve_align (cman, size, MIN_ALIGN);
 }
 
+/**
+ * mono_code_manager_try_reserve_align:
+ * @cman: a code manager
+ * @size: size of memory to allocate
+ * @alignment: power of two alignment value
+ *
+ * Allocates @size bytes of memory from the arena of the current thread in @cman,
+ * without requiring the caller to hold the lock which protects @cman.
+ *
+ * Returns: the pointer to the allocated memory or #NULL if the arena doesn't
+ * have enough room, in which case mono_code_manager_reserve_align () should be
+ * called while holding the lock.
+ */
+void*
+mono_code_manager_try_reserve_align (MonoCodeManager *cman, int size, int alignment)
+{
+#ifdef USE_CODE_ARENAS
+	if (cman->read_only || size > CODE_ARENA_MAX_ALLOC)
+		return NULL;
+	return arena_alloc (&code_arena, cman, size, alignment);
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * mono_code_manager_try_reserve:
+ * @cman: a code manager
+ * @size: size of memory to allocate
+ *
+ * Same as mono_code_manager_try_reserve_align () with the default alignment.
+ */
+void*
+mono_code_manager_try_reserve (MonoCodeManager *cman, int size)
+{
+	return mono_code_manager_try_reserve_align (cman, size, MIN_ALIGN);
+}
+
+/**
+ * mono_code_manager_try_commit:
+ * @cman: a code manager
+ * @data: the pointer returned by mono_code_manager_reserve ()
+ * @size: the size requested in the call to mono_code_manager_reserve ()
+ * @newsize: the new size to reserve
+ *
+ * Same as mono_code_manager_commit () for memory allocated from the arena of the
+ * current thread, which doesn't require the caller to hold the lock which protects
+ * @cman.
+ *
+ * Returns: TRUE on success, FALSE if mono_code_manager_commit () should be called
+ * while holding the lock.
+ */
+int
+mono_code_manager_try_commit (MonoCodeManager *cman, void *data, int size, int newsize)
+{
+#ifdef USE_CODE_ARENAS
+	CodeArena *arena = &code_arena;
+
+	g_assert (newsize <= size);
+
+	if (!arena_is_valid (arena, cman) || (char*)data < arena->start || (char*)data >= arena->end)
+		return FALSE;
+	if ((char*)data + size == arena->pos)
+		arena->pos -= size - newsize;
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
 /**
  * mono_code_manager_commit:
  * @cman: a code manager
@@ -585,7 +848,13 @@ mono_code_manager_commit (MonoCodeManager *cman, void *data, int size, int newsi
 #if !defined(__native_client__) || !defined(__native_client_codegen__)
 	g_assert (newsize <= size);
 
-	if (cman->current && (size != newsize) && (data == cman->current->data + cman->current->pos - size)) {
+#ifdef USE_CODE_ARENAS
+	if (mono_code_manager_try_commit (cman, data, size, newsize))
+		return;
+#endif
+
+	/* Memory below arena_end belongs to a thread arena */
+	if (cman->current && (size != newsize) && (data == cman->current->data + cman->current->pos - size) && cman->current->pos - size >= cman->current->arena_end) {
 		cman->current->pos -= size - newsize;
 	}
 #else
@@ -13,6 +13,11 @@ void*            mono_code_manager_reserve_align (MonoCodeManager *cman, int siz
 
 void*            mono_code_manager_reserve (MonoCodeManager *cman, int size);
 void             mono_code_manager_commit  (MonoCodeManager *cman, void *data, int size, int newsize);
+
+void*            mono_code_manager_try_reserve_align (MonoCodeManager *cman, int size, int alignment);
+void*            mono_code_manager_try_reserve (MonoCodeManager *cman, int size);
+int              mono_code_manager_try_commit  (MonoCodeManager *cman, void *data, int size, int newsize);
+
 int              mono_code_manager_size    (MonoCodeManager *cman, int *used_size);
 
 /* find the extra block allocated to resolve branches close to code */
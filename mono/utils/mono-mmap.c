@@ -642,3 +642,22 @@ mono_valloc_aligned (size_t size, size_t alignment, int flags)
 	return aligned;
 }
 #endif
+
+/**
+ * mono_vadvise_huge_pages:
+ * @addr: memory address, aligned to the huge page size
+ * @length: length of the area, a multiple of the huge page size
+ *
+ * Ask the OS to back the memory area at @addr with huge pages.
+ *
+ * Returns: 0 on success.
+ */
+int
+mono_vadvise_huge_pages (void *addr, size_t length)
+{
+#if defined(HAVE_MMAP) && defined(MADV_HUGEPAGE)
+	return madvise (addr, length, MADV_HUGEPAGE);
+#else
+	return -1;
+#endif
+}
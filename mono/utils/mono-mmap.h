@@ -36,6 +36,7 @@ int   mono_vfree      (void *addr, size_t length);
 void* mono_file_map   (size_t length, int flags, int fd, guint64 offset, void **ret_handle);
 int   mono_file_unmap (void *addr, void *handle);
 int   mono_mprotect   (void *addr, size_t length, int flags);
+int   mono_vadvise_huge_pages (void *addr, size_t length);
 
 void* mono_shared_area         (void);
 void  mono_shared_area_remove  (void);